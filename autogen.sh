@@ -2,4 +2,7 @@
 
 set -e
 
+# libtoolize installs its macros here
+mkdir -p m4
+
 autoreconf --install --verbose --force
\ No newline at end of file
@@ -0,0 +1,58 @@
+#include "active_window.h"
+#ifdef GDK_WINDOWING_X11
+#include <gdk/gdkx.h>
+
+// First item of a 32-bit window property, 0 if it isn't set
+static gulong get_property_item(GdkWindow *window, const char *property, const char *type)
+{
+    GdkAtom actual;
+    gint format, length;
+    guchar *data = NULL;
+    gulong item = 0;
+    
+    if (gdk_property_get(window, gdk_atom_intern_static_string(property),
+                         gdk_atom_intern_static_string(type), 0, 1, FALSE,
+                         &actual, &format, &length, &data) &&
+        format == 32 && length >= (gint)sizeof(gulong)) {
+        // Format 32 properties arrive as an array of longs
+        item = *(gulong *)data;
+    }
+    
+    g_free(data);
+    return item;
+}
+#endif
+
+guint32 active_window_get_pid(void)
+{
+#ifdef GDK_WINDOWING_X11
+    GdkScreen *screen = gdk_screen_get_default();
+    GdkDisplay *display = screen ? gdk_screen_get_display(screen) : NULL;
+    
+    if (!display || !GDK_IS_X11_DISPLAY(display)) {
+        return 0;
+    }
+    
+    // Two property reads on the X server; the sound server isn't involved.
+    // _NET_ACTIVE_WINDOW is read here rather than through
+    // gdk_screen_get_active_window, deprecated since GTK 3.22.
+    Window xid = get_property_item(gdk_screen_get_root_window(screen),
+                                   "_NET_ACTIVE_WINDOW", "WINDOW");
+    if (!xid) {
+        return 0;
+    }
+    
+    // The window may have gone away since
+    gdk_x11_display_error_trap_push(display);
+    GdkWindow *window = gdk_x11_window_foreign_new_for_display(display, xid);
+    guint32 pid = window ? (guint32)get_property_item(window, "_NET_WM_PID", "CARDINAL") : 0;
+    gdk_x11_display_error_trap_pop_ignored(display);
+    
+    if (window) {
+        g_object_unref(window);
+    }
+    return pid;
+#else
+    return 0;
+#endif
+}
@@ -0,0 +1,13 @@
+#ifndef ACTIVE_WINDOW_H
+#define ACTIVE_WINDOW_H
+
+#include <gtk/gtk.h>
+
+// Process id of the window the user is looking at: _NET_ACTIVE_WINDOW on
+// the root window, then that window's _NET_WM_PID. Clicking or scrolling
+// the tray icon doesn't move the focus, so this is still the application
+// the user came from. Returns 0 without an EWMH window manager (or on
+// Wayland) and for windows that don't set _NET_WM_PID.
+guint32 active_window_get_pid(void);
+
+#endif // ACTIVE_WINDOW_H
@@ -0,0 +1,106 @@
+#include "app_icon.h"
+#include <gio/gdesktopappinfo.h>
+#include <stdio.h>
+
+// interned key -> GdkPixbuf, or NULL for a cached miss
+static GHashTable *icon_cache = NULL;
+
+static void cached_icon_free(gpointer data)
+{
+    if (data) {
+        g_object_unref(data);
+    }
+}
+
+static void on_icon_theme_changed(GtkIconTheme *theme, gpointer user_data)
+{
+    // Cached misses may resolve now and hits may look different
+    app_icon_cache_clear();
+}
+
+static GdkPixbuf* load_theme_icon(GtkIconTheme *theme, const char *name)
+{
+    if (!name || !*name || !gtk_icon_theme_has_icon(theme, name)) {
+        return NULL;
+    }
+    
+    return gtk_icon_theme_load_icon(theme, name, APP_ICON_SIZE,
+                                    GTK_ICON_LOOKUP_FORCE_SIZE, NULL);
+}
+
+static GdkPixbuf* load_desktop_icon(GtkIconTheme *theme, const char *process_name)
+{
+    if (!process_name || !*process_name) {
+        return NULL;
+    }
+    
+    gchar *desktop_id = g_strconcat(process_name, ".desktop", NULL);
+    GDesktopAppInfo *app_info = g_desktop_app_info_new(desktop_id);
+    g_free(desktop_id);
+    
+    if (!app_info) {
+        return NULL;
+    }
+    
+    GdkPixbuf *pixbuf = NULL;
+    GIcon *gicon = g_app_info_get_icon(G_APP_INFO(app_info));
+    if (gicon) {
+        GtkIconInfo *icon_info = gtk_icon_theme_lookup_by_gicon(theme, gicon, APP_ICON_SIZE,
+                                                               GTK_ICON_LOOKUP_FORCE_SIZE);
+        if (icon_info) {
+            pixbuf = gtk_icon_info_load_icon(icon_info, NULL);
+            g_object_unref(icon_info);
+        }
+    }
+    
+    g_object_unref(app_info);
+    return pixbuf;
+}
+
+static GdkPixbuf* resolve_icon(const char *icon_name, const char *process_name)
+{
+    GtkIconTheme *theme = gtk_icon_theme_get_default();
+    GdkPixbuf *pixbuf = load_theme_icon(theme, icon_name);
+    
+    if (!pixbuf) {
+        pixbuf = load_theme_icon(theme, process_name);
+    }
+    
+    if (!pixbuf) {
+        pixbuf = load_desktop_icon(theme, process_name);
+    }
+    
+    return pixbuf;
+}
+
+GdkPixbuf* app_icon_lookup(const char *key, const char *icon_name, const char *process_name)
+{
+    if (!key) {
+        return NULL;
+    }
+    
+    if (!icon_cache) {
+        icon_cache = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, cached_icon_free);
+        g_signal_connect(gtk_icon_theme_get_default(), "changed",
+                        G_CALLBACK(on_icon_theme_changed), NULL);
+    }
+    
+    // Keys are interned, so the pointer identifies the string
+    gpointer cached;
+    if (g_hash_table_lookup_extended(icon_cache, key, NULL, &cached)) {
+        return (GdkPixbuf *)cached;
+    }
+    
+    GdkPixbuf *pixbuf = resolve_icon(icon_name, process_name);
+    g_hash_table_insert(icon_cache, (gpointer)key, pixbuf);
+    
+    printf("Resolved icon for '%s': %s\n", key, pixbuf ? "found" : "none");
+    return pixbuf;
+}
+
+void app_icon_cache_clear(void)
+{
+    if (icon_cache) {
+        g_hash_table_remove_all(icon_cache);
+    }
+}
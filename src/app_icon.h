@@ -0,0 +1,21 @@
+#ifndef APP_ICON_H
+#define APP_ICON_H
+
+#include <gtk/gtk.h>
+
+// Pixel size of application icons in mixer rows
+#define APP_ICON_SIZE 16
+
+// Look up the icon for an application stream. 'key' must be an interned
+// string (the icon name if any, else the process name); results, including
+// misses, are cached process-wide under it, so repeat lookups are a single
+// pointer hash lookup.
+// Resolution order: icon_name, then the process binary as an icon name,
+// then the icon of <process_name>.desktop.
+// Returns a pixbuf owned by the cache, or NULL when nothing was found.
+GdkPixbuf* app_icon_lookup(const char *key, const char *icon_name, const char *process_name);
+
+// Drop all cached icons (also done automatically on icon theme changes)
+void app_icon_cache_clear(void);
+
+#endif // APP_ICON_H
@@ -0,0 +1,103 @@
+#ifndef AUDIO_BACKEND_H
+#define AUDIO_BACKEND_H
+
+#include "pulse_client.h"
+
+// Interface between the pulse_client_* facade and a sound server API.
+//
+// A backend owns its connection state (client->backend_data) and reports
+// what the server tells it through the registry functions below; the
+// facade owns the stream registry, write coalescing and notifications.
+// Volumes are exchanged as pa_cvolume/pa_channel_map whatever the server.
+// Backends dispatch from sources on the default GLib main context; there
+// is no polling.
+typedef struct audio_backend {
+    const char *name;
+    
+    gboolean (*init)(pulse_client_t *client);
+    void (*cleanup)(pulse_client_t *client);
+    
+    // Connect to client->server. FALSE means it failed at once; otherwise
+    // the backend reports the outcome with pulse_client_connection_changed,
+    // possibly before returning. Connected means the master sink is known
+    // and a stream listing has been started.
+    gboolean (*connect)(pulse_client_t *client);
+    void (*disconnect)(pulse_client_t *client);
+    
+    // Re-list all streams; the backend brackets the listing with
+    // pulse_client_registry_begin_refresh/end_refresh
+    void (*refresh_apps)(pulse_client_t *client);
+    
+    // Writes are asynchronous and must be completed with the matching
+    // pulse_client_*_write_done/*_mute_done, also on failure after a
+    // TRUE return. An app mute marked 'engine' was issued by the engine
+    // itself (a schedule) rather than an API caller; its completion must
+    // carry the same mark.
+    gboolean (*write_master_volume)(pulse_client_t *client, const pa_cvolume *volume);
+    gboolean (*write_master_mute)(pulse_client_t *client, gboolean muted);
+    gboolean (*write_app_volume)(pulse_client_t *client, uint32_t index, const pa_cvolume *volume);
+    gboolean (*write_app_mute)(pulse_client_t *client, uint32_t index, gboolean muted,
+                               gboolean engine);
+    
+    // Requests sent whose reply hasn't been handled yet; stays flat over
+    // time unless replies are being lost
+    guint (*pending_requests)(pulse_client_t *client);
+    
+    // Optional: start or stop measuring a stream's level after its volume,
+    // reported about ten times a second with pulse_client_level_update.
+    // NULL when the server API offers no per-stream measurement.
+    gboolean (*monitor_level)(pulse_client_t *client, uint32_t index, gboolean enable);
+} audio_backend_t;
+
+// Server-neutral description of one playback stream
+typedef struct {
+    uint32_t index;
+    const char *name;
+    const char *process_name;
+    const char *icon_name;
+    uint32_t pid;             // Owning process, 0 if unknown
+    pa_cvolume volume;
+    pa_channel_map channel_map;
+    gboolean muted;
+    gboolean corked;
+    gint64 event_us;          // Monotonic arrival of the server event behind it, 0 if none
+} audio_stream_info_t;
+
+extern const audio_backend_t pulse_backend;
+extern const audio_backend_t replay_backend;
+#ifdef HAVE_PIPEWIRE
+extern const audio_backend_t pipewire_backend;
+#endif
+
+// Registry updates, called by backends from their event handlers
+app_audio_t* pulse_client_registry_update(pulse_client_t *client, const audio_stream_info_t *info);
+void pulse_client_registry_remove(pulse_client_t *client, uint32_t index);
+void pulse_client_registry_begin_refresh(pulse_client_t *client);
+void pulse_client_registry_end_refresh(pulse_client_t *client);
+void pulse_client_registry_set_master(pulse_client_t *client, uint32_t index,
+                                      const char *name, const pa_cvolume *volume,
+                                      const pa_channel_map *channel_map,
+                                      gboolean muted);
+// The default sink went away and nothing has replaced it yet
+void pulse_client_registry_clear_master(pulse_client_t *client);
+
+// Process id from an application.process.id property, 0 if absent or invalid
+uint32_t pulse_client_parse_pid(const char *value);
+
+// Outcome of a connect, or loss of an established connection
+void pulse_client_connection_changed(pulse_client_t *client, gboolean connected);
+
+// Completion of a volume write started through the backend
+void pulse_client_master_write_done(pulse_client_t *client, gboolean success);
+void pulse_client_app_write_done(pulse_client_t *client, uint32_t index, gboolean success);
+
+// Peak (0.0 .. 1.0) of a monitored stream since the previous update, or
+// negative once the server ended the measurement
+void pulse_client_level_update(pulse_client_t *client, uint32_t index, float peak);
+
+// Completion of a mute write started through the backend
+void pulse_client_master_mute_done(pulse_client_t *client, gboolean success);
+void pulse_client_app_mute_done(pulse_client_t *client, uint32_t index, gboolean success,
+                                gboolean engine);
+
+#endif // AUDIO_BACKEND_H
@@ -0,0 +1,1060 @@
+#include "audio_backend.h"
+#include "flight_recorder.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <glib-unix.h>
+#include <pipewire/pipewire.h>
+#include <pipewire/extensions/metadata.h>
+#include <spa/param/props.h>
+// Route params moved out of param.h into their own header in later releases
+#if defined(__has_include)
+#if __has_include(<spa/param/route.h>)
+#include <spa/param/route.h>
+#endif
+#endif
+#include <spa/param/audio/raw.h>
+#include <spa/pod/builder.h>
+#include <spa/pod/iter.h>
+
+// Native PipeWire backend. Talks to the daemon's registry directly rather
+// than through pipewire-pulse, so there is no protocol translation on the
+// info and write paths. Node global ids serve as stream indexes.
+//
+// Hardware sinks keep their volume on the owning device's active route,
+// which is what desktops show and what the session manager restores; the
+// master is written there, and as node Props only for sinks without one.
+
+#define SYNC_TIMEOUT_US (5 * G_USEC_PER_SEC)
+#define DEFAULT_SINK_KEY "default.audio.sink"
+#define PROFILE_DEVICE_KEY "card.profile.device"
+
+typedef enum {
+    NODE_KIND_STREAM,         // Stream/Output/Audio, an application
+    NODE_KIND_SINK            // Audio/Sink, a master volume candidate
+} node_kind_t;
+
+// A bound audio node and the state reported for it so far
+typedef struct {
+    pulse_client_t *client;
+    uint32_t id;
+    node_kind_t kind;
+    struct pw_proxy *proxy;
+    struct spa_hook listener;
+    char *node_name;          // node.name, matched against the default sink
+    uint32_t device_id;       // Owning device of a sink, SPA_ID_INVALID if none
+    int32_t profile_device;   // Its card.profile.device, -1 if none
+    char *app_name;
+    char *process_name;
+    char *icon_name;
+    uint32_t pid;             // application.process.id, 0 if unknown
+    pa_cvolume volume;
+    pa_channel_map channel_map;
+    gboolean muted;
+    gboolean corked;
+    gboolean have_volume;     // Props seen; nothing is reported before that
+} pipewire_node_t;
+
+// An active output route: the device half of a hardware sink's volume
+typedef struct {
+    int32_t device;           // card.profile.device of the sinks it serves
+    int32_t index;            // Route index, written back with the volume
+} pipewire_route_t;
+
+// A bound Audio/Device and its active output routes
+typedef struct {
+    pulse_client_t *client;
+    uint32_t id;
+    struct pw_proxy *proxy;
+    struct spa_hook listener;
+    GArray *routes;           // pipewire_route_t
+} pipewire_device_t;
+
+// Target of an in-flight write, keyed by its core sync seq
+typedef struct {
+    pulse_client_write_t kind;
+    gboolean master;
+    uint32_t index;
+    gboolean engine;          // A mute the engine issued itself
+    uint32_t proxy_id;        // Node or device the param went to; its errors fail the write
+} pipewire_write_t;
+
+// Connection state kept in pulse_client_t.backend_data
+typedef struct {
+    struct pw_loop *loop;
+    struct pw_context *context;
+    struct pw_core *core;
+    struct spa_hook core_listener;
+    struct pw_registry *registry;
+    struct spa_hook registry_listener;
+    struct pw_proxy *metadata;
+    struct spa_hook metadata_listener;
+    uint32_t metadata_id;
+    guint loop_source;
+    GHashTable *nodes;        // global id -> pipewire_node_t
+    GHashTable *devices;      // global id -> pipewire_device_t
+    GHashTable *pending_writes;  // sync seq -> pipewire_write_t
+    char *default_sink_name;
+    uint32_t default_sink_id;
+    int sync_seq;             // Round trip the blocking connect waits on
+    gboolean sync_done;
+    gboolean failed;          // Core reported a fatal error
+    guint teardown_source;    // Releases a core lost while connected
+} pipewire_backend_t;
+
+static void pipewire_disconnect(pulse_client_t *client);
+
+static void set_string(char **field, const char *value)
+{
+    if (g_strcmp0(*field, value) != 0) {
+        g_free(*field);
+        *field = g_strdup(value);
+    }
+}
+
+static pa_channel_position_t channel_from_spa(uint32_t position, unsigned int i)
+{
+    switch (position) {
+        case SPA_AUDIO_CHANNEL_MONO: return PA_CHANNEL_POSITION_MONO;
+        case SPA_AUDIO_CHANNEL_FL:   return PA_CHANNEL_POSITION_FRONT_LEFT;
+        case SPA_AUDIO_CHANNEL_FR:   return PA_CHANNEL_POSITION_FRONT_RIGHT;
+        case SPA_AUDIO_CHANNEL_FC:   return PA_CHANNEL_POSITION_FRONT_CENTER;
+        case SPA_AUDIO_CHANNEL_LFE:  return PA_CHANNEL_POSITION_LFE;
+        case SPA_AUDIO_CHANNEL_SL:   return PA_CHANNEL_POSITION_SIDE_LEFT;
+        case SPA_AUDIO_CHANNEL_SR:   return PA_CHANNEL_POSITION_SIDE_RIGHT;
+        case SPA_AUDIO_CHANNEL_FLC:  return PA_CHANNEL_POSITION_FRONT_LEFT_OF_CENTER;
+        case SPA_AUDIO_CHANNEL_FRC:  return PA_CHANNEL_POSITION_FRONT_RIGHT_OF_CENTER;
+        case SPA_AUDIO_CHANNEL_RC:   return PA_CHANNEL_POSITION_REAR_CENTER;
+        case SPA_AUDIO_CHANNEL_RL:   return PA_CHANNEL_POSITION_REAR_LEFT;
+        case SPA_AUDIO_CHANNEL_RR:   return PA_CHANNEL_POSITION_REAR_RIGHT;
+        default:
+            // Positions pulse has no name for still need distinct slots
+            return PA_CHANNEL_POSITION_AUX0 + (i % 32);
+    }
+}
+
+// Pass the node's current state on to the registry; 'event_us' is when
+// the event that changed it arrived, 0 if there was none
+static void report_node(pipewire_node_t *node, gint64 event_us)
+{
+    pulse_client_t *client = node->client;
+    pipewire_backend_t *pw = client->backend_data;
+    
+    if (!node->have_volume) {
+        return;
+    }
+    
+    if (node->kind == NODE_KIND_SINK) {
+        if (node->id == pw->default_sink_id) {
+            pulse_client_registry_set_master(client, node->id, node->node_name, &node->volume,
+                                             &node->channel_map, node->muted);
+        }
+        return;
+    }
+    
+    audio_stream_info_t info = {
+        .index = node->id,
+        .name = node->app_name,
+        .process_name = node->process_name,
+        .icon_name = node->icon_name,
+        .pid = node->pid,
+        .volume = node->volume,
+        .channel_map = node->channel_map,
+        .muted = node->muted,
+        .corked = node->corked,
+        .event_us = event_us,
+    };
+    
+    pulse_client_registry_update(client, &info);
+}
+
+// Point the master volume at the sink named by the default metadata
+static void resolve_default_sink(pulse_client_t *client)
+{
+    pipewire_backend_t *pw = client->backend_data;
+    GHashTableIter iter;
+    gpointer value;
+    
+    pw->default_sink_id = SPA_ID_INVALID;
+    if (!pw->default_sink_name) {
+        pulse_client_registry_clear_master(client);
+        return;
+    }
+    
+    g_hash_table_iter_init(&iter, pw->nodes);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        pipewire_node_t *node = value;
+        if (node->kind == NODE_KIND_SINK &&
+            g_strcmp0(node->node_name, pw->default_sink_name) == 0) {
+            pw->default_sink_id = node->id;
+            report_node(node, 0);
+            g_debug("Default sink: %s (index=%u, volume=%d%%, muted=%s)",
+                    node->node_name, node->id,
+                    pulse_client_pa_volume_to_percent(pa_cvolume_max(&node->volume)),
+                    node->muted ? "yes" : "no");
+            return;
+        }
+    }
+    
+    // Named but not bound (yet): nothing to show for the old one meanwhile
+    pulse_client_registry_clear_master(client);
+}
+
+static void node_info(void *data, const struct pw_node_info *info)
+{
+    pipewire_node_t *node = data;
+    gint64 event_us = g_get_monotonic_time();
+    
+    if ((info->change_mask & PW_NODE_CHANGE_MASK_PROPS) && info->props) {
+        set_string(&node->app_name, spa_dict_lookup(info->props, PW_KEY_APP_NAME));
+        set_string(&node->process_name, spa_dict_lookup(info->props, PW_KEY_APP_PROCESS_BINARY));
+        set_string(&node->icon_name, spa_dict_lookup(info->props, PW_KEY_APP_ICON_NAME));
+        node->pid = pulse_client_parse_pid(spa_dict_lookup(info->props, PW_KEY_APP_PROCESS_ID));
+        
+        const char *device_id = spa_dict_lookup(info->props, PW_KEY_DEVICE_ID);
+        const char *profile_device = spa_dict_lookup(info->props, PROFILE_DEVICE_KEY);
+        node->device_id = device_id ? (uint32_t)strtoul(device_id, NULL, 10) : SPA_ID_INVALID;
+        node->profile_device = profile_device ? (int32_t)strtol(profile_device, NULL, 10) : -1;
+    }
+    
+    if (info->change_mask & PW_NODE_CHANGE_MASK_STATE) {
+        // Paused and drained streams go idle, then suspended
+        node->corked = info->state != PW_NODE_STATE_RUNNING;
+    }
+    
+    report_node(node, event_us);
+}
+
+static void node_param(void *data, int seq, uint32_t id, uint32_t index,
+                       uint32_t next, const struct spa_pod *param)
+{
+    pipewire_node_t *node = data;
+    gint64 event_us = g_get_monotonic_time();
+    const struct spa_pod_prop *prop;
+    float volumes[SPA_AUDIO_MAX_CHANNELS];
+    uint32_t positions[SPA_AUDIO_MAX_CHANNELS];
+    uint32_t n_volumes = 0, n_positions = 0;
+    gboolean have_mute = FALSE;
+    bool mute = false;
+    
+    if (id != SPA_PARAM_Props || !param ||
+        !spa_pod_is_object_type(param, SPA_TYPE_OBJECT_Props)) {
+        return;
+    }
+    
+    SPA_POD_OBJECT_FOREACH((const struct spa_pod_object *)param, prop) {
+        switch (prop->key) {
+            case SPA_PROP_channelVolumes:
+                n_volumes = spa_pod_copy_array(&prop->value, SPA_TYPE_Float,
+                                               volumes, SPA_AUDIO_MAX_CHANNELS);
+                break;
+            case SPA_PROP_channelMap:
+                n_positions = spa_pod_copy_array(&prop->value, SPA_TYPE_Id,
+                                                 positions, SPA_AUDIO_MAX_CHANNELS);
+                break;
+            case SPA_PROP_mute:
+                have_mute = spa_pod_get_bool(&prop->value, &mute) >= 0;
+                break;
+            default:
+                break;
+        }
+    }
+    
+    if (n_volumes > PA_CHANNELS_MAX) {
+        n_volumes = PA_CHANNELS_MAX;
+    }
+    
+    if (n_volumes > 0) {
+        // PipeWire volumes are linear gains; pulse volumes are cubic
+        pa_cvolume_init(&node->volume);
+        node->volume.channels = n_volumes;
+        for (uint32_t i = 0; i < n_volumes; i++) {
+            node->volume.values[i] = pa_sw_volume_from_linear(volumes[i]);
+        }
+        
+        if (n_positions == n_volumes) {
+            pa_channel_map_init(&node->channel_map);
+            node->channel_map.channels = n_volumes;
+            for (uint32_t i = 0; i < n_volumes; i++) {
+                node->channel_map.map[i] = channel_from_spa(positions[i], i);
+            }
+        } else if (node->channel_map.channels != n_volumes) {
+            pa_channel_map_init_extend(&node->channel_map, n_volumes, PA_CHANNEL_MAP_DEFAULT);
+        }
+        node->have_volume = TRUE;
+    }
+    
+    if (have_mute) {
+        node->muted = mute ? TRUE : FALSE;
+    }
+    
+    report_node(node, event_us);
+}
+
+static const struct pw_node_events node_events = {
+    PW_VERSION_NODE_EVENTS,
+    .info = node_info,
+    .param = node_param,
+};
+
+static void node_free(gpointer data)
+{
+    pipewire_node_t *node = data;
+    
+    spa_hook_remove(&node->listener);
+    pw_proxy_destroy(node->proxy);
+    g_free(node->node_name);
+    g_free(node->app_name);
+    g_free(node->process_name);
+    g_free(node->icon_name);
+    g_free(node);
+}
+
+// Active routes are reported one param each, again in full on any change
+static void device_param(void *data, int seq, uint32_t id, uint32_t index,
+                         uint32_t next, const struct spa_pod *param)
+{
+    pipewire_device_t *device = data;
+    const struct spa_pod_prop *prop;
+    pipewire_route_t route = { -1, -1 };
+    uint32_t direction = SPA_DIRECTION_INPUT;
+    
+    if (id != SPA_PARAM_Route || !param ||
+        !spa_pod_is_object_type(param, SPA_TYPE_OBJECT_ParamRoute)) {
+        return;
+    }
+    
+    SPA_POD_OBJECT_FOREACH((const struct spa_pod_object *)param, prop) {
+        switch (prop->key) {
+            case SPA_PARAM_ROUTE_index:
+                spa_pod_get_int(&prop->value, &route.index);
+                break;
+            case SPA_PARAM_ROUTE_direction:
+                spa_pod_get_id(&prop->value, &direction);
+                break;
+            case SPA_PARAM_ROUTE_device:
+                spa_pod_get_int(&prop->value, &route.device);
+                break;
+            default:
+                break;
+        }
+    }
+    
+    if (direction != SPA_DIRECTION_OUTPUT || route.index < 0 || route.device < 0) {
+        return;
+    }
+    
+    // One active route per profile device; a new one replaces the old
+    for (guint i = 0; i < device->routes->len; i++) {
+        pipewire_route_t *known = &g_array_index(device->routes, pipewire_route_t, i);
+        if (known->device == route.device) {
+            known->index = route.index;
+            return;
+        }
+    }
+    g_array_append_val(device->routes, route);
+}
+
+static const struct pw_device_events device_events = {
+    PW_VERSION_DEVICE_EVENTS,
+    .param = device_param,
+};
+
+static void device_free(gpointer data)
+{
+    pipewire_device_t *device = data;
+    
+    spa_hook_remove(&device->listener);
+    pw_proxy_destroy(device->proxy);
+    g_array_free(device->routes, TRUE);
+    g_free(device);
+}
+
+static void bind_device(pulse_client_t *client, uint32_t id)
+{
+    pipewire_backend_t *pw = client->backend_data;
+    uint32_t params[] = { SPA_PARAM_Route };
+    
+    pipewire_device_t *device = g_new0(pipewire_device_t, 1);
+    device->client = client;
+    device->id = id;
+    device->proxy = pw_registry_bind(pw->registry, id, PW_TYPE_INTERFACE_Device,
+                                     PW_VERSION_DEVICE, 0);
+    if (!device->proxy) {
+        g_free(device);
+        return;
+    }
+    device->routes = g_array_new(FALSE, FALSE, sizeof(pipewire_route_t));
+    
+    pw_device_add_listener((struct pw_device *)device->proxy, &device->listener,
+                           &device_events, device);
+    pw_device_subscribe_params((struct pw_device *)device->proxy, params, G_N_ELEMENTS(params));
+    g_hash_table_insert(pw->devices, GUINT_TO_POINTER(id), device);
+}
+
+// Extract "name" from the metadata's {"name": "..."} JSON value
+static char *parse_default_name(const char *json)
+{
+    const char *start = json ? strstr(json, "\"name\"") : NULL;
+    if (!start) {
+        return NULL;
+    }
+    
+    start = strchr(start + strlen("\"name\""), ':');
+    start = start ? strchr(start, '"') : NULL;
+    if (!start) {
+        return NULL;
+    }
+    
+    const char *end = strchr(start + 1, '"');
+    if (!end) {
+        return NULL;
+    }
+    
+    return g_strndup(start + 1, end - start - 1);
+}
+
+static int metadata_property(void *data, uint32_t subject, const char *key,
+                             const char *type, const char *value)
+{
+    pulse_client_t *client = data;
+    pipewire_backend_t *pw = client->backend_data;
+    
+    // A NULL key clears every property
+    if (subject != PW_ID_CORE || (key && strcmp(key, DEFAULT_SINK_KEY) != 0)) {
+        return 0;
+    }
+    
+    g_free(pw->default_sink_name);
+    pw->default_sink_name = parse_default_name(value);
+    g_debug("Default sink name: %s", pw->default_sink_name ? pw->default_sink_name : "(none)");
+    
+    resolve_default_sink(client);
+    return 0;
+}
+
+static const struct pw_metadata_events metadata_events = {
+    PW_VERSION_METADATA_EVENTS,
+    .property = metadata_property,
+};
+
+static void bind_node(pulse_client_t *client, uint32_t id, node_kind_t kind,
+                      const struct spa_dict *props)
+{
+    pipewire_backend_t *pw = client->backend_data;
+    uint32_t params[] = { SPA_PARAM_Props };
+    
+    pipewire_node_t *node = g_new0(pipewire_node_t, 1);
+    node->client = client;
+    node->id = id;
+    node->kind = kind;
+    node->node_name = g_strdup(spa_dict_lookup(props, PW_KEY_NODE_NAME));
+    node->device_id = SPA_ID_INVALID;
+    node->profile_device = -1;
+    node->proxy = pw_registry_bind(pw->registry, id, PW_TYPE_INTERFACE_Node,
+                                   PW_VERSION_NODE, 0);
+    if (!node->proxy) {
+        g_free(node->node_name);
+        g_free(node);
+        return;
+    }
+    
+    pw_node_add_listener((struct pw_node *)node->proxy, &node->listener,
+                         &node_events, node);
+    pw_node_subscribe_params((struct pw_node *)node->proxy, params, G_N_ELEMENTS(params));
+    g_hash_table_insert(pw->nodes, GUINT_TO_POINTER(id), node);
+    
+    if (kind == NODE_KIND_SINK && pw->default_sink_id == SPA_ID_INVALID &&
+        g_strcmp0(node->node_name, pw->default_sink_name) == 0) {
+        pw->default_sink_id = id;
+    }
+}
+
+static void registry_global(void *data, uint32_t id, uint32_t permissions,
+                            const char *type, uint32_t version,
+                            const struct spa_dict *props)
+{
+    pulse_client_t *client = data;
+    pipewire_backend_t *pw = client->backend_data;
+    
+    if (!props) {
+        return;
+    }
+    
+    if (strcmp(type, PW_TYPE_INTERFACE_Node) == 0) {
+        const char *media_class = spa_dict_lookup(props, PW_KEY_MEDIA_CLASS);
+        if (g_strcmp0(media_class, "Stream/Output/Audio") == 0) {
+            flight_recorder_add("server-event", id, 0, 0);
+            bind_node(client, id, NODE_KIND_STREAM, props);
+        } else if (g_strcmp0(media_class, "Audio/Sink") == 0) {
+            bind_node(client, id, NODE_KIND_SINK, props);
+        }
+    } else if (strcmp(type, PW_TYPE_INTERFACE_Device) == 0) {
+        if (g_strcmp0(spa_dict_lookup(props, PW_KEY_MEDIA_CLASS), "Audio/Device") == 0) {
+            bind_device(client, id);
+        }
+    } else if (strcmp(type, PW_TYPE_INTERFACE_Metadata) == 0 && !pw->metadata &&
+               g_strcmp0(spa_dict_lookup(props, PW_KEY_METADATA_NAME), "default") == 0) {
+        pw->metadata = pw_registry_bind(pw->registry, id, PW_TYPE_INTERFACE_Metadata,
+                                        PW_VERSION_METADATA, 0);
+        if (pw->metadata) {
+            pw->metadata_id = id;
+            pw_metadata_add_listener((struct pw_metadata *)pw->metadata,
+                                     &pw->metadata_listener, &metadata_events, client);
+        }
+    }
+}
+
+static void registry_global_remove(void *data, uint32_t id)
+{
+    pulse_client_t *client = data;
+    pipewire_backend_t *pw = client->backend_data;
+    
+    if (pw->metadata && id == pw->metadata_id) {
+        spa_hook_remove(&pw->metadata_listener);
+        pw_proxy_destroy(pw->metadata);
+        pw->metadata = NULL;
+        return;
+    }
+    
+    if (g_hash_table_remove(pw->devices, GUINT_TO_POINTER(id))) {
+        return;
+    }
+    
+    pipewire_node_t *node = g_hash_table_lookup(pw->nodes, GUINT_TO_POINTER(id));
+    if (!node) {
+        return;
+    }
+    
+    if (node->kind == NODE_KIND_STREAM) {
+        flight_recorder_add("server-event", id, 1, 0);
+        pulse_client_registry_remove(client, id);
+    } else if (id == pw->default_sink_id) {
+        // The metadata names the next default, if any, separately
+        pw->default_sink_id = SPA_ID_INVALID;
+        pulse_client_registry_clear_master(client);
+    }
+    
+    g_hash_table_remove(pw->nodes, GUINT_TO_POINTER(id));
+}
+
+static const struct pw_registry_events registry_events = {
+    PW_VERSION_REGISTRY_EVENTS,
+    .global = registry_global,
+    .global_remove = registry_global_remove,
+};
+
+// Take the write tracked under sync 'seq' out of the table and report it
+static void complete_write(pulse_client_t *client, int seq, gboolean success)
+{
+    pipewire_backend_t *pw = client->backend_data;
+    pipewire_write_t *write = g_hash_table_lookup(pw->pending_writes, GINT_TO_POINTER(seq));
+    if (!write) {
+        return;
+    }
+    
+    g_hash_table_steal(pw->pending_writes, GINT_TO_POINTER(seq));
+    if (write->kind == PULSE_CLIENT_WRITE_MUTE) {
+        if (write->master) {
+            pulse_client_master_mute_done(client, success);
+        } else {
+            pulse_client_app_mute_done(client, write->index, success, write->engine);
+        }
+    } else if (write->master) {
+        pulse_client_master_write_done(client, success);
+    } else {
+        pulse_client_app_write_done(client, write->index, success);
+    }
+    g_free(write);
+}
+
+static void core_done(void *data, uint32_t id, int seq)
+{
+    pulse_client_t *client = data;
+    pipewire_backend_t *pw = client->backend_data;
+    
+    if (id != PW_ID_CORE) {
+        return;
+    }
+    
+    if (seq == pw->sync_seq) {
+        pw->sync_done = TRUE;
+    }
+    
+    // The server has applied everything sent before this sync
+    complete_write(client, seq, TRUE);
+}
+
+// An error on a node or device proxy is a set_param the server rejected.
+// It arrives before the write's own sync, and writes to one proxy are
+// handled in order, so it belongs to the oldest one still waiting.
+static void fail_write(pulse_client_t *client, uint32_t proxy_id)
+{
+    pipewire_backend_t *pw = client->backend_data;
+    GHashTableIter iter;
+    gpointer key, value;
+    gboolean found = FALSE;
+    int oldest = 0;
+    
+    g_hash_table_iter_init(&iter, pw->pending_writes);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        int seq = GPOINTER_TO_INT(key);
+        if (((pipewire_write_t *)value)->proxy_id == proxy_id && (!found || seq < oldest)) {
+            oldest = seq;
+            found = TRUE;
+        }
+    }
+    
+    if (found) {
+        complete_write(client, oldest, FALSE);
+    }
+}
+
+static gboolean teardown_callback(gpointer user_data)
+{
+    pulse_client_t *client = (pulse_client_t *)user_data;
+    pipewire_backend_t *pw = client->backend_data;
+    
+    pw->teardown_source = 0;
+    pipewire_disconnect(client);
+    return G_SOURCE_REMOVE;
+}
+
+static void core_error(void *data, uint32_t id, int seq, int res, const char *message)
+{
+    pulse_client_t *client = data;
+    pipewire_backend_t *pw = client->backend_data;
+    
+    g_message("PipeWire error (id=%u): %s", id, message ? message : spa_strerror(res));
+    
+    if (id != PW_ID_CORE) {
+        fail_write(client, id);
+        return;
+    }
+    
+    if (res == -EPIPE) {
+        g_message("PipeWire connection terminated");
+        pw->failed = TRUE;
+        // During connect the round trip reports the failure instead, and
+        // the connect releases the core. Otherwise that waits until this
+        // callback of the core's own has returned.
+        if (client->connected) {
+            pulse_client_connection_changed(client, FALSE);
+            if (!pw->teardown_source) {
+                pw->teardown_source = g_idle_add(teardown_callback, client);
+            }
+        }
+    }
+}
+
+static const struct pw_core_events core_events = {
+    PW_VERSION_CORE_EVENTS,
+    .done = core_done,
+    .error = core_error,
+};
+
+static gboolean on_loop_ready(gint fd, GIOCondition condition, gpointer user_data)
+{
+    pipewire_backend_t *pw = user_data;
+    
+    pw_loop_iterate(pw->loop, 0);
+    return G_SOURCE_CONTINUE;
+}
+
+// Block until the server has answered everything sent so far
+static gboolean roundtrip(pulse_client_t *client)
+{
+    pipewire_backend_t *pw = client->backend_data;
+    gint64 deadline = g_get_monotonic_time() + SYNC_TIMEOUT_US;
+    
+    pw->sync_done = FALSE;
+    pw->sync_seq = pw_core_sync(pw->core, PW_ID_CORE, pw->sync_seq);
+    
+    while (!pw->sync_done && !pw->failed) {
+        if (g_get_monotonic_time() > deadline) {
+            g_message("PipeWire connection timeout after %d seconds",
+                      (int)(SYNC_TIMEOUT_US / G_USEC_PER_SEC));
+            return FALSE;
+        }
+        
+        int res = pw_loop_iterate(pw->loop, 100);
+        if (res < 0 && res != -EINTR) {
+            g_message("PipeWire loop iteration failed: %s", spa_strerror(res));
+            return FALSE;
+        }
+    }
+    
+    return !pw->failed;
+}
+
+static void pipewire_cleanup(pulse_client_t *client)
+{
+    pipewire_backend_t *pw = client->backend_data;
+    if (!pw) {
+        return;
+    }
+    
+    pipewire_disconnect(client);
+    
+    if (pw->loop_source) {
+        g_source_remove(pw->loop_source);
+        pw->loop_source = 0;
+    }
+    
+    if (pw->context) {
+        pw_context_destroy(pw->context);
+        pw->context = NULL;
+    }
+    
+    if (pw->loop) {
+        pw_loop_leave(pw->loop);
+        pw_loop_destroy(pw->loop);
+        pw->loop = NULL;
+    }
+    
+    g_hash_table_destroy(pw->nodes);
+    g_hash_table_destroy(pw->devices);
+    g_hash_table_destroy(pw->pending_writes);
+    g_free(pw->default_sink_name);
+    g_free(pw);
+    client->backend_data = NULL;
+    
+    pw_deinit();
+}
+
+static gboolean pipewire_init(pulse_client_t *client)
+{
+    pw_init(NULL, NULL);
+    
+    pipewire_backend_t *pw = g_new0(pipewire_backend_t, 1);
+    client->backend_data = pw;
+    pw->nodes = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, node_free);
+    pw->devices = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, device_free);
+    pw->pending_writes = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+    pw->default_sink_id = SPA_ID_INVALID;
+    pw->metadata_id = SPA_ID_INVALID;
+    
+    pw->loop = pw_loop_new(NULL);
+    if (!pw->loop) {
+        g_message("Failed to create PipeWire loop");
+        pipewire_cleanup(client);
+        return FALSE;
+    }
+    pw_loop_enter(pw->loop);
+    
+    pw->context = pw_context_new(pw->loop, NULL, 0);
+    if (!pw->context) {
+        g_message("Failed to create PipeWire context");
+        pipewire_cleanup(client);
+        return FALSE;
+    }
+    
+    // Dispatch from the GLib main loop as soon as the daemon sends something
+    pw->loop_source = g_unix_fd_add(pw_loop_get_fd(pw->loop), G_IO_IN, on_loop_ready, pw);
+    
+    return TRUE;
+}
+
+static gboolean pipewire_connect(pulse_client_t *client)
+{
+    pipewire_backend_t *pw = client->backend_data;
+    
+    // A previous connection, lost or not, goes first; its listeners are
+    // still linked into the old core
+    pipewire_disconnect(client);
+    
+    // client->server names a remote other than the default pipewire-0
+    struct pw_properties *props = NULL;
+    if (client->server) {
+        props = pw_properties_new(PW_KEY_REMOTE_NAME, client->server, NULL);
+    }
+    
+    pw->core = pw_context_connect(pw->context, props, 0);
+    if (!pw->core) {
+        g_message("Failed to connect to PipeWire (%s): %s",
+                  client->server ? client->server : "default remote", strerror(errno));
+        return FALSE;
+    }
+    pw->failed = FALSE;
+    pw_core_add_listener(pw->core, &pw->core_listener, &core_events, client);
+    
+    pw->registry = pw_core_get_registry(pw->core, PW_VERSION_REGISTRY, 0);
+    pw_registry_add_listener(pw->registry, &pw->registry_listener, &registry_events, client);
+    
+    // The first round trip announces the globals and binds the nodes, the
+    // second brings in their info and volumes
+    if (!roundtrip(client) || !roundtrip(client)) {
+        pipewire_disconnect(client);
+        return FALSE;
+    }
+    
+    g_message("Connected to PipeWire");
+    
+    if (pw->default_sink_id == SPA_ID_INVALID) {
+        g_message("PipeWire: no default sink yet");
+    }
+    
+    // Blocking already, so the outcome is known before returning
+    pulse_client_connection_changed(client, TRUE);
+    return TRUE;
+}
+
+static void pipewire_disconnect(pulse_client_t *client)
+{
+    pipewire_backend_t *pw = client->backend_data;
+    
+    if (pw->teardown_source) {
+        g_source_remove(pw->teardown_source);
+        pw->teardown_source = 0;
+    }
+    
+    if (!pw->core) {
+        return;
+    }
+    
+    // Proxies go before the core that owns them
+    g_hash_table_remove_all(pw->nodes);
+    g_hash_table_remove_all(pw->devices);
+    g_hash_table_remove_all(pw->pending_writes);
+    
+    if (pw->metadata) {
+        spa_hook_remove(&pw->metadata_listener);
+        pw_proxy_destroy(pw->metadata);
+        pw->metadata = NULL;
+    }
+    
+    if (pw->registry) {
+        spa_hook_remove(&pw->registry_listener);
+        pw_proxy_destroy((struct pw_proxy *)pw->registry);
+        pw->registry = NULL;
+    }
+    
+    spa_hook_remove(&pw->core_listener);
+    pw_core_disconnect(pw->core);
+    pw->core = NULL;
+    pw->default_sink_id = SPA_ID_INVALID;
+}
+
+// The registry listener already tracks every stream; a refresh re-reports
+// them so anything the facade holds that is gone gets dropped
+static void pipewire_refresh_apps(pulse_client_t *client)
+{
+    pipewire_backend_t *pw = client->backend_data;
+    GHashTableIter iter;
+    gpointer value;
+    
+    pulse_client_registry_begin_refresh(client);
+    
+    g_hash_table_iter_init(&iter, pw->nodes);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        pipewire_node_t *node = value;
+        if (node->kind == NODE_KIND_STREAM) {
+            report_node(node, 0);
+        }
+    }
+    
+    pulse_client_registry_end_refresh(client);
+}
+
+// Build a Props object with channel volumes and/or mute (mute < 0 leaves
+// it alone)
+static struct spa_pod *build_props(struct spa_pod_builder *b, const pa_cvolume *volume, int mute)
+{
+    struct spa_pod_frame f;
+    
+    spa_pod_builder_push_object(b, &f, SPA_TYPE_OBJECT_Props, SPA_PARAM_Props);
+    
+    if (volume) {
+        float values[PA_CHANNELS_MAX];
+        for (unsigned int i = 0; i < volume->channels; i++) {
+            values[i] = (float)pa_sw_volume_to_linear(volume->values[i]);
+        }
+        spa_pod_builder_prop(b, SPA_PROP_channelVolumes, 0);
+        spa_pod_builder_array(b, sizeof(float), SPA_TYPE_Float, volume->channels, values);
+    }
+    
+    if (mute >= 0) {
+        spa_pod_builder_prop(b, SPA_PROP_mute, 0);
+        spa_pod_builder_bool(b, mute ? true : false);
+    }
+    
+    return (struct spa_pod *)spa_pod_builder_pop(b, &f);
+}
+
+// The setters return the proxy written to, NULL if the write couldn't be sent
+static struct pw_proxy *set_node_props(pipewire_node_t *node, const pa_cvolume *volume, int mute)
+{
+    uint8_t buffer[1024];
+    struct spa_pod_builder b = SPA_POD_BUILDER_INIT(buffer, sizeof(buffer));
+    
+    struct spa_pod *param = build_props(&b, volume, mute);
+    if (pw_node_set_param((struct pw_node *)node->proxy, SPA_PARAM_Props, 0, param) < 0) {
+        return NULL;
+    }
+    return node->proxy;
+}
+
+// The route the device currently plays the sink through, if any
+static const pipewire_route_t *find_route(pulse_client_t *client, pipewire_node_t *node,
+                                          pipewire_device_t **device_out)
+{
+    pipewire_backend_t *pw = client->backend_data;
+    pipewire_device_t *device = node->device_id != SPA_ID_INVALID ?
+        g_hash_table_lookup(pw->devices, GUINT_TO_POINTER(node->device_id)) : NULL;
+    
+    if (!device || node->profile_device < 0) {
+        return NULL;
+    }
+    
+    for (guint i = 0; i < device->routes->len; i++) {
+        const pipewire_route_t *route = &g_array_index(device->routes, pipewire_route_t, i);
+        if (route->device == node->profile_device) {
+            *device_out = device;
+            return route;
+        }
+    }
+    return NULL;
+}
+
+// Saved with the route, as the desktop's own controls do
+static struct pw_proxy *set_route_props(pipewire_device_t *device, const pipewire_route_t *route,
+                                        const pa_cvolume *volume, int mute)
+{
+    uint8_t buffer[1024];
+    struct spa_pod_builder b = SPA_POD_BUILDER_INIT(buffer, sizeof(buffer));
+    struct spa_pod_frame f;
+    
+    spa_pod_builder_push_object(&b, &f, SPA_TYPE_OBJECT_ParamRoute, SPA_PARAM_Route);
+    spa_pod_builder_prop(&b, SPA_PARAM_ROUTE_index, 0);
+    spa_pod_builder_int(&b, route->index);
+    spa_pod_builder_prop(&b, SPA_PARAM_ROUTE_device, 0);
+    spa_pod_builder_int(&b, route->device);
+    spa_pod_builder_prop(&b, SPA_PARAM_ROUTE_props, 0);
+    build_props(&b, volume, mute);
+    spa_pod_builder_prop(&b, SPA_PARAM_ROUTE_save, 0);
+    spa_pod_builder_bool(&b, true);
+    
+    struct spa_pod *param = (struct spa_pod *)spa_pod_builder_pop(&b, &f);
+    if (pw_device_set_param((struct pw_device *)device->proxy, SPA_PARAM_Route, 0, param) < 0) {
+        return NULL;
+    }
+    return device->proxy;
+}
+
+// The sink's node Props mirror the route, so reads stay on the node
+static struct pw_proxy *set_sink_props(pulse_client_t *client, pipewire_node_t *node,
+                                       const pa_cvolume *volume, int mute)
+{
+    pipewire_device_t *device = NULL;
+    const pipewire_route_t *route = find_route(client, node, &device);
+    
+    if (route) {
+        return set_route_props(device, route, volume, mute);
+    }
+    return set_node_props(node, volume, mute);
+}
+
+// set_param has no reply of its own; a core sync sent right after it
+// completes once the server has handled the write, unless an error on
+// 'target' came first
+static gboolean track_write(pulse_client_t *client, struct pw_proxy *target,
+                            pulse_client_write_t kind, gboolean master, uint32_t index,
+                            gboolean engine)
+{
+    pipewire_backend_t *pw = client->backend_data;
+    
+    if (!target) {
+        return FALSE;
+    }
+    
+    int seq = pw_core_sync(pw->core, PW_ID_CORE, 0);
+    if (seq < 0) {
+        return FALSE;
+    }
+    
+    pipewire_write_t *write = g_new(pipewire_write_t, 1);
+    write->kind = kind;
+    write->master = master;
+    write->index = index;
+    write->engine = engine;
+    write->proxy_id = pw_proxy_get_id(target);
+    g_hash_table_insert(pw->pending_writes, GINT_TO_POINTER(seq), write);
+    return TRUE;
+}
+
+static pipewire_node_t *find_node(pulse_client_t *client, uint32_t id)
+{
+    pipewire_backend_t *pw = client->backend_data;
+    return g_hash_table_lookup(pw->nodes, GUINT_TO_POINTER(id));
+}
+
+static gboolean pipewire_write_master_volume(pulse_client_t *client, const pa_cvolume *volume)
+{
+    pipewire_backend_t *pw = client->backend_data;
+    pipewire_node_t *node = find_node(client, pw->default_sink_id);
+    
+    if (!node) {
+        return FALSE;
+    }
+    
+    return track_write(client, set_sink_props(client, node, volume, -1),
+                       PULSE_CLIENT_WRITE_VOLUME, TRUE, node->id, FALSE);
+}
+
+static gboolean pipewire_write_master_mute(pulse_client_t *client, gboolean muted)
+{
+    pipewire_backend_t *pw = client->backend_data;
+    pipewire_node_t *node = find_node(client, pw->default_sink_id);
+    
+    if (!node) {
+        return FALSE;
+    }
+    
+    return track_write(client, set_sink_props(client, node, NULL, muted ? 1 : 0),
+                       PULSE_CLIENT_WRITE_MUTE, TRUE, node->id, FALSE);
+}
+
+static gboolean pipewire_write_app_volume(pulse_client_t *client, uint32_t index, const pa_cvolume *volume)
+{
+    pipewire_node_t *node = find_node(client, index);
+    
+    if (!node || node->kind != NODE_KIND_STREAM) {
+        return FALSE;
+    }
+    
+    return track_write(client, set_node_props(node, volume, -1),
+                       PULSE_CLIENT_WRITE_VOLUME, FALSE, index, FALSE);
+}
+
+static gboolean pipewire_write_app_mute(pulse_client_t *client, uint32_t index, gboolean muted,
+                                        gboolean engine)
+{
+    pipewire_node_t *node = find_node(client, index);
+    
+    if (!node || node->kind != NODE_KIND_STREAM) {
+        return FALSE;
+    }
+    
+    return track_write(client, set_node_props(node, NULL, muted ? 1 : 0),
+                       PULSE_CLIENT_WRITE_MUTE, FALSE, index, engine);
+}
+
+static guint pipewire_pending_requests(pulse_client_t *client)
+{
+    pipewire_backend_t *pw = client->backend_data;
+    return pw ? g_hash_table_size(pw->pending_writes) : 0;
+}
+
+const audio_backend_t pipewire_backend = {
+    .name = "pipewire",
+    .init = pipewire_init,
+    .cleanup = pipewire_cleanup,
+    .connect = pipewire_connect,
+    .disconnect = pipewire_disconnect,
+    .refresh_apps = pipewire_refresh_apps,
+    .write_master_volume = pipewire_write_master_volume,
+    .write_master_mute = pipewire_write_master_mute,
+    .write_app_volume = pipewire_write_app_volume,
+    .write_app_mute = pipewire_write_app_mute,
+    .pending_requests = pipewire_pending_requests,
+};
@@ -0,0 +1,715 @@
+#include "audio_backend.h"
+#include "flight_recorder.h"
+#include <pulse/glib-mainloop.h>
+#include <stdlib.h>
+#include <string.h>
+
+// libpulse backend. Also what runs on PipeWire desktops through the
+// pipewire-pulse compatibility server when the native backend isn't used.
+//
+// Contexts are driven by the GLib main loop through one pa_glib_mainloop
+// shared by every client, so each connection costs its socket and nothing
+// else: no thread, no polling timer.
+
+#define CONNECT_TIMEOUT_SECONDS 5
+#define LEVEL_RATE 10             // Peaks per second from a level monitor
+
+// Connection state kept in pulse_client_t.backend_data
+typedef struct {
+    pa_context *context;
+    guint pending_callbacks;  // Requests whose callback has yet to run
+    guint connect_timeout;    // Bounds a connect in progress
+    gboolean listing;         // A full sink input list is outstanding
+    gboolean relist;          // Another refresh was asked for meanwhile
+    GHashTable *monitors;     // sink input index -> level_monitor_t
+    GHashTable *writes;       // Outstanding app_write_t, owned here
+    GHashTable *event_times;  // sink input index -> gint64 arrival of its oldest unanswered event
+} pulse_backend_t;
+
+// Identifies the target of an in-flight sink input write
+typedef struct {
+    pulse_client_t *client;
+    uint32_t index;
+    gboolean engine;          // A mute the engine issued itself
+} app_write_t;
+
+// Peak-detecting record stream on one sink input, for loudness leveling
+typedef struct {
+    pulse_client_t *client;
+    uint32_t index;
+    pa_stream *stream;
+} level_monitor_t;
+
+static pa_glib_mainloop *shared_mainloop;
+static guint shared_mainloop_users;
+
+static void context_state_callback(pa_context *c, void *userdata);
+static void sink_info_callback(pa_context *c, const pa_sink_info *info, int eol, void *userdata);
+static void server_info_callback(pa_context *c, const pa_server_info *info, void *userdata);
+static void sink_input_info_callback(pa_context *c, const pa_sink_input_info *info, int eol, void *userdata);
+static void sink_input_list_callback(pa_context *c, const pa_sink_input_info *info, int eol, void *userdata);
+static void subscription_callback(pa_context *c, pa_subscription_event_type_t t, uint32_t index, void *userdata);
+static void subscribe_callback(pa_context *c, int success, void *userdata);
+static void master_volume_write_callback(pa_context *c, int success, void *userdata);
+static void app_volume_write_callback(pa_context *c, int success, void *userdata);
+static void master_mute_write_callback(pa_context *c, int success, void *userdata);
+static void app_mute_write_callback(pa_context *c, int success, void *userdata);
+static void pulse_refresh_apps(pulse_client_t *client);
+
+// Account for a request whose callback is still to come. The operation
+// itself is released right away; libpulse keeps its own reference until
+// the reply has been delivered.
+static gboolean issue_request(pulse_backend_t *pulse, pa_operation *o)
+{
+    if (!o) {
+        return FALSE;
+    }
+    
+    pa_operation_unref(o);
+    pulse->pending_callbacks++;
+    return TRUE;
+}
+
+static void request_done(pulse_backend_t *pulse)
+{
+    if (pulse->pending_callbacks > 0) {
+        pulse->pending_callbacks--;
+    }
+}
+
+static const char *server_label(pulse_client_t *client)
+{
+    return client->server ? client->server : "default server";
+}
+
+static void free_monitor(gpointer data)
+{
+    level_monitor_t *monitor = (level_monitor_t *)data;
+    
+    pa_stream_set_state_callback(monitor->stream, NULL, NULL);
+    pa_stream_set_read_callback(monitor->stream, NULL, NULL);
+    pa_stream_disconnect(monitor->stream);
+    pa_stream_unref(monitor->stream);
+    g_free(monitor);
+}
+
+// Requests die with their context without running their callbacks;
+// forget them so nothing reads as outstanding afterwards
+static void forget_requests(pulse_backend_t *pulse)
+{
+    pulse->pending_callbacks = 0;
+    g_hash_table_remove_all(pulse->writes);
+    g_hash_table_remove_all(pulse->event_times);
+    pulse->listing = FALSE;
+    pulse->relist = FALSE;
+}
+
+static void release_context(pulse_backend_t *pulse)
+{
+    if (!pulse->context) {
+        return;
+    }
+    
+    // Streams belong to the context and go before it
+    g_hash_table_remove_all(pulse->monitors);
+    
+    // Our own disconnect is not a state change worth reporting
+    pa_context_set_state_callback(pulse->context, NULL, NULL);
+    pa_context_set_subscribe_callback(pulse->context, NULL, NULL);
+    pa_context_disconnect(pulse->context);
+    pa_context_unref(pulse->context);
+    pulse->context = NULL;
+    forget_requests(pulse);
+}
+
+static void stop_connect_timeout(pulse_backend_t *pulse)
+{
+    if (pulse->connect_timeout) {
+        g_source_remove(pulse->connect_timeout);
+        pulse->connect_timeout = 0;
+    }
+}
+
+static void pulse_cleanup(pulse_client_t *client)
+{
+    pulse_backend_t *pulse = client->backend_data;
+    if (!pulse) {
+        return;
+    }
+    
+    stop_connect_timeout(pulse);
+    release_context(pulse);
+    
+    g_hash_table_destroy(pulse->monitors);
+    g_hash_table_destroy(pulse->writes);
+    g_hash_table_destroy(pulse->event_times);
+    g_free(pulse);
+    client->backend_data = NULL;
+    
+    if (shared_mainloop_users > 0 && --shared_mainloop_users == 0) {
+        pa_glib_mainloop_free(shared_mainloop);
+        shared_mainloop = NULL;
+    }
+}
+
+static gboolean pulse_init(pulse_client_t *client)
+{
+    if (!shared_mainloop) {
+        shared_mainloop = pa_glib_mainloop_new(NULL);
+        if (!shared_mainloop) {
+            g_message("Failed to create PulseAudio GLib mainloop");
+            return FALSE;
+        }
+    }
+    shared_mainloop_users++;
+    
+    pulse_backend_t *pulse = g_new0(pulse_backend_t, 1);
+    pulse->monitors = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, free_monitor);
+    pulse->writes = g_hash_table_new_full(g_direct_hash, g_direct_equal, g_free, NULL);
+    pulse->event_times = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+    
+    client->backend_data = pulse;
+    return TRUE;
+}
+
+static gboolean connect_timeout_callback(gpointer user_data)
+{
+    pulse_client_t *client = (pulse_client_t *)user_data;
+    pulse_backend_t *pulse = client->backend_data;
+    
+    pulse->connect_timeout = 0;
+    g_message("PulseAudio (%s): connection timeout after %d seconds",
+              server_label(client), CONNECT_TIMEOUT_SECONDS);
+    
+    release_context(pulse);
+    pulse_client_connection_changed(client, FALSE);
+    
+    return G_SOURCE_REMOVE;
+}
+
+// Start connecting; the outcome arrives through context_state_callback.
+// A context can only connect once, so every attempt gets a fresh one.
+static gboolean pulse_connect(pulse_client_t *client)
+{
+    pulse_backend_t *pulse = client->backend_data;
+    
+    stop_connect_timeout(pulse);
+    release_context(pulse);
+    
+    pulse->context = pa_context_new(pa_glib_mainloop_get_api(shared_mainloop), "volmix");
+    if (!pulse->context) {
+        g_message("Failed to create PulseAudio context");
+        return FALSE;
+    }
+    pa_context_set_state_callback(pulse->context, context_state_callback, client);
+    
+    if (pa_context_connect(pulse->context, client->server, PA_CONTEXT_NOFLAGS, NULL) < 0) {
+        g_message("Failed to connect to PulseAudio server (%s): %s", server_label(client),
+                  pa_strerror(pa_context_errno(pulse->context)));
+        release_context(pulse);
+        return FALSE;
+    }
+    
+    pulse->connect_timeout = g_timeout_add_seconds(CONNECT_TIMEOUT_SECONDS,
+                                                   connect_timeout_callback, client);
+    return TRUE;
+}
+
+// The context is ready: subscribe and look up the default sink. The
+// connection counts as established once that lookup has been answered.
+static void start_session(pulse_client_t *client)
+{
+    pulse_backend_t *pulse = client->backend_data;
+    
+    // Sink input events to detect when applications start/stop audio, sink
+    // events so master volume changed elsewhere is picked up, and server
+    // events for a different default sink being chosen
+    pa_context_set_subscribe_callback(pulse->context, subscription_callback, client);
+    issue_request(pulse, pa_context_subscribe(pulse->context,
+                                              PA_SUBSCRIPTION_MASK_SINK_INPUT |
+                                              PA_SUBSCRIPTION_MASK_SINK |
+                                              PA_SUBSCRIPTION_MASK_SERVER,
+                                              subscribe_callback, client));
+    
+    if (!issue_request(pulse, pa_context_get_server_info(pulse->context,
+                                                         server_info_callback, client))) {
+        g_message("Failed to get server info from PulseAudio");
+    }
+    
+    // Populate the registry in the background; it is kept current from
+    // subscription events after that
+    pulse_refresh_apps(client);
+}
+
+// The default sink lookup started by start_session has been answered
+static void master_lookup_done(pulse_client_t *client)
+{
+    if (!client->connecting) {
+        return;
+    }
+    
+    stop_connect_timeout(client->backend_data);
+    g_message("Connected to PulseAudio server (%s)", server_label(client));
+    pulse_client_connection_changed(client, TRUE);
+}
+
+static void pulse_disconnect(pulse_client_t *client)
+{
+    pulse_backend_t *pulse = client->backend_data;
+    if (!pulse) {
+        return;
+    }
+    
+    stop_connect_timeout(pulse);
+    release_context(pulse);
+}
+
+// One list at a time: a second one would bump the refresh serial under
+// the first, whose end would then drop streams only the second reported.
+// Refreshes asked for meanwhile are coalesced into one after it.
+static void pulse_refresh_apps(pulse_client_t *client)
+{
+    pulse_backend_t *pulse = client->backend_data;
+    
+    if (pulse->listing) {
+        pulse->relist = TRUE;
+        return;
+    }
+    
+    pulse_client_registry_begin_refresh(client);
+    
+    pulse->listing = issue_request(pulse, pa_context_get_sink_input_info_list(pulse->context,
+                                                                              sink_input_list_callback,
+                                                                              client));
+}
+
+static gboolean pulse_write_master_volume(pulse_client_t *client, const pa_cvolume *volume)
+{
+    pulse_backend_t *pulse = client->backend_data;
+    
+    return issue_request(pulse, pa_context_set_sink_volume_by_index(pulse->context,
+                                                                   client->default_sink_index,
+                                                                   volume,
+                                                                   master_volume_write_callback,
+                                                                   client));
+}
+
+static gboolean pulse_write_master_mute(pulse_client_t *client, gboolean muted)
+{
+    pulse_backend_t *pulse = client->backend_data;
+    
+    return issue_request(pulse, pa_context_set_sink_mute_by_index(pulse->context,
+                                                                 client->default_sink_index,
+                                                                 muted ? 1 : 0,
+                                                                 master_mute_write_callback,
+                                                                 client));
+}
+
+static gboolean pulse_write_app_volume(pulse_client_t *client, uint32_t index, const pa_cvolume *volume)
+{
+    pulse_backend_t *pulse = client->backend_data;
+    
+    app_write_t *write = g_new(app_write_t, 1);
+    write->client = client;
+    write->index = index;
+    write->engine = FALSE;
+    
+    if (!issue_request(pulse, pa_context_set_sink_input_volume(pulse->context,
+                                                               index,
+                                                               volume,
+                                                               app_volume_write_callback,
+                                                               write))) {
+        g_free(write);
+        return FALSE;
+    }
+    
+    g_hash_table_add(pulse->writes, write);
+    return TRUE;
+}
+
+static gboolean pulse_write_app_mute(pulse_client_t *client, uint32_t index, gboolean muted,
+                                     gboolean engine)
+{
+    pulse_backend_t *pulse = client->backend_data;
+    
+    app_write_t *write = g_new(app_write_t, 1);
+    write->client = client;
+    write->index = index;
+    write->engine = engine;
+    
+    if (!issue_request(pulse, pa_context_set_sink_input_mute(pulse->context,
+                                                             index,
+                                                             muted ? 1 : 0,
+                                                             app_mute_write_callback,
+                                                             write))) {
+        g_free(write);
+        return FALSE;
+    }
+    
+    g_hash_table_add(pulse->writes, write);
+    return TRUE;
+}
+
+static guint pulse_pending_requests(pulse_client_t *client)
+{
+    pulse_backend_t *pulse = client->backend_data;
+    return pulse ? pulse->pending_callbacks : 0;
+}
+
+static void level_read_callback(pa_stream *s, size_t length, void *userdata)
+{
+    level_monitor_t *monitor = (level_monitor_t *)userdata;
+    const void *data;
+    
+    if (pa_stream_peek(s, &data, &length) < 0) {
+        return;
+    }
+    
+    // A hole (no data but a length) is dropped like data
+    if (data && length >= sizeof(float)) {
+        // With PA_STREAM_PEAK_DETECT each sample is the peak of its period
+        float peak = ((const float *)data)[length / sizeof(float) - 1];
+        pulse_client_level_update(monitor->client, monitor->index, ABS(peak));
+    }
+    if (length > 0) {
+        pa_stream_drop(s);
+    }
+}
+
+static void level_state_callback(pa_stream *s, void *userdata)
+{
+    level_monitor_t *monitor = (level_monitor_t *)userdata;
+    pa_stream_state_t state = pa_stream_get_state(s);
+    
+    if (state == PA_STREAM_FAILED || state == PA_STREAM_TERMINATED) {
+        pulse_client_t *client = monitor->client;
+        uint32_t index = monitor->index;
+        pulse_backend_t *pulse = client->backend_data;
+        
+        // libpulse holds its own reference for the duration of the callback
+        g_hash_table_remove(pulse->monitors, GUINT_TO_POINTER(index));
+        pulse_client_level_update(client, index, -1.0f);
+    }
+}
+
+// A record stream tied to the sink input with pa_stream_set_monitor_stream
+// gets that stream's samples alone, after its volume, from the monitor of
+// whatever sink it plays on. The server reduces them to LEVEL_RATE peaks a
+// second, so a measured stream costs a few bytes a second here.
+static gboolean pulse_monitor_level(pulse_client_t *client, uint32_t index, gboolean enable)
+{
+    pulse_backend_t *pulse = client->backend_data;
+    
+    if (!enable) {
+        g_hash_table_remove(pulse->monitors, GUINT_TO_POINTER(index));
+        return TRUE;
+    }
+    
+    if (!pulse->context || g_hash_table_contains(pulse->monitors, GUINT_TO_POINTER(index))) {
+        return pulse->context != NULL;
+    }
+    
+    pa_sample_spec spec = { .format = PA_SAMPLE_FLOAT32NE, .rate = LEVEL_RATE, .channels = 1 };
+    pa_buffer_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.maxlength = (uint32_t)-1;
+    attr.fragsize = sizeof(float);
+    
+    pa_stream *stream = pa_stream_new(pulse->context, "volmix level", &spec, NULL);
+    if (!stream) {
+        g_message("Failed to create level monitor for sink input %u: %s",
+                  index, pa_strerror(pa_context_errno(pulse->context)));
+        return FALSE;
+    }
+    
+    level_monitor_t *monitor = g_new(level_monitor_t, 1);
+    monitor->client = client;
+    monitor->index = index;
+    monitor->stream = stream;
+    
+    pa_stream_set_monitor_stream(stream, index);
+    pa_stream_set_read_callback(stream, level_read_callback, monitor);
+    pa_stream_set_state_callback(stream, level_state_callback, monitor);
+    
+    if (pa_stream_connect_record(stream, NULL, &attr,
+                                 PA_STREAM_DONT_MOVE | PA_STREAM_PEAK_DETECT |
+                                 PA_STREAM_ADJUST_LATENCY |
+                                 PA_STREAM_DONT_INHIBIT_AUTO_SUSPEND) < 0) {
+        g_message("Failed to monitor sink input %u: %s",
+                  index, pa_strerror(pa_context_errno(pulse->context)));
+        free_monitor(monitor);
+        return FALSE;
+    }
+    
+    g_hash_table_insert(pulse->monitors, GUINT_TO_POINTER(index), monitor);
+    return TRUE;
+}
+
+// Callback functions
+static void context_state_callback(pa_context *c, void *userdata)
+{
+    pulse_client_t *client = (pulse_client_t *)userdata;
+    pulse_backend_t *pulse = client->backend_data;
+    
+    switch (pa_context_get_state(c)) {
+        case PA_CONTEXT_READY:
+            g_message("PulseAudio (%s): Ready", server_label(client));
+            start_session(client);
+            break;
+        case PA_CONTEXT_FAILED:
+        case PA_CONTEXT_TERMINATED:
+            g_message("PulseAudio (%s): %s", server_label(client),
+                      client->connected ? "Connection lost" : "Connection failed");
+            stop_connect_timeout(pulse);
+            forget_requests(pulse);
+            pulse_client_connection_changed(client, FALSE);
+            break;
+        default:
+            break;
+    }
+}
+
+static void sink_info_callback(pa_context *c, const pa_sink_info *info, int eol, void *userdata)
+{
+    pulse_client_t *client = (pulse_client_t *)userdata;
+    
+    if (eol != 0) {
+        request_done(client->backend_data);
+        master_lookup_done(client);
+        return;
+    }
+    
+    if (!info) {
+        return;
+    }
+    
+    pulse_client_registry_set_master(client, info->index, info->name, &info->volume,
+                                     &info->channel_map, info->mute ? TRUE : FALSE);
+    
+    g_debug("Default sink: %s (index=%u, volume=%d%%, muted=%s)",
+            info->name, info->index,
+            pulse_client_pa_volume_to_percent(pa_cvolume_max(&info->volume)),
+            info->mute ? "yes" : "no");
+}
+
+static void server_info_callback(pa_context *c, const pa_server_info *info, void *userdata)
+{
+    pulse_client_t *client = (pulse_client_t *)userdata;
+    pulse_backend_t *pulse = client->backend_data;
+    
+    request_done(pulse);
+    
+    if (!info || !info->default_sink_name) {
+        // Nothing to control the master volume on (any more)
+        if (client->default_sink_index != PA_INVALID_INDEX) {
+            pulse_client_registry_clear_master(client);
+        }
+        master_lookup_done(client);
+        return;
+    }
+    
+    // Server events also come for changes other than the default sink
+    if (client->connected && g_strcmp0(info->default_sink_name, client->default_sink_name) == 0) {
+        return;
+    }
+    
+    g_debug("Default sink name: %s", info->default_sink_name);
+    
+    // Get information about the default sink
+    if (!issue_request(pulse, pa_context_get_sink_info_by_name(c, info->default_sink_name,
+                                                               sink_info_callback, client))) {
+        master_lookup_done(client);
+    }
+}
+
+static void sink_input_info_callback(pa_context *c, const pa_sink_input_info *info, int eol, void *userdata)
+{
+    pulse_client_t *client = (pulse_client_t *)userdata;
+    
+    if (eol != 0) {
+        request_done(client->backend_data);
+        return;
+    }
+    
+    if (!info) {
+        return;
+    }
+    
+    // Set when an event asked for this info rather than a listing
+    pulse_backend_t *pulse = client->backend_data;
+    gint64 *event_us = g_hash_table_lookup(pulse->event_times, GUINT_TO_POINTER(info->index));
+    
+    audio_stream_info_t stream = {
+        .index = info->index,
+        // Extract application name from properties
+        .name = pa_proplist_gets(info->proplist, PA_PROP_APPLICATION_NAME),
+        .process_name = pa_proplist_gets(info->proplist, PA_PROP_APPLICATION_PROCESS_BINARY),
+        .icon_name = pa_proplist_gets(info->proplist, PA_PROP_APPLICATION_ICON_NAME),
+        .pid = pulse_client_parse_pid(pa_proplist_gets(info->proplist, PA_PROP_APPLICATION_PROCESS_ID)),
+        .volume = info->volume,
+        .channel_map = info->channel_map,
+        .muted = info->mute ? TRUE : FALSE,
+        .corked = info->corked ? TRUE : FALSE,
+        .event_us = event_us ? *event_us : 0,
+    };
+    
+    g_hash_table_remove(pulse->event_times, GUINT_TO_POINTER(info->index));
+    pulse_client_registry_update(client, &stream);
+}
+
+// Full listing: like sink_input_info_callback, then drop entries that
+// weren't reported once the list ends
+static void sink_input_list_callback(pa_context *c, const pa_sink_input_info *info, int eol, void *userdata)
+{
+    pulse_client_t *client = (pulse_client_t *)userdata;
+    
+    if (eol == 0) {
+        sink_input_info_callback(c, info, eol, userdata);
+        return;
+    }
+    
+    pulse_backend_t *pulse = client->backend_data;
+    
+    request_done(pulse);
+    pulse->listing = FALSE;
+    
+    // A failed listing keeps what we have rather than dropping everything
+    if (eol > 0) {
+        pulse_client_registry_end_refresh(client);
+    }
+    
+    if (pulse->relist) {
+        pulse->relist = FALSE;
+        pulse_refresh_apps(client);
+    }
+}
+
+// Subscription callback to handle PulseAudio events
+static void subscription_callback(pa_context *c, pa_subscription_event_type_t t, uint32_t index, void *userdata)
+{
+    pulse_client_t *client = (pulse_client_t *)userdata;
+    pa_subscription_event_type_t facility = t & PA_SUBSCRIPTION_EVENT_FACILITY_MASK;
+    pa_subscription_event_type_t type = t & PA_SUBSCRIPTION_EVENT_TYPE_MASK;
+    
+    flight_recorder_add("server-event", index, t, 0);
+    
+    // Check if this is a sink input event
+    if (facility == PA_SUBSCRIPTION_EVENT_SINK_INPUT) {
+        g_debug("Sink input event detected (index=%u, type=%s)", index,
+                type == PA_SUBSCRIPTION_EVENT_NEW ? "NEW" :
+                type == PA_SUBSCRIPTION_EVENT_REMOVE ? "REMOVE" : "CHANGE");
+        
+        pulse_backend_t *pulse = client->backend_data;
+        if (type == PA_SUBSCRIPTION_EVENT_REMOVE) {
+            g_hash_table_remove(pulse->event_times, GUINT_TO_POINTER(index));
+            pulse_client_registry_remove(client, index);
+            return;
+        }
+        
+        // Timed from the oldest event the reply answers
+        if (!g_hash_table_contains(pulse->event_times, GUINT_TO_POINTER(index))) {
+            gint64 *event_us = g_new(gint64, 1);
+            *event_us = g_get_monotonic_time();
+            g_hash_table_insert(pulse->event_times, GUINT_TO_POINTER(index), event_us);
+        }
+        
+        // Fetch only the stream that changed
+        if (!issue_request(pulse, pa_context_get_sink_input_info(c, index, sink_input_info_callback,
+                                                                 client))) {
+            g_hash_table_remove(pulse->event_times, GUINT_TO_POINTER(index));
+        }
+    } else if (facility == PA_SUBSCRIPTION_EVENT_SINK &&
+               type == PA_SUBSCRIPTION_EVENT_CHANGE &&
+               index == client->default_sink_index) {
+        issue_request(client->backend_data,
+                      pa_context_get_sink_info_by_index(c, index, sink_info_callback, client));
+    } else if (facility == PA_SUBSCRIPTION_EVENT_SERVER &&
+               type == PA_SUBSCRIPTION_EVENT_CHANGE) {
+        // Possibly a new default sink; look it up again
+        issue_request(client->backend_data,
+                      pa_context_get_server_info(c, server_info_callback, client));
+    }
+}
+
+static void subscribe_callback(pa_context *c, int success, void *userdata)
+{
+    pulse_client_t *client = (pulse_client_t *)userdata;
+    
+    request_done(client->backend_data);
+    if (!success) {
+        g_message("Failed to subscribe to PulseAudio events: %s",
+                  pa_strerror(pa_context_errno(c)));
+    }
+}
+
+static void master_volume_write_callback(pa_context *c, int success, void *userdata)
+{
+    pulse_client_t *client = (pulse_client_t *)userdata;
+    
+    request_done(client->backend_data);
+    if (!success) {
+        g_message("Failed to set master volume: %s", pa_strerror(pa_context_errno(c)));
+    }
+    
+    pulse_client_master_write_done(client, success ? TRUE : FALSE);
+}
+
+static void app_volume_write_callback(pa_context *c, int success, void *userdata)
+{
+    app_write_t *write = (app_write_t *)userdata;
+    pulse_client_t *client = write->client;
+    uint32_t index = write->index;
+    
+    request_done(client->backend_data);
+    g_hash_table_remove(((pulse_backend_t *)client->backend_data)->writes, write);
+    if (!success) {
+        g_message("Failed to set volume for sink input %u: %s",
+                  index, pa_strerror(pa_context_errno(c)));
+    }
+    
+    pulse_client_app_write_done(client, index, success ? TRUE : FALSE);
+}
+
+static void master_mute_write_callback(pa_context *c, int success, void *userdata)
+{
+    pulse_client_t *client = (pulse_client_t *)userdata;
+    
+    request_done(client->backend_data);
+    if (!success) {
+        g_message("Failed to set master mute: %s", pa_strerror(pa_context_errno(c)));
+    }
+    
+    pulse_client_master_mute_done(client, success ? TRUE : FALSE);
+}
+
+static void app_mute_write_callback(pa_context *c, int success, void *userdata)
+{
+    app_write_t *write = (app_write_t *)userdata;
+    pulse_client_t *client = write->client;
+    uint32_t index = write->index;
+    gboolean engine = write->engine;
+    
+    request_done(client->backend_data);
+    g_hash_table_remove(((pulse_backend_t *)client->backend_data)->writes, write);
+    if (!success) {
+        g_message("Failed to set mute for sink input %u: %s",
+                  index, pa_strerror(pa_context_errno(c)));
+    }
+    
+    pulse_client_app_mute_done(client, index, success ? TRUE : FALSE, engine);
+}
+
+const audio_backend_t pulse_backend = {
+    .name = "pulse",
+    .init = pulse_init,
+    .cleanup = pulse_cleanup,
+    .connect = pulse_connect,
+    .disconnect = pulse_disconnect,
+    .refresh_apps = pulse_refresh_apps,
+    .write_master_volume = pulse_write_master_volume,
+    .write_master_mute = pulse_write_master_mute,
+    .write_app_volume = pulse_write_app_volume,
+    .write_app_mute = pulse_write_app_mute,
+    .pending_requests = pulse_pending_requests,
+    .monitor_level = pulse_monitor_level,
+};
@@ -0,0 +1,296 @@
+#include "audio_backend.h"
+#include "event_trace.h"
+#include <string.h>
+
+// Replay backend: feeds a trace recorded with $VOLMIX_TRACE back through
+// the registry calls the live backends make, without any sound server.
+// The trace file is the server string (or $VOLMIX_REPLAY). By default
+// records are replayed as fast as the main loop takes them, one per
+// dispatch so UI updates interleave as they would live; with
+// $VOLMIX_REPLAY_SPEED=realtime the recorded gaps are kept.
+//
+// Writes are accepted and completed on the next main loop pass; the trace
+// has no server to echo them.
+
+// Target of a write awaiting its completion
+typedef struct {
+    pulse_client_write_t kind;
+    gboolean master;
+    uint32_t index;
+    gboolean engine;          // A mute the engine issued itself
+} replay_write_t;
+
+// Replay state kept in pulse_client_t.backend_data
+typedef struct {
+    gchar *data;              // Whole trace, records point into it
+    gsize length;
+    const guint8 *cursor;
+    event_trace_record_t record;
+    gboolean realtime;
+    gint64 started_us;        // Monotonic time the replay started
+    guint records;
+    guint replay_source;
+    GQueue writes;            // replay_write_t, completed in order
+    guint write_source;
+} replay_backend_t;
+
+static void stop_replay(replay_backend_t *replay)
+{
+    if (replay->replay_source) {
+        g_source_remove(replay->replay_source);
+        replay->replay_source = 0;
+    }
+    
+    g_free(replay->data);
+    replay->data = NULL;
+    replay->cursor = NULL;
+}
+
+static gboolean replay_init(pulse_client_t *client)
+{
+    replay_backend_t *replay = g_new0(replay_backend_t, 1);
+    g_queue_init(&replay->writes);
+    replay->realtime = g_strcmp0(g_getenv("VOLMIX_REPLAY_SPEED"), "realtime") == 0;
+    
+    client->backend_data = replay;
+    return TRUE;
+}
+
+static void replay_disconnect(pulse_client_t *client)
+{
+    replay_backend_t *replay = client->backend_data;
+    if (!replay) {
+        return;
+    }
+    
+    stop_replay(replay);
+}
+
+static void replay_cleanup(pulse_client_t *client)
+{
+    replay_backend_t *replay = client->backend_data;
+    if (!replay) {
+        return;
+    }
+    
+    stop_replay(replay);
+    if (replay->write_source) {
+        g_source_remove(replay->write_source);
+    }
+    while (!g_queue_is_empty(&replay->writes)) {
+        g_free(g_queue_pop_head(&replay->writes));
+    }
+    
+    g_free(replay);
+    client->backend_data = NULL;
+}
+
+// Hand one record to the registry, exactly as a live backend would
+static void apply_record(pulse_client_t *client, const event_trace_record_t *record)
+{
+    switch (record->type) {
+        case EVENT_TRACE_STREAM:
+            pulse_client_registry_update(client, &record->info);
+            break;
+        case EVENT_TRACE_REMOVE:
+            pulse_client_registry_remove(client, record->info.index);
+            break;
+        case EVENT_TRACE_BEGIN_REFRESH:
+            pulse_client_registry_begin_refresh(client);
+            break;
+        case EVENT_TRACE_END_REFRESH:
+            pulse_client_registry_end_refresh(client);
+            break;
+        case EVENT_TRACE_MASTER:
+            if (record->info.index == PA_INVALID_INDEX) {
+                pulse_client_registry_clear_master(client);
+                break;
+            }
+            pulse_client_registry_set_master(client, record->info.index, record->info.name,
+                                             &record->info.volume, &record->info.channel_map,
+                                             record->info.muted);
+            break;
+        case EVENT_TRACE_CONNECTION:
+            pulse_client_connection_changed(client, record->connected);
+            break;
+    }
+}
+
+static gboolean replay_next_callback(gpointer user_data);
+
+// Arm the source for the record at the cursor, or finish
+static void schedule_next(pulse_client_t *client)
+{
+    replay_backend_t *replay = client->backend_data;
+    const guint8 *end = (const guint8 *)replay->data + replay->length;
+    
+    if (!event_trace_next(&replay->cursor, end, &replay->record)) {
+        gint64 elapsed = g_get_monotonic_time() - replay->started_us;
+        g_message("Replay finished: %u records in %.2f ms (recorded over %.2f ms)%s",
+                  replay->records, elapsed / 1000.0, replay->record.time_us / 1000.0,
+                  replay->cursor < end ? ", trace truncated" : "");
+        replay->replay_source = 0;
+        
+        // A trace cut short before the connection was established
+        if (client->connecting) {
+            pulse_client_connection_changed(client, FALSE);
+        }
+        return;
+    }
+    
+    if (replay->realtime) {
+        gint64 due = replay->started_us + replay->record.time_us;
+        gint64 delay = MAX(due - g_get_monotonic_time(), 0);
+        replay->replay_source = g_timeout_add((guint)(delay / 1000), replay_next_callback, client);
+    } else {
+        replay->replay_source = g_idle_add(replay_next_callback, client);
+    }
+}
+
+static gboolean replay_next_callback(gpointer user_data)
+{
+    pulse_client_t *client = (pulse_client_t *)user_data;
+    replay_backend_t *replay = client->backend_data;
+    
+    replay->replay_source = 0;
+    replay->records++;
+    apply_record(client, &replay->record);
+    
+    // The record may have ended the replay (disconnect from a listener)
+    if (replay->data && !replay->replay_source) {
+        schedule_next(client);
+    }
+    
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean replay_connect(pulse_client_t *client)
+{
+    replay_backend_t *replay = client->backend_data;
+    const char *path = client->server ? client->server : g_getenv("VOLMIX_REPLAY");
+    GError *error = NULL;
+    
+    stop_replay(replay);
+    
+    if (!path || !*path) {
+        g_message("Replay backend needs a trace file (server string or $VOLMIX_REPLAY)");
+        return FALSE;
+    }
+    
+    if (!g_file_get_contents(path, &replay->data, &replay->length, &error)) {
+        g_message("Failed to read trace %s: %s", path, error->message);
+        g_error_free(error);
+        return FALSE;
+    }
+    
+    if (!event_trace_begin((const guint8 *)replay->data, replay->length, &replay->cursor)) {
+        g_message("%s is not a volmix event trace", path);
+        stop_replay(replay);
+        return FALSE;
+    }
+    
+    g_message("Replaying %s (%zu bytes, %s)", path, replay->length,
+              replay->realtime ? "real time" : "as fast as possible");
+    
+    // The trace's own connection record reports the outcome
+    memset(&replay->record, 0, sizeof(replay->record));
+    replay->records = 0;
+    replay->started_us = g_get_monotonic_time();
+    schedule_next(client);
+    return TRUE;
+}
+
+// The registry already holds what the trace said; a re-list has nothing
+// newer to report
+static void replay_refresh_apps(pulse_client_t *client)
+{
+}
+
+static gboolean complete_writes_callback(gpointer user_data)
+{
+    pulse_client_t *client = (pulse_client_t *)user_data;
+    replay_backend_t *replay = client->backend_data;
+    GQueue batch = replay->writes;
+    replay_write_t *write;
+    
+    // Completions may send coalesced values as new writes; those wait for
+    // the next pass like any other
+    replay->write_source = 0;
+    g_queue_init(&replay->writes);
+    
+    while ((write = g_queue_pop_head(&batch))) {
+        if (write->kind == PULSE_CLIENT_WRITE_VOLUME) {
+            if (write->master) {
+                pulse_client_master_write_done(client, TRUE);
+            } else {
+                pulse_client_app_write_done(client, write->index, TRUE);
+            }
+        } else if (write->master) {
+            pulse_client_master_mute_done(client, TRUE);
+        } else {
+            pulse_client_app_mute_done(client, write->index, TRUE, write->engine);
+        }
+        g_free(write);
+    }
+    
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean queue_write(pulse_client_t *client, pulse_client_write_t kind,
+                            gboolean master, uint32_t index, gboolean engine)
+{
+    replay_backend_t *replay = client->backend_data;
+    replay_write_t *write = g_new(replay_write_t, 1);
+    
+    write->kind = kind;
+    write->master = master;
+    write->index = index;
+    write->engine = engine;
+    g_queue_push_tail(&replay->writes, write);
+    
+    if (!replay->write_source) {
+        replay->write_source = g_idle_add(complete_writes_callback, client);
+    }
+    return TRUE;
+}
+
+static gboolean replay_write_master_volume(pulse_client_t *client, const pa_cvolume *volume)
+{
+    return queue_write(client, PULSE_CLIENT_WRITE_VOLUME, TRUE, client->default_sink_index, FALSE);
+}
+
+static gboolean replay_write_master_mute(pulse_client_t *client, gboolean muted)
+{
+    return queue_write(client, PULSE_CLIENT_WRITE_MUTE, TRUE, client->default_sink_index, FALSE);
+}
+
+static gboolean replay_write_app_volume(pulse_client_t *client, uint32_t index, const pa_cvolume *volume)
+{
+    return queue_write(client, PULSE_CLIENT_WRITE_VOLUME, FALSE, index, FALSE);
+}
+
+static gboolean replay_write_app_mute(pulse_client_t *client, uint32_t index, gboolean muted,
+                                      gboolean engine)
+{
+    return queue_write(client, PULSE_CLIENT_WRITE_MUTE, FALSE, index, engine);
+}
+
+static guint replay_pending_requests(pulse_client_t *client)
+{
+    replay_backend_t *replay = client->backend_data;
+    return replay ? g_queue_get_length(&replay->writes) : 0;
+}
+
+const audio_backend_t replay_backend = {
+    .name = "replay",
+    .init = replay_init,
+    .cleanup = replay_cleanup,
+    .connect = replay_connect,
+    .disconnect = replay_disconnect,
+    .refresh_apps = replay_refresh_apps,
+    .write_master_volume = replay_write_master_volume,
+    .write_master_mute = replay_write_master_mute,
+    .write_app_volume = replay_write_app_volume,
+    .write_app_mute = replay_write_app_mute,
+    .pending_requests = replay_pending_requests,
+};
@@ -0,0 +1,86 @@
+#include "caps.h"
+#include "conf.h"
+
+#define CAPS_GROUP "caps"
+
+struct volume_caps {
+    GHashTable *caps;             // "app.<name>" / "sink.<name>" -> percent + 1
+};
+
+volume_caps_t* volume_caps_load(void)
+{
+    GKeyFile *keyfile = g_key_file_new();
+    char *path = conf_path("volmix.conf");
+    GError *error = NULL;
+    volume_caps_t *caps = NULL;
+    
+    if (!g_key_file_load_from_file(keyfile, path, G_KEY_FILE_NONE, &error)) {
+        if (!g_error_matches(error, G_FILE_ERROR, G_FILE_ERROR_NOENT)) {
+            g_message("Failed to read %s: %s", path, error->message);
+        }
+        g_error_free(error);
+        g_key_file_free(keyfile);
+        g_free(path);
+        return NULL;
+    }
+    
+    gchar **keys = g_key_file_get_keys(keyfile, CAPS_GROUP, NULL, NULL);
+    for (gchar **key = keys; key && *key; key++) {
+        int value = g_key_file_get_integer(keyfile, CAPS_GROUP, *key, &error);
+        gboolean known = g_str_has_prefix(*key, "app.") || g_str_has_prefix(*key, "sink.");
+        
+        if (error || !known || value < 0 || value > 100) {
+            g_message("%s: ignoring cap %s", path, *key);
+            g_clear_error(&error);
+            continue;
+        }
+        
+        if (!caps) {
+            caps = g_new0(volume_caps_t, 1);
+            caps->caps = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+        }
+        // Stored off by one so a cap of 0 isn't a NULL lookup
+        g_hash_table_insert(caps->caps, g_strdup(*key), GINT_TO_POINTER(value + 1));
+    }
+    g_strfreev(keys);
+    
+    if (caps) {
+        g_message("Loaded %u volume caps from %s", g_hash_table_size(caps->caps), path);
+    }
+    
+    g_key_file_free(keyfile);
+    g_free(path);
+    return caps;
+}
+
+void volume_caps_free(volume_caps_t *caps)
+{
+    if (!caps) {
+        return;
+    }
+    
+    g_hash_table_destroy(caps->caps);
+    g_free(caps);
+}
+
+static int lookup(const volume_caps_t *caps, const char *prefix, const char *name)
+{
+    if (!caps || !name || !name[0]) {
+        return -1;
+    }
+    
+    char *key = conf_key(prefix, name);
+    int value = GPOINTER_TO_INT(g_hash_table_lookup(caps->caps, key)) - 1;
+    g_free(key);
+    return value;
+}
+
+int volume_caps_for_app(const volume_caps_t *caps, const char *process_name, const char *name)
+{
+    return lookup(caps, "app.", process_name && process_name[0] ? process_name : name);
+}
+
+int volume_caps_for_sink(const volume_caps_t *caps, const char *sink_name)
+{
+    return lookup(caps, "sink.", sink_name);
+}
@@ -0,0 +1,28 @@
+#ifndef CAPS_H
+#define CAPS_H
+
+#include <glib.h>
+
+// Maximum volumes from $XDG_CONFIG_HOME/volmix/volmix.conf:
+//
+//   [caps]
+//   app.firefox=60
+//   app.steam=40
+//   sink.alsa_output.usb-headset.analog-stereo=50
+//
+// Applications are named as in scenes (process name, else stream name),
+// sinks by their server name; characters other than letters, digits and
+// "._-" are read as '_'. Values are percent of the loudest channel. The
+// file is read once per client; caps are resolved when a stream appears
+// or is renamed, so checking one costs nothing per event.
+typedef struct volume_caps volume_caps_t;
+
+// NULL when the file has no caps
+volume_caps_t* volume_caps_load(void);
+void volume_caps_free(volume_caps_t *caps);
+
+// Cap in percent, -1 for none. caps may be NULL.
+int volume_caps_for_app(const volume_caps_t *caps, const char *process_name, const char *name);
+int volume_caps_for_sink(const volume_caps_t *caps, const char *sink_name);
+
+#endif // CAPS_H
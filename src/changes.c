@@ -0,0 +1,101 @@
+#include "changes.h"
+
+// Consumers further behind than this many removals resync from the whole
+// registry instead (see pulse_client_changes_since)
+#define MAX_TOMBSTONES 256
+
+typedef struct {
+    uint32_t index;
+    guint64 generation;
+} tombstone_t;
+
+// A stream with a generation is in the list, linked through its own node
+static void unlink_app(pulse_client_t *client, app_audio_t *app)
+{
+    if (app->generation) {
+        g_queue_unlink(&client->changes, &app->change_link);
+    }
+}
+
+void changes_record_app(pulse_client_t *client, app_audio_t *app)
+{
+    // Moving it to the tail keeps the list ordered by generation
+    unlink_app(client, app);
+    app->generation = ++client->generation;
+    app->change_link.data = app;
+    g_queue_push_tail_link(&client->changes, &app->change_link);
+}
+
+void changes_record_removed(pulse_client_t *client, app_audio_t *app)
+{
+    unlink_app(client, app);
+    app->generation = 0;
+    
+    tombstone_t *tombstone = g_new(tombstone_t, 1);
+    tombstone->index = app->index;
+    tombstone->generation = ++client->generation;
+    g_queue_push_tail(&client->tombstones, tombstone);
+    
+    if (client->tombstones.length > MAX_TOMBSTONES) {
+        tombstone_t *oldest = g_queue_pop_head(&client->tombstones);
+        client->tombstone_floor = oldest->generation;
+        g_free(oldest);
+    }
+}
+
+void changes_record_master(pulse_client_t *client)
+{
+    client->master_generation = ++client->generation;
+}
+
+void changes_clear(pulse_client_t *client)
+{
+    tombstone_t *tombstone;
+    
+    g_queue_init(&client->changes);
+    while ((tombstone = g_queue_pop_head(&client->tombstones))) {
+        g_free(tombstone);
+    }
+}
+
+guint64 pulse_client_get_generation(pulse_client_t *client)
+{
+    return client ? client->generation : 0;
+}
+
+guint64 pulse_client_get_master_generation(pulse_client_t *client)
+{
+    return client ? client->master_generation : 0;
+}
+
+gboolean pulse_client_changes_since(pulse_client_t *client, guint64 since,
+                                    pulse_client_removed_func removed,
+                                    pulse_client_app_func changed, gpointer user_data)
+{
+    GList *first = NULL;
+    
+    if (!client || since < client->tombstone_floor) {
+        return FALSE;
+    }
+    
+    // Removals first: an index can come back as a new stream (PipeWire
+    // reuses ids), and that stream's entry is newer than its tombstone
+    for (GList *link = client->tombstones.tail;
+         link && ((tombstone_t *)link->data)->generation > since; link = link->prev) {
+        first = link;
+    }
+    for (GList *link = first; link && removed; link = link->next) {
+        removed(client, ((tombstone_t *)link->data)->index, user_data);
+    }
+    
+    first = NULL;
+    for (GList *link = client->changes.tail;
+         link && ((app_audio_t *)link->data)->generation > since; link = link->prev) {
+        first = link;
+    }
+    for (GList *link = first; link && changed; link = link->next) {
+        changed(client, (app_audio_t *)link->data, user_data);
+    }
+    
+    return TRUE;
+}
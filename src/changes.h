@@ -0,0 +1,23 @@
+#ifndef CHANGES_H
+#define CHANGES_H
+
+#include "pulse_client.h"
+
+// Change log behind pulse_client_changes_since. Every registry change
+// takes the next generation; streams are kept in a list ordered by their
+// last change and removals leave a tombstone, so a consumer N changes
+// behind catches up in O(N) whatever the size of the registry.
+
+// A stream was added, or its state differs from what was reported before
+void changes_record_app(pulse_client_t *client, app_audio_t *app);
+
+// A stream is about to be freed
+void changes_record_removed(pulse_client_t *client, app_audio_t *app);
+
+// The master sink or the connection state changed
+void changes_record_master(pulse_client_t *client);
+
+// Forget the log; the streams must already be gone
+void changes_clear(pulse_client_t *client);
+
+#endif // CHANGES_H
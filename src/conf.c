@@ -0,0 +1,14 @@
+#include "conf.h"
+#include <string.h>
+
+char* conf_path(const char *file)
+{
+    return g_build_filename(g_get_user_config_dir(), "volmix", file, NULL);
+}
+
+char* conf_key(const char *prefix, const char *name)
+{
+    char *key = g_strconcat(prefix, name, NULL);
+    g_strcanon(key + strlen(prefix), G_CSET_A_2_Z G_CSET_a_2_z G_CSET_DIGITS "._-", '_');
+    return key;
+}
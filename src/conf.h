@@ -0,0 +1,15 @@
+#ifndef CONF_H
+#define CONF_H
+
+#include <glib.h>
+
+// Files under $XDG_CONFIG_HOME/volmix, e.g. "volmix.conf" or "scenes.ini"
+char* conf_path(const char *file);
+
+// prefix followed by name, with every character of name other than
+// letters, digits and "._-" replaced by '_', so any application or sink
+// name makes a key file key. Caps, scenes and the calendar mute list all
+// match names through this, so they agree on what a name is.
+char* conf_key(const char *prefix, const char *name);
+
+#endif // CONF_H
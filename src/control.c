@@ -0,0 +1,389 @@
+#include "control.h"
+#include "proc_stats.h"
+#include "scenes.h"
+#include <glib-unix.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+typedef gboolean (*control_handler_t)(volmix_t *vm, int argc, char **argv, GString *reply);
+
+typedef struct {
+    const char *name;
+    int min_args;
+    int max_args;
+    control_handler_t handler;
+} control_command_t;
+
+static gboolean parse_int(const char *text, int *value)
+{
+    char *end = NULL;
+    gint64 parsed = g_ascii_strtoll(text, &end, 10);
+    
+    if (!text[0] || *end || parsed < G_MININT || parsed > G_MAXINT) {
+        return FALSE;
+    }
+    
+    *value = (int)parsed;
+    return TRUE;
+}
+
+static gboolean parse_index(const char *text, uint32_t *index)
+{
+    int value;
+    if (!parse_int(text, &value) || value < 0) {
+        return FALSE;
+    }
+    
+    *index = (uint32_t)value;
+    return TRUE;
+}
+
+static gboolean cmd_status(volmix_t *vm, int argc, char **argv, GString *reply)
+{
+    g_string_append_printf(reply, "backend %s, master %d%%%s, %u streams\n",
+                           volmix_get_backend_name(vm),
+                           volmix_get_master_volume(vm),
+                           volmix_get_master_muted(vm) ? " (muted)" : "",
+                           volmix_get_stream_count(vm));
+    return TRUE;
+}
+
+// Resource counters for watching a long-running session for growth
+static gboolean cmd_stats(volmix_t *vm, int argc, char **argv, GString *reply)
+{
+    int64_t avg_us, max_us, event_avg_us, event_max_us, cap_max_us;
+    guint writes = volmix_get_write_stats(vm, &avg_us, &max_us);
+    guint events = volmix_get_event_stats(vm, &event_avg_us, &event_max_us);
+    guint capped = volmix_get_cap_stats(vm, &cap_max_us);
+    
+    g_string_append_printf(reply,
+                           "streams %u, pending requests %u, writes %u "
+                           "(avg %.2f ms, max %.2f ms), events %u (avg %.2f ms, max %.2f ms), "
+                           "capped %u (max %.2f ms), RSS %ld KiB\n",
+                           volmix_get_stream_count(vm),
+                           volmix_get_pending_requests(vm),
+                           writes, avg_us / 1000.0, max_us / 1000.0,
+                           events, event_avg_us / 1000.0, event_max_us / 1000.0,
+                           capped, cap_max_us / 1000.0,
+                           proc_stats_get_rss_kib());
+    return TRUE;
+}
+
+static gboolean cmd_volume(volmix_t *vm, int argc, char **argv, GString *reply)
+{
+    volmix_status_t status = VOLMIX_OK;
+    
+    if (argc == 2) {
+        int value;
+        if (!parse_int(argv[1], &value)) {
+            g_string_append_printf(reply, "invalid volume: %s\n", argv[1]);
+            return FALSE;
+        }
+        
+        // A sign makes it a step from the current volume
+        if (argv[1][0] == '+' || argv[1][0] == '-') {
+            status = volmix_step_master_volume(vm, value, NULL, NULL);
+        } else {
+            status = volmix_set_master_volume(vm, value, NULL, NULL);
+        }
+    }
+    
+    g_string_append_printf(reply, "%d%%\n", volmix_get_master_volume(vm));
+    return status == VOLMIX_OK;
+}
+
+static gboolean cmd_mute(volmix_t *vm, int argc, char **argv, GString *reply)
+{
+    volmix_status_t status = volmix_set_master_muted(vm, !volmix_get_master_muted(vm),
+                                                     NULL, NULL);
+    
+    g_string_append(reply, volmix_get_master_muted(vm) ? "muted\n" : "unmuted\n");
+    return status == VOLMIX_OK;
+}
+
+static void list_stream(volmix_stream_t *stream, void *user_data)
+{
+    GString *reply = (GString *)user_data;
+    
+    g_string_append_printf(reply, "%u\t%d%%\t%s\t%s\n",
+                           volmix_stream_get_index(stream),
+                           volmix_stream_get_volume(stream),
+                           volmix_stream_get_muted(stream) ? "muted" : "-",
+                           volmix_stream_get_name(stream));
+}
+
+static gboolean cmd_list(volmix_t *vm, int argc, char **argv, GString *reply)
+{
+    volmix_foreach_stream(vm, list_stream, reply);
+    return TRUE;
+}
+
+static gboolean cmd_app_volume(volmix_t *vm, int argc, char **argv, GString *reply)
+{
+    uint32_t index;
+    int value;
+    
+    if (!parse_index(argv[1], &index) || !parse_int(argv[2], &value)) {
+        g_string_append(reply, "usage: app-volume INDEX N\n");
+        return FALSE;
+    }
+    
+    volmix_stream_t *stream = volmix_find_stream(vm, index);
+    if (volmix_stream_set_volume(stream, value, NULL, NULL) != VOLMIX_OK) {
+        g_string_append_printf(reply, "cannot set volume of stream %u\n", index);
+        return FALSE;
+    }
+    
+    g_string_append_printf(reply, "%d%%\n", volmix_stream_get_volume(stream));
+    return TRUE;
+}
+
+static gboolean cmd_app_mute(volmix_t *vm, int argc, char **argv, GString *reply)
+{
+    uint32_t index;
+    volmix_stream_t *stream = NULL;
+    
+    if (!parse_index(argv[1], &index) || !(stream = volmix_find_stream(vm, index))) {
+        g_string_append_printf(reply, "no such stream: %s\n", argv[1]);
+        return FALSE;
+    }
+    
+    if (volmix_stream_set_muted(stream, !volmix_stream_get_muted(stream), NULL, NULL) != VOLMIX_OK) {
+        g_string_append_printf(reply, "cannot toggle mute of stream %u\n", index);
+        return FALSE;
+    }
+    
+    // The new state arrives with the server's change event
+    g_string_append(reply, "ok\n");
+    return TRUE;
+}
+
+static gboolean cmd_scenes(volmix_t *vm, int argc, char **argv, GString *reply)
+{
+    gchar **names = scenes_list();
+    
+    for (gchar **name = names; name && *name; name++) {
+        g_string_append_printf(reply, "%s\n", *name);
+    }
+    
+    g_strfreev(names);
+    return TRUE;
+}
+
+static gboolean cmd_scene_save(volmix_t *vm, int argc, char **argv, GString *reply)
+{
+    if (!scenes_save(vm, argv[1])) {
+        g_string_append_printf(reply, "cannot save scene %s\n", argv[1]);
+        return FALSE;
+    }
+    
+    g_string_append(reply, "saved\n");
+    return TRUE;
+}
+
+static gboolean cmd_scene_recall(volmix_t *vm, int argc, char **argv, GString *reply)
+{
+    guint writes, skipped;
+    
+    if (!scenes_recall(vm, argv[1], &writes, &skipped, NULL, NULL)) {
+        g_string_append_printf(reply, "no such scene: %s\n", argv[1]);
+        return FALSE;
+    }
+    
+    // Completion and latency are logged once the server has answered
+    g_string_append_printf(reply, "%u writes sent, %u streams unchanged\n", writes, skipped);
+    return TRUE;
+}
+
+static gboolean cmd_scene_delete(volmix_t *vm, int argc, char **argv, GString *reply)
+{
+    if (!scenes_delete(argv[1])) {
+        g_string_append_printf(reply, "no such scene: %s\n", argv[1]);
+        return FALSE;
+    }
+    
+    g_string_append(reply, "deleted\n");
+    return TRUE;
+}
+
+static void list_stream_level(volmix_stream_t *stream, void *user_data)
+{
+    GString *reply = (GString *)user_data;
+    
+    g_string_append_printf(reply, "%u\t%.1f dBFS\t%d%%\t%s\n",
+                           volmix_stream_get_index(stream),
+                           volmix_stream_get_level(stream),
+                           volmix_stream_get_volume(stream),
+                           volmix_stream_get_name(stream));
+}
+
+static gboolean cmd_leveling(volmix_t *vm, int argc, char **argv, GString *reply)
+{
+    float target = VOLMIX_LEVELING_DEFAULT_DBFS;
+    
+    if (argc >= 2) {
+        gboolean enable = strcmp(argv[1], "on") == 0;
+        
+        if (!enable && (strcmp(argv[1], "off") != 0 || argc > 2)) {
+            g_string_append(reply, "usage: leveling [on [DB]|off]\n");
+            return FALSE;
+        }
+        if (argc == 3) {
+            char *end = NULL;
+            target = (float)g_ascii_strtod(argv[2], &end);
+            if (end == argv[2] || *end) {
+                g_string_append_printf(reply, "invalid level: %s\n", argv[2]);
+                return FALSE;
+            }
+        }
+        if (volmix_set_leveling(vm, enable, target) != VOLMIX_OK) {
+            g_string_append(reply, "leveling unavailable on this backend or target out of range\n");
+            return FALSE;
+        }
+    }
+    
+    if (!volmix_get_leveling(vm, &target)) {
+        g_string_append(reply, "off\n");
+        return TRUE;
+    }
+    
+    g_string_append_printf(reply, "on, target %.1f dBFS\n", target);
+    volmix_foreach_stream(vm, list_stream_level, reply);
+    return TRUE;
+}
+
+static gboolean cmd_schedule(volmix_t *vm, int argc, char **argv, GString *reply)
+{
+    int64_t next_us;
+    int cap;
+    
+    if (argc > 1 && strcmp(argv[1], "reload") != 0) {
+        g_string_append(reply, "usage: schedule [reload]\n");
+        return FALSE;
+    }
+    if (argc > 1) {
+        volmix_reload_schedule(vm);
+    }
+    
+    unsigned int rules = volmix_get_schedule(vm, &next_us, &cap);
+    g_string_append_printf(reply, "%u rules", rules);
+    if (next_us >= 0) {
+        g_string_append_printf(reply, ", next deadline in %lld s",
+                               (long long)(next_us / G_USEC_PER_SEC));
+    }
+    if (cap >= 0) {
+        g_string_append_printf(reply, ", master capped at %d%%", cap);
+    }
+    g_string_append_c(reply, '\n');
+    return TRUE;
+}
+
+static char* default_flight_path(void)
+{
+    char *name = g_strdup_printf("volmix-flight-%d.log", (int)getpid());
+    char *path = g_build_filename(g_get_user_runtime_dir(), name, NULL);
+    
+    g_free(name);
+    return path;
+}
+
+// Works while disconnected too: that is often what is being diagnosed
+static gboolean cmd_flight_dump(volmix_t *vm, int argc, char **argv, GString *reply)
+{
+    char *path = argc > 1 ? g_strdup(argv[1]) : default_flight_path();
+    gboolean ok = volmix_flight_dump(path);
+    
+    g_string_append_printf(reply, ok ? "written to %s\n" : "failed to write %s\n", path);
+    g_free(path);
+    return ok;
+}
+
+static gboolean on_flight_signal(gpointer user_data)
+{
+    char *path = default_flight_path();
+    
+    volmix_flight_dump(path);
+    g_free(path);
+    return G_SOURCE_CONTINUE;
+}
+
+void control_watch_flight_signal(void)
+{
+    // Dispatched from the main loop, where dumping is safe
+    g_unix_signal_add(SIGUSR1, on_flight_signal, NULL);
+}
+
+static gboolean cmd_help(volmix_t *vm, int argc, char **argv, GString *reply);
+
+static const control_command_t commands[] = {
+    { "status",     0, 0, cmd_status },
+    { "stats",      0, 0, cmd_stats },
+    { "volume",     0, 1, cmd_volume },
+    { "mute",       0, 0, cmd_mute },
+    { "list",       0, 0, cmd_list },
+    { "app-volume", 2, 2, cmd_app_volume },
+    { "app-mute",   1, 1, cmd_app_mute },
+    { "scenes",     0, 0, cmd_scenes },
+    { "scene-save", 1, 1, cmd_scene_save },
+    { "scene-recall", 1, 1, cmd_scene_recall },
+    { "scene-delete", 1, 1, cmd_scene_delete },
+    { "leveling",   0, 2, cmd_leveling },
+    { "schedule",   0, 1, cmd_schedule },
+    { "flight-dump", 0, 1, cmd_flight_dump },
+    { "help",       0, 0, cmd_help },
+};
+
+static gboolean cmd_help(volmix_t *vm, int argc, char **argv, GString *reply)
+{
+    g_string_append(reply,
+                    "status | stats | volume [N|+N|-N] | mute | list | "
+                    "app-volume INDEX N | app-mute INDEX | scenes | scene-save NAME | "
+                    "scene-recall NAME | scene-delete NAME | leveling [on [DB]|off] | "
+                    "schedule [reload] | flight-dump [PATH] | help\n");
+    return TRUE;
+}
+
+gboolean control_execute(volmix_t *vm, const char *line, GString *reply)
+{
+    int argc = 0;
+    char **argv = NULL;
+    
+    if (!vm || !line || !reply) {
+        return FALSE;
+    }
+    
+    if (!g_shell_parse_argv(line, &argc, &argv, NULL)) {
+        // Blank lines and unbalanced quotes alike
+        g_string_append(reply, "empty or malformed command\n");
+        return FALSE;
+    }
+    
+    gboolean ok = FALSE;
+    gboolean found = FALSE;
+    for (gsize i = 0; i < G_N_ELEMENTS(commands); i++) {
+        const control_command_t *command = &commands[i];
+        if (strcmp(argv[0], command->name) != 0) {
+            continue;
+        }
+        
+        found = TRUE;
+        if (argc - 1 < command->min_args || argc - 1 > command->max_args) {
+            g_string_append_printf(reply, "wrong number of arguments for %s\n", command->name);
+        } else if (!volmix_is_connected(vm) && command->handler != cmd_help &&
+                   command->handler != cmd_flight_dump) {
+            g_string_append(reply, "not connected\n");
+        } else {
+            ok = command->handler(vm, argc, argv, reply);
+        }
+        break;
+    }
+    
+    if (!found) {
+        g_string_append_printf(reply, "unknown command: %s (try help)\n", argv[0]);
+    }
+    
+    g_strfreev(argv);
+    return ok;
+}
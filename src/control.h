@@ -0,0 +1,34 @@
+#ifndef CONTROL_H
+#define CONTROL_H
+
+#include <glib.h>
+#include "libvolmix.h"
+
+// Text command interface shared by the front ends. One command per line:
+//
+//   status                     backend, master volume/mute, stream count
+//   stats                      streams, pending requests, write round trips,
+//                              event latency, caps, RSS
+//   volume [N|+N|-N]           show, set or step the master volume
+//   mute                       toggle master mute
+//   list                       one stream per line: index, volume, mute, name
+//   app-volume INDEX N         set a stream's volume
+//   app-mute INDEX             toggle a stream's mute
+//   scenes                     saved scene names, one per line
+//   scene-save NAME            store the current mixer state as a scene
+//   scene-recall NAME          apply a scene in one batch of writes
+//   scene-delete NAME          forget a scene
+//   leveling [on [DB]|off]     show or switch loudness leveling, target in dBFS
+//   schedule [reload]          timed policies: rules waiting, next deadline, quiet cap
+//   flight-dump [PATH]         write the flight recorder (default path below)
+//   help                       this list
+//
+// The reply (possibly several lines, each newline terminated) is appended
+// to 'reply'. Returns FALSE if the command was unknown or failed.
+gboolean control_execute(volmix_t *vm, const char *line, GString *reply);
+
+// Write the library's flight recorder to $XDG_RUNTIME_DIR/volmix-flight-PID.log
+// on SIGUSR1, as the flight-dump command does
+void control_watch_flight_signal(void);
+
+#endif // CONTROL_H
@@ -0,0 +1,306 @@
+#include "event_trace.h"
+#include <stdio.h>
+#include <string.h>
+
+#define TRACE_MAGIC "VMXTRC02"
+#define TRACE_MAGIC_LENGTH 8
+#define TRACE_NULL_STRING 0xffff
+
+struct event_trace {
+    FILE *file;
+    char *path;
+    gint64 last_us;           // Monotonic time of the previous record
+    guint records;
+};
+
+static gboolean trace_in_use;
+
+event_trace_t* event_trace_open(const char *path)
+{
+    if (trace_in_use) {
+        g_message("Already recording an event trace, not tracing to %s", path);
+        return NULL;
+    }
+    
+    FILE *file = fopen(path, "wb");
+    if (!file || fwrite(TRACE_MAGIC, 1, TRACE_MAGIC_LENGTH, file) != TRACE_MAGIC_LENGTH) {
+        g_message("Failed to create event trace %s", path);
+        if (file) {
+            fclose(file);
+        }
+        return NULL;
+    }
+    
+    event_trace_t *trace = g_new0(event_trace_t, 1);
+    trace->file = file;
+    trace->path = g_strdup(path);
+    trace->last_us = g_get_monotonic_time();
+    trace_in_use = TRUE;
+    
+    g_message("Recording event trace to %s", path);
+    return trace;
+}
+
+void event_trace_close(event_trace_t *trace)
+{
+    if (!trace) {
+        return;
+    }
+    
+    fclose(trace->file);
+    g_message("Event trace %s: %u records", trace->path, trace->records);
+    
+    g_free(trace->path);
+    g_free(trace);
+    trace_in_use = FALSE;
+}
+
+// Writers. Records go through stdio buffering, so recording costs a
+// memcpy per event rather than a system call.
+
+static void put_u8(event_trace_t *trace, guint8 value)
+{
+    fputc(value, trace->file);
+}
+
+static void put_u16(event_trace_t *trace, guint16 value)
+{
+    guint16 le = GUINT16_TO_LE(value);
+    fwrite(&le, sizeof(le), 1, trace->file);
+}
+
+static void put_u32(event_trace_t *trace, guint32 value)
+{
+    guint32 le = GUINT32_TO_LE(value);
+    fwrite(&le, sizeof(le), 1, trace->file);
+}
+
+static void put_string(event_trace_t *trace, const char *value)
+{
+    if (!value) {
+        put_u16(trace, TRACE_NULL_STRING);
+        return;
+    }
+    
+    gsize length = MIN(strlen(value), TRACE_NULL_STRING - 1);
+    put_u16(trace, (guint16)length);
+    fwrite(value, 1, length, trace->file);
+    put_u8(trace, 0);
+}
+
+static void put_volume(event_trace_t *trace, const pa_cvolume *volume,
+                       const pa_channel_map *channel_map)
+{
+    put_u8(trace, volume->channels);
+    for (guint8 i = 0; i < volume->channels; i++) {
+        put_u32(trace, volume->values[i]);
+    }
+    
+    put_u8(trace, channel_map->channels);
+    for (guint8 i = 0; i < channel_map->channels; i++) {
+        put_u8(trace, (guint8)channel_map->map[i]);
+    }
+}
+
+static void put_header(event_trace_t *trace, event_trace_type_t type)
+{
+    gint64 now = g_get_monotonic_time();
+    gint64 delta = now - trace->last_us;
+    
+    trace->last_us = now;
+    trace->records++;
+    
+    put_u8(trace, (guint8)type);
+    put_u32(trace, (guint32)CLAMP(delta, 0, G_MAXUINT32));
+}
+
+void event_trace_record_stream(event_trace_t *trace, const audio_stream_info_t *info)
+{
+    put_header(trace, EVENT_TRACE_STREAM);
+    put_u32(trace, info->index);
+    put_u32(trace, info->pid);
+    put_u8(trace, (info->muted ? 1 : 0) | (info->corked ? 2 : 0));
+    put_volume(trace, &info->volume, &info->channel_map);
+    put_string(trace, info->name);
+    put_string(trace, info->process_name);
+    put_string(trace, info->icon_name);
+}
+
+void event_trace_record_remove(event_trace_t *trace, uint32_t index)
+{
+    put_header(trace, EVENT_TRACE_REMOVE);
+    put_u32(trace, index);
+}
+
+void event_trace_record_refresh(event_trace_t *trace, gboolean begin)
+{
+    put_header(trace, begin ? EVENT_TRACE_BEGIN_REFRESH : EVENT_TRACE_END_REFRESH);
+}
+
+void event_trace_record_master(event_trace_t *trace, uint32_t index, const char *name,
+                               const pa_cvolume *volume, const pa_channel_map *channel_map,
+                               gboolean muted)
+{
+    put_header(trace, EVENT_TRACE_MASTER);
+    put_u32(trace, index);
+    put_u8(trace, muted ? 1 : 0);
+    put_volume(trace, volume, channel_map);
+    put_string(trace, name);
+}
+
+void event_trace_record_connection(event_trace_t *trace, gboolean connected)
+{
+    put_header(trace, EVENT_TRACE_CONNECTION);
+    put_u8(trace, connected ? 1 : 0);
+}
+
+// Readers. Each one checks the remaining length, so a truncated trace
+// (recording cut short by a crash) ends the replay cleanly.
+
+typedef struct {
+    const guint8 *pos;
+    const guint8 *end;
+    gboolean ok;
+} trace_reader_t;
+
+static const guint8* take(trace_reader_t *reader, gsize length)
+{
+    if (!reader->ok || (gsize)(reader->end - reader->pos) < length) {
+        reader->ok = FALSE;
+        return NULL;
+    }
+    
+    const guint8 *data = reader->pos;
+    reader->pos += length;
+    return data;
+}
+
+static guint8 get_u8(trace_reader_t *reader)
+{
+    const guint8 *data = take(reader, 1);
+    return data ? data[0] : 0;
+}
+
+static guint16 get_u16(trace_reader_t *reader)
+{
+    guint16 le = 0;
+    const guint8 *data = take(reader, sizeof(le));
+    if (data) {
+        memcpy(&le, data, sizeof(le));
+    }
+    return GUINT16_FROM_LE(le);
+}
+
+static guint32 get_u32(trace_reader_t *reader)
+{
+    guint32 le = 0;
+    const guint8 *data = take(reader, sizeof(le));
+    if (data) {
+        memcpy(&le, data, sizeof(le));
+    }
+    return GUINT32_FROM_LE(le);
+}
+
+static const char* get_string(trace_reader_t *reader)
+{
+    guint16 length = get_u16(reader);
+    if (length == TRACE_NULL_STRING) {
+        return NULL;
+    }
+    
+    const guint8 *data = take(reader, (gsize)length + 1);
+    if (data && data[length] != 0) {
+        reader->ok = FALSE;
+    }
+    return reader->ok ? (const char *)data : NULL;
+}
+
+static void get_volume(trace_reader_t *reader, pa_cvolume *volume, pa_channel_map *channel_map)
+{
+    memset(volume, 0, sizeof(*volume));
+    memset(channel_map, 0, sizeof(*channel_map));
+    
+    volume->channels = get_u8(reader);
+    if (volume->channels > PA_CHANNELS_MAX) {
+        reader->ok = FALSE;
+        return;
+    }
+    for (guint8 i = 0; i < volume->channels; i++) {
+        volume->values[i] = get_u32(reader);
+    }
+    
+    channel_map->channels = get_u8(reader);
+    if (channel_map->channels > PA_CHANNELS_MAX) {
+        reader->ok = FALSE;
+        return;
+    }
+    for (guint8 i = 0; i < channel_map->channels; i++) {
+        channel_map->map[i] = (pa_channel_position_t)get_u8(reader);
+    }
+}
+
+gboolean event_trace_begin(const guint8 *data, gsize length, const guint8 **cursor)
+{
+    if (length < TRACE_MAGIC_LENGTH || memcmp(data, TRACE_MAGIC, TRACE_MAGIC_LENGTH) != 0) {
+        return FALSE;
+    }
+    
+    *cursor = data + TRACE_MAGIC_LENGTH;
+    return TRUE;
+}
+
+gboolean event_trace_next(const guint8 **cursor, const guint8 *end,
+                          event_trace_record_t *record)
+{
+    trace_reader_t reader = { *cursor, end, TRUE };
+    audio_stream_info_t *info = &record->info;
+    
+    if (reader.pos >= reader.end) {
+        return FALSE;
+    }
+    
+    record->type = (event_trace_type_t)get_u8(&reader);
+    record->time_us += get_u32(&reader);
+    memset(info, 0, sizeof(*info));
+    record->connected = FALSE;
+    
+    switch (record->type) {
+        case EVENT_TRACE_STREAM: {
+            info->index = get_u32(&reader);
+            info->pid = get_u32(&reader);
+            guint8 flags = get_u8(&reader);
+            info->muted = (flags & 1) != 0;
+            info->corked = (flags & 2) != 0;
+            get_volume(&reader, &info->volume, &info->channel_map);
+            info->name = get_string(&reader);
+            info->process_name = get_string(&reader);
+            info->icon_name = get_string(&reader);
+            break;
+        }
+        case EVENT_TRACE_REMOVE:
+            info->index = get_u32(&reader);
+            break;
+        case EVENT_TRACE_BEGIN_REFRESH:
+        case EVENT_TRACE_END_REFRESH:
+            break;
+        case EVENT_TRACE_MASTER:
+            info->index = get_u32(&reader);
+            info->muted = get_u8(&reader) != 0;
+            get_volume(&reader, &info->volume, &info->channel_map);
+            info->name = get_string(&reader);
+            break;
+        case EVENT_TRACE_CONNECTION:
+            record->connected = get_u8(&reader) != 0;
+            break;
+        default:
+            reader.ok = FALSE;
+            break;
+    }
+    
+    if (!reader.ok) {
+        return FALSE;
+    }
+    
+    *cursor = reader.pos;
+    return TRUE;
+}
@@ -0,0 +1,61 @@
+#ifndef EVENT_TRACE_H
+#define EVENT_TRACE_H
+
+#include "audio_backend.h"
+
+// Binary trace of what a backend reports to the registry: stream info
+// replies, removals, refresh brackets, master updates and connection
+// changes, each stamped with the time since the previous record. Recorded
+// with $VOLMIX_TRACE=<file>, replayed through the same registry calls by
+// the "replay" backend, so an event storm captured on a user's machine
+// becomes a repeatable benchmark.
+//
+// Layout (little endian): the 8 byte magic "VMXTRC02", then records of
+//   u8 type, u32 delta_us, payload
+// Strings are u16 length (0xffff for NULL), the bytes and a NUL, so a
+// loaded trace can be handed out without copying.
+
+typedef enum {
+    EVENT_TRACE_STREAM = 1,       // info: a stream info reply
+    EVENT_TRACE_REMOVE,           // info.index: a stream went away
+    EVENT_TRACE_BEGIN_REFRESH,
+    EVENT_TRACE_END_REFRESH,
+    EVENT_TRACE_MASTER,           // info.index/name/volume/channel_map/muted;
+                                  // PA_INVALID_INDEX when the master went away
+    EVENT_TRACE_CONNECTION        // connected
+} event_trace_type_t;
+
+typedef struct {
+    event_trace_type_t type;
+    gint64 time_us;               // Since the start of the trace
+    audio_stream_info_t info;     // Strings point into the trace buffer
+    gboolean connected;
+} event_trace_record_t;
+
+typedef struct event_trace event_trace_t;
+
+// Start recording to 'path'; NULL if it can't be created. Only one trace
+// is recorded per process, further calls return NULL.
+event_trace_t* event_trace_open(const char *path);
+
+// Flush and close; prints the record count
+void event_trace_close(event_trace_t *trace);
+
+void event_trace_record_stream(event_trace_t *trace, const audio_stream_info_t *info);
+void event_trace_record_remove(event_trace_t *trace, uint32_t index);
+void event_trace_record_refresh(event_trace_t *trace, gboolean begin);
+void event_trace_record_master(event_trace_t *trace, uint32_t index, const char *name,
+                               const pa_cvolume *volume, const pa_channel_map *channel_map,
+                               gboolean muted);
+void event_trace_record_connection(event_trace_t *trace, gboolean connected);
+
+// Check the magic of a loaded trace; *cursor is set to the first record
+gboolean event_trace_begin(const guint8 *data, gsize length, const guint8 **cursor);
+
+// Decode the record at *cursor and advance past it. time_us accumulates
+// into record->time_us, so pass the same record for the whole trace.
+// FALSE at the end or on a truncated/corrupt record.
+gboolean event_trace_next(const guint8 **cursor, const guint8 *end,
+                          event_trace_record_t *record);
+
+#endif // EVENT_TRACE_H
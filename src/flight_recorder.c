@@ -0,0 +1,81 @@
+#include "flight_recorder.h"
+#include <errno.h>
+#include <stdio.h>
+#include <time.h>
+
+typedef struct {
+    gint sequence;                // Position + 1 once complete, 0 while written
+    int64_t time_ns;
+    const char *what;
+    uint32_t index;
+    int64_t value;
+    int64_t duration_ns;
+} flight_entry_t;
+
+// Static so recording never allocates; a slot is claimed with one atomic
+// add, so no lock is taken even if a second thread ever records
+static flight_entry_t ring[FLIGHT_RECORDER_SIZE];
+static gint next_position;
+
+int64_t flight_recorder_now_ns(void)
+{
+    struct timespec now;
+    
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+void flight_recorder_add(const char *what, uint32_t index, int64_t value, int64_t duration_ns)
+{
+    guint position = (guint)g_atomic_int_add(&next_position, 1);
+    flight_entry_t *entry = &ring[position & (FLIGHT_RECORDER_SIZE - 1)];
+    
+    // A reader seeing 0 or another position skips the slot as torn
+    g_atomic_int_set(&entry->sequence, 0);
+    entry->time_ns = flight_recorder_now_ns();
+    entry->what = what;
+    entry->index = index;
+    entry->value = value;
+    entry->duration_ns = duration_ns;
+    g_atomic_int_set(&entry->sequence, (gint)(position + 1));
+}
+
+gboolean flight_recorder_dump(const char *path)
+{
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        g_message("Failed to write flight recorder to %s: %s", path, g_strerror(errno));
+        return FALSE;
+    }
+    
+    guint end = (guint)g_atomic_int_get(&next_position);
+    guint start = end > FLIGHT_RECORDER_SIZE ? end - FLIGHT_RECORDER_SIZE : 0;
+    int64_t now_ns = flight_recorder_now_ns();
+    guint written = 0;
+    
+    // Times are relative to the dump, so the last moments read first-hand
+    fprintf(file, "# volmix flight recorder: %u of %u entries, times in ms before the dump\n",
+            end - start, end);
+    fprintf(file, "# %-10s %-16s %-10s %12s %14s\n", "ms", "what", "index", "value", "duration_ms");
+    for (guint position = start; position != end; position++) {
+        const flight_entry_t *entry = &ring[position & (FLIGHT_RECORDER_SIZE - 1)];
+        if ((guint)g_atomic_int_get(&entry->sequence) != position + 1) {
+            continue;
+        }
+        
+        char index[16];
+        if (entry->index == FLIGHT_MASTER) {
+            g_strlcpy(index, "master", sizeof(index));
+        } else {
+            g_snprintf(index, sizeof(index), "%u", entry->index);
+        }
+        fprintf(file, "%12.6f %-16s %-10s %12lld %14.6f\n",
+                (entry->time_ns - now_ns) / 1e6, entry->what, index, (long long)entry->value,
+                entry->duration_ns / 1e6);
+        written++;
+    }
+    
+    gboolean ok = fclose(file) == 0;
+    g_message("Flight recorder: %u entries written to %s", written, path);
+    return ok;
+}
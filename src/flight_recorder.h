@@ -0,0 +1,31 @@
+#ifndef FLIGHT_RECORDER_H
+#define FLIGHT_RECORDER_H
+
+#include <glib.h>
+#include <stdint.h>
+
+// Always-on history of the engine's recent past for diagnosing incidents
+// after the fact: server events, stream reports, writes sent and answered,
+// connection changes and the front ends' UI updates. Entries go into a
+// fixed ring in memory, so recording costs a clock read and a few stores;
+// nothing is written out until flight_recorder_dump.
+//
+// Unlike event_trace (a full recording of registry input for replay) this
+// keeps only the last FLIGHT_RECORDER_SIZE entries and can't be replayed.
+
+#define FLIGHT_RECORDER_SIZE 4096     // Entries kept; a power of two
+#define FLIGHT_MASTER G_MAXUINT32     // 'index' of entries about the master sink
+
+// Record an entry. 'what' must be a string literal or otherwise live for
+// the life of the process: only the pointer is stored. 'value' depends on
+// 'what' (a volume, a success flag, a count); duration_ns is 0 if untimed.
+void flight_recorder_add(const char *what, uint32_t index, int64_t value, int64_t duration_ns);
+
+// CLOCK_MONOTONIC in nanoseconds, the recorder's time base
+int64_t flight_recorder_now_ns(void);
+
+// Write the entries, oldest first, to 'path' as text. FALSE if it can't
+// be written.
+gboolean flight_recorder_dump(const char *path);
+
+#endif // FLIGHT_RECORDER_H
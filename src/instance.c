@@ -0,0 +1,275 @@
+#include "instance.h"
+#include <glib/gstdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define SOCKET_NAME "volmix.sock"
+#define LOCK_NAME "volmix.lock"
+#define REPLY_TIMEOUT_SECONDS 10  // The instance may still be connecting to its server
+#define MAX_REQUEST 4096
+
+typedef struct {
+    int listen_fd;
+    int lock_fd;              // flock held for the life of the instance
+    char *socket_path;
+    guint watch;
+    instance_command_cb cb;
+    gpointer user_data;
+} instance_t;
+
+static instance_t instance = { -1, -1, NULL, 0, NULL, NULL };
+
+// One connection from a later launch, read until it shuts down its side
+typedef struct {
+    GIOChannel *channel;
+    GString *request;
+} instance_client_t;
+
+static char* runtime_path(const char *name)
+{
+    return g_build_filename(g_get_user_runtime_dir(), name, NULL);
+}
+
+static gboolean socket_address(const char *path, struct sockaddr_un *addr)
+{
+    if (strlen(path) >= sizeof(addr->sun_path)) {
+        return FALSE;
+    }
+    
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    strcpy(addr->sun_path, path);
+    return TRUE;
+}
+
+// send() rather than write() so a peer that went away is an error, not SIGPIPE
+static gboolean send_all(int fd, const char *data, gsize length)
+{
+    while (length > 0) {
+        ssize_t sent = send(fd, data, length, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return FALSE;
+        }
+        data += sent;
+        length -= (gsize)sent;
+    }
+    return TRUE;
+}
+
+gboolean instance_forward(const char *line, gboolean *ok)
+{
+    char *path = runtime_path(SOCKET_NAME);
+    struct sockaddr_un addr;
+    gboolean valid = socket_address(path, &addr);
+    g_free(path);
+    
+    // A socket file left by a crashed instance refuses the connection
+    int fd = valid ? socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0) : -1;
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return FALSE;
+    }
+    
+    struct timeval timeout = { REPLY_TIMEOUT_SECONDS, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    
+    *ok = FALSE;
+    if (!send_all(fd, line, strlen(line)) || !send_all(fd, "\n", 1) ||
+        shutdown(fd, SHUT_WR) < 0) {
+        printf("Failed to send to the running volmix: %s\n", g_strerror(errno));
+        close(fd);
+        return TRUE;
+    }
+    
+    char buffer[4096];
+    ssize_t length;
+    gboolean first = TRUE;
+    while ((length = read(fd, buffer, sizeof(buffer))) > 0) {
+        const char *data = buffer;
+        if (first) {
+            *ok = buffer[0] == '+';
+            data++;
+            length--;
+            first = FALSE;
+        }
+        fwrite(data, 1, (size_t)length, stdout);
+    }
+    if (first) {
+        printf("No reply from the running volmix\n");
+    }
+    
+    close(fd);
+    return TRUE;
+}
+
+// The lock settles launches racing each other; the socket file alone
+// can't, since it may be left over from a crash
+static int take_lock(void)
+{
+    char *dir = g_strdup(g_get_user_runtime_dir());
+    char *path = runtime_path(LOCK_NAME);
+    
+    g_mkdir_with_parents(dir, 0700);
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd >= 0 && flock(fd, LOCK_EX | LOCK_NB) < 0) {
+        close(fd);
+        fd = -1;
+    }
+    
+    g_free(path);
+    g_free(dir);
+    return fd;
+}
+
+static int listen_socket(const char *path)
+{
+    struct sockaddr_un addr;
+    
+    if (!socket_address(path, &addr)) {
+        printf("Socket path too long: %s\n", path);
+        return -1;
+    }
+    
+    g_unlink(path);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 16) < 0) {
+        printf("Failed to listen on %s: %s\n", path, g_strerror(errno));
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    return fd;
+}
+
+gboolean instance_claim(void)
+{
+    int lock_fd = take_lock();
+    if (lock_fd < 0) {
+        return FALSE;
+    }
+    
+    char *socket_path = runtime_path(SOCKET_NAME);
+    int fd = listen_socket(socket_path);
+    if (fd < 0) {
+        close(lock_fd);
+        g_free(socket_path);
+        return FALSE;
+    }
+    
+    instance.listen_fd = fd;
+    instance.lock_fd = lock_fd;
+    instance.socket_path = socket_path;
+    return TRUE;
+}
+
+static void client_free(instance_client_t *client)
+{
+    g_io_channel_shutdown(client->channel, FALSE, NULL);
+    g_io_channel_unref(client->channel);
+    g_string_free(client->request, TRUE);
+    g_free(client);
+}
+
+static void answer(instance_client_t *client)
+{
+    GString *reply = g_string_new(NULL);
+    int fd = g_io_channel_unix_get_fd(client->channel);
+    
+    g_strstrip(client->request->str);
+    gboolean ok = instance.cb && client->request->str[0] &&
+                  instance.cb(client->request->str, reply, instance.user_data);
+    g_string_prepend_c(reply, ok ? '+' : '-');
+    
+    // Replies are a few lines and fit the socket buffer, so this won't block
+    send_all(fd, reply->str, reply->len);
+    g_string_free(reply, TRUE);
+}
+
+static gboolean on_client_input(GIOChannel *channel, GIOCondition condition, gpointer user_data)
+{
+    instance_client_t *client = (instance_client_t *)user_data;
+    char buffer[1024];
+    ssize_t length = read(g_io_channel_unix_get_fd(channel), buffer, sizeof(buffer));
+    
+    if (length < 0 && (errno == EAGAIN || errno == EINTR)) {
+        return G_SOURCE_CONTINUE;
+    }
+    
+    if (length > 0 && client->request->len + (gsize)length <= MAX_REQUEST) {
+        g_string_append_len(client->request, buffer, length);
+        return G_SOURCE_CONTINUE;
+    }
+    
+    // End of the request; an error or an oversized one gets no answer
+    if (length == 0) {
+        answer(client);
+    }
+    client_free(client);
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean on_connection(GIOChannel *channel, GIOCondition condition, gpointer user_data)
+{
+    int fd = accept(instance.listen_fd, NULL, NULL);
+    if (fd < 0) {
+        return G_SOURCE_CONTINUE;
+    }
+    
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    
+    instance_client_t *client = g_new0(instance_client_t, 1);
+    client->channel = g_io_channel_unix_new(fd);
+    client->request = g_string_new(NULL);
+    g_io_add_watch(client->channel, G_IO_IN | G_IO_HUP | G_IO_ERR, on_client_input, client);
+    
+    return G_SOURCE_CONTINUE;
+}
+
+void instance_serve(instance_command_cb cb, gpointer user_data)
+{
+    if (instance.listen_fd < 0 || instance.watch) {
+        return;
+    }
+    
+    instance.cb = cb;
+    instance.user_data = user_data;
+    
+    GIOChannel *channel = g_io_channel_unix_new(instance.listen_fd);
+    instance.watch = g_io_add_watch(channel, G_IO_IN, on_connection, NULL);
+    g_io_channel_unref(channel);
+}
+
+void instance_release(void)
+{
+    if (instance.listen_fd < 0) {
+        return;
+    }
+    
+    if (instance.watch) {
+        g_source_remove(instance.watch);
+        instance.watch = 0;
+    }
+    
+    close(instance.listen_fd);
+    instance.listen_fd = -1;
+    g_unlink(instance.socket_path);
+    g_free(instance.socket_path);
+    instance.socket_path = NULL;
+    
+    // Closing drops the lock; the file stays for the next instance
+    close(instance.lock_fd);
+    instance.lock_fd = -1;
+}
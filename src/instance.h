@@ -0,0 +1,34 @@
+#ifndef INSTANCE_H
+#define INSTANCE_H
+
+#include <glib.h>
+
+// One volmix per user session. A launch first tries to hand its command to
+// the running instance over a Unix socket ($XDG_RUNTIME_DIR/volmix.sock);
+// that takes plain socket calls only, before GTK or the sound server are
+// touched. Otherwise it claims the socket and serves later launches.
+//
+// Protocol: the client writes one command line and shuts down its sending
+// side; the instance replies with '+' (success) or '-' (failure) followed
+// by the command's output, then closes.
+
+typedef gboolean (*instance_command_cb)(const char *line, GString *reply, gpointer user_data);
+
+// Forward 'line' to a running instance and print its reply on stdout.
+// FALSE, with nothing printed, when no instance is running; otherwise
+// *ok is the command's outcome.
+gboolean instance_forward(const char *line, gboolean *ok);
+
+// Become the instance: bind and listen right away, so launches made while
+// this one is still starting up wait in the backlog instead of starting a
+// second instance. FALSE if another instance won or the socket can't be
+// set up.
+gboolean instance_claim(void);
+
+// Start answering queued and new connections from the main loop
+void instance_serve(instance_command_cb cb, gpointer user_data);
+
+// Close and remove the socket
+void instance_release(void);
+
+#endif // INSTANCE_H
@@ -0,0 +1,228 @@
+#include "leveler.h"
+#include "audio_backend.h"
+
+// The measurement is a peak per ~100 ms, taken after the stream's volume.
+// It is smoothed in dB into a short-term level; a control tick compares
+// that with the target and nudges the volume by at most a step at a time,
+// starting only once the error is well outside a dead band and stopping
+// once it is back near the target, so music dynamics don't make it pump.
+
+#define SILENCE_GATE 0.001f           // -60 dBFS; quieter peaks are pauses, not level
+#define LEVEL_SMOOTHING 0.05f         // Per update at ~10 Hz, a time constant of ~2 s
+#define TICK_MS 250
+#define ACTIVE_GRACE_US (1 * G_USEC_PER_SEC)  // Silent longer than this: leave it be
+#define START_ERROR_DB 4.0f           // Start adjusting beyond this...
+#define STOP_ERROR_DB 1.0f            // ...and stop once within this
+#define STEP_GAIN 0.5f                // Fraction of the error corrected per write
+#define MAX_STEP_DB 1.5f
+#define MIN_WRITE_INTERVAL_US (G_USEC_PER_SEC / 3)
+#define HOLD_US (10 * G_USEC_PER_SEC) // After a volume change made elsewhere
+#define RETRY_US (5 * G_USEC_PER_SEC) // Before measuring again after it ended
+#define MIN_TARGET_DB -60.0f
+#define MIN_VOLUME 5                  // Leveling never turns a stream below this
+
+static void reset_level(app_audio_t *app)
+{
+    app->level.db = 0.0f;
+    app->level.active_us = 0;
+    app->level.adjusting = FALSE;
+    app->level.write_us = 0;
+    app->level.volume = -1;
+    app->level.hold_until_us = 0;
+}
+
+static void start_monitor(pulse_client_t *client, app_audio_t *app)
+{
+    app->level.monitor_us = g_get_monotonic_time();
+    app->level.monitored = client->backend->monitor_level(client, app->index, TRUE);
+}
+
+static void stop_monitor(pulse_client_t *client, app_audio_t *app)
+{
+    if (app->level.monitored) {
+        client->backend->monitor_level(client, app->index, FALSE);
+        app->level.monitored = FALSE;
+    }
+}
+
+void pulse_client_level_update(pulse_client_t *client, uint32_t index, float peak)
+{
+    app_audio_t *app = pulse_client_get_app(client, index);
+    if (!app || !app->level.monitored) {
+        return;
+    }
+    
+    if (peak < 0) {
+        // The tick starts a new measurement after a while
+        app->level.monitored = FALSE;
+        return;
+    }
+    
+    // Pauses would drag the level down and the volume up after them
+    if (peak < SILENCE_GATE) {
+        return;
+    }
+    
+    float db = (float)pa_sw_volume_to_dB(pa_sw_volume_from_linear(peak));
+    if (app->level.active_us == 0) {
+        app->level.db = db;
+    } else {
+        app->level.db += LEVEL_SMOOTHING * (db - app->level.db);
+    }
+    app->level.active_us = g_get_monotonic_time();
+}
+
+static void level_app(pulse_client_t *client, app_audio_t *app, gint64 now)
+{
+    app_level_t *level = &app->level;
+    int volume = app_audio_get_volume_percent(app);
+    
+    if (!level->monitored) {
+        if (now - level->monitor_us >= RETRY_US) {
+            start_monitor(client, app);
+        }
+        return;
+    }
+    
+    // A volume set elsewhere (a slider, a scene, another mixer) wins
+    if (level->volume >= 0 && volume != level->volume &&
+        !app->write_in_flight && !app->volume_dirty) {
+        level->volume = -1;
+        level->adjusting = FALSE;
+        level->hold_until_us = now + HOLD_US;
+    }
+    
+    if (app->corked || app->muted || volume == 0 || now < level->hold_until_us ||
+        level->active_us == 0 || now - level->active_us > ACTIVE_GRACE_US) {
+        level->adjusting = FALSE;
+        return;
+    }
+    
+    float error = client->leveling_target_db - level->db;
+    if (!level->adjusting) {
+        if (ABS(error) < START_ERROR_DB) {
+            return;
+        }
+        level->adjusting = TRUE;
+    } else if (ABS(error) < STOP_ERROR_DB) {
+        level->adjusting = FALSE;
+        return;
+    }
+    
+    if (app->write_in_flight || now - level->write_us < MIN_WRITE_INTERVAL_US) {
+        return;
+    }
+    
+    float step = CLAMP(error * STEP_GAIN, -MAX_STEP_DB, MAX_STEP_DB);
+    double current_db = pa_sw_volume_to_dB(pulse_client_percent_to_pa_volume(volume));
+    int target = pulse_client_pa_volume_to_percent(pa_sw_volume_from_dB(current_db + step));
+    
+    // Whole percents are coarse at low volumes; move at least one
+    if (target == volume) {
+        target = volume + (step > 0 ? 1 : -1);
+    }
+    target = CLAMP(target, MIN_VOLUME, 100);
+    if (target == volume || !pulse_client_set_app_volume(client, app->index, target)) {
+        return;
+    }
+    
+    // The measurement is taken after the volume, so it moves by the same
+    // amount; account for that now rather than waiting for the smoothing
+    level->db += (float)(pa_sw_volume_to_dB(pulse_client_percent_to_pa_volume(target)) - current_db);
+    level->volume = target;
+    level->write_us = now;
+}
+
+// One tick for every stream, so the cost doesn't grow with timers
+static gboolean leveling_tick(gpointer user_data)
+{
+    pulse_client_t *client = (pulse_client_t *)user_data;
+    gint64 now = g_get_monotonic_time();
+    
+    for (GList *item = client->audio_apps; item; item = item->next) {
+        level_app(client, (app_audio_t *)item->data, now);
+    }
+    
+    return G_SOURCE_CONTINUE;
+}
+
+gboolean pulse_client_set_leveling(pulse_client_t *client, gboolean enabled, float target_db)
+{
+    if (!client || !client->backend) {
+        return FALSE;
+    }
+    
+    if (!enabled) {
+        leveler_stop(client);
+        return TRUE;
+    }
+    
+    if (!client->backend->monitor_level) {
+        g_message("Loudness leveling needs stream level measurement, which the %s backend lacks",
+                  client->backend->name);
+        return FALSE;
+    }
+    if (target_db < MIN_TARGET_DB || target_db > 0.0f) {
+        return FALSE;
+    }
+    
+    client->leveling_target_db = target_db;
+    g_message("Loudness leveling on, target %.1f dBFS", target_db);
+    
+    if (client->leveling) {
+        return TRUE;
+    }
+    
+    client->leveling = TRUE;
+    for (GList *item = client->audio_apps; item; item = item->next) {
+        app_audio_t *app = (app_audio_t *)item->data;
+        reset_level(app);
+        start_monitor(client, app);
+    }
+    client->leveling_source = g_timeout_add(TICK_MS, leveling_tick, client);
+    return TRUE;
+}
+
+gboolean pulse_client_get_leveling(pulse_client_t *client, float *target_db)
+{
+    if (!client) {
+        return FALSE;
+    }
+    
+    if (target_db) {
+        *target_db = client->leveling_target_db;
+    }
+    return client->leveling;
+}
+
+void leveler_stop(pulse_client_t *client)
+{
+    if (!client->leveling) {
+        return;
+    }
+    
+    g_source_remove(client->leveling_source);
+    client->leveling_source = 0;
+    
+    for (GList *item = client->audio_apps; item; item = item->next) {
+        stop_monitor(client, (app_audio_t *)item->data);
+    }
+    
+    client->leveling = FALSE;
+    g_message("Loudness leveling off");
+}
+
+void leveler_app_added(pulse_client_t *client, app_audio_t *app)
+{
+    if (client->leveling) {
+        reset_level(app);
+        start_monitor(client, app);
+    }
+}
+
+void leveler_app_removed(pulse_client_t *client, app_audio_t *app)
+{
+    if (client->leveling) {
+        stop_monitor(client, app);
+    }
+}
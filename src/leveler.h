@@ -0,0 +1,17 @@
+#ifndef LEVELER_H
+#define LEVELER_H
+
+#include "pulse_client.h"
+
+// Loudness leveling engine behind pulse_client_set_leveling. The backend
+// measures each stream's peak about ten times a second; a single control
+// tick for all streams turns those into slow, rate limited volume writes.
+
+// Registry hooks: start or stop measuring a stream while leveling is on
+void leveler_app_added(pulse_client_t *client, app_audio_t *app);
+void leveler_app_removed(pulse_client_t *client, app_audio_t *app);
+
+// Stop leveling without touching any volume
+void leveler_stop(pulse_client_t *client);
+
+#endif // LEVELER_H
@@ -0,0 +1,712 @@
+#include "libvolmix.h"
+#include "pulse_client.h"
+#include "flight_recorder.h"
+#include <stdio.h>
+#include <string.h>
+
+// Public API over the pulse_client_* engine. It adds nothing to the audio
+// path: handles wrap the engine's registry entries, and setter callbacks
+// are matched to the engine's write completions.
+
+// Setter callbacks awaiting a reply
+typedef struct {
+    GQueue volume_sent;       // Covered by the write in flight
+    GQueue volume_queued;     // Coalesced, go out with the next write
+    GQueue mute;              // One per mute write, answered in order
+} volmix_waiters_t;
+
+typedef struct {
+    volmix_result_cb cb;
+    void *user_data;
+} volmix_waiter_t;
+
+struct volmix_stream {
+    volmix_t *vm;
+    app_audio_t *app;         // Engine entry, freed after REMOVED
+    volmix_waiters_t waiters;
+};
+
+struct volmix {
+    pulse_client_t client;
+    GHashTable *streams;      // stream index -> volmix_stream_t
+    volmix_waiters_t master_waiters;
+    volmix_event_cb event_cb;
+    void *event_cb_data;
+};
+
+// The engine takes non-const clients even for reads
+static pulse_client_t *client_of(const volmix_t *vm)
+{
+    return (pulse_client_t *)&vm->client;
+}
+
+static void waiters_init(volmix_waiters_t *waiters)
+{
+    g_queue_init(&waiters->volume_sent);
+    g_queue_init(&waiters->volume_queued);
+    g_queue_init(&waiters->mute);
+}
+
+static void add_waiter(GQueue *queue, volmix_result_cb cb, void *user_data)
+{
+    volmix_waiter_t *waiter = g_new(volmix_waiter_t, 1);
+    waiter->cb = cb;
+    waiter->user_data = user_data;
+    g_queue_push_tail(queue, waiter);
+}
+
+// Callbacks may call setters again, so a queue is detached before any of
+// its waiters run
+static void complete_all(volmix_t *vm, GQueue *queue, volmix_status_t status)
+{
+    GQueue done = *queue;
+    g_queue_init(queue);
+    
+    volmix_waiter_t *waiter;
+    while ((waiter = g_queue_pop_head(&done))) {
+        if (waiter->cb) {
+            waiter->cb(vm, status, waiter->user_data);
+        }
+        g_free(waiter);
+    }
+}
+
+static void complete_one(volmix_t *vm, GQueue *queue, volmix_status_t status)
+{
+    volmix_waiter_t *waiter = g_queue_pop_head(queue);
+    if (!waiter) {
+        return;
+    }
+    
+    if (waiter->cb) {
+        waiter->cb(vm, status, waiter->user_data);
+    }
+    g_free(waiter);
+}
+
+static void waiters_fail(volmix_t *vm, volmix_waiters_t *waiters, volmix_status_t status)
+{
+    complete_all(vm, &waiters->volume_sent, status);
+    complete_all(vm, &waiters->volume_queued, status);
+    complete_all(vm, &waiters->mute, status);
+}
+
+// Queue a volume waiter behind the engine's coalescing: a write that was
+// already in flight means this value only goes out once it is answered
+static void add_volume_waiter(volmix_waiters_t *waiters, gboolean was_in_flight,
+                              volmix_result_cb cb, void *user_data)
+{
+    add_waiter(was_in_flight ? &waiters->volume_queued : &waiters->volume_sent, cb, user_data);
+}
+
+static volmix_stream_t *stream_new(volmix_t *vm, app_audio_t *app)
+{
+    volmix_stream_t *stream = g_new0(volmix_stream_t, 1);
+    stream->vm = vm;
+    stream->app = app;
+    waiters_init(&stream->waiters);
+    return stream;
+}
+
+static void stream_free(gpointer data)
+{
+    volmix_stream_t *stream = (volmix_stream_t *)data;
+    
+    waiters_fail(stream->vm, &stream->waiters, VOLMIX_ERROR_CANCELLED);
+    g_free(stream);
+}
+
+static void notify(volmix_t *vm, volmix_event_t event, volmix_stream_t *stream)
+{
+    if (vm->event_cb) {
+        vm->event_cb(vm, event, stream, vm->event_cb_data);
+    }
+}
+
+static void on_client_event(pulse_client_t *client, pulse_client_event_t event,
+                            app_audio_t *app, gpointer user_data)
+{
+    volmix_t *vm = (volmix_t *)user_data;
+    volmix_stream_t *stream;
+    
+    switch (event) {
+    case PULSE_CLIENT_APP_ADDED:
+        stream = stream_new(vm, app);
+        g_hash_table_insert(vm->streams, GUINT_TO_POINTER(app->index), stream);
+        notify(vm, VOLMIX_EVENT_STREAM_ADDED, stream);
+        break;
+    case PULSE_CLIENT_APP_CHANGED:
+        stream = g_hash_table_lookup(vm->streams, GUINT_TO_POINTER(app->index));
+        if (stream) {
+            notify(vm, VOLMIX_EVENT_STREAM_CHANGED, stream);
+        }
+        break;
+    case PULSE_CLIENT_APP_REMOVED:
+        stream = g_hash_table_lookup(vm->streams, GUINT_TO_POINTER(app->index));
+        if (stream) {
+            waiters_fail(vm, &stream->waiters, VOLMIX_ERROR_GONE);
+            notify(vm, VOLMIX_EVENT_STREAM_REMOVED, stream);
+            g_hash_table_remove(vm->streams, GUINT_TO_POINTER(app->index));
+        }
+        break;
+    case PULSE_CLIENT_MASTER_CHANGED:
+        notify(vm, VOLMIX_EVENT_MASTER_CHANGED, NULL);
+        break;
+    case PULSE_CLIENT_CONNECTED:
+        notify(vm, VOLMIX_EVENT_CONNECTED, NULL);
+        break;
+    case PULSE_CLIENT_DISCONNECTED:
+        // Stream waiters went with their REMOVED events
+        waiters_fail(vm, &vm->master_waiters, VOLMIX_ERROR_NOT_CONNECTED);
+        notify(vm, VOLMIX_EVENT_DISCONNECTED, NULL);
+        break;
+    }
+}
+
+static void on_client_write(pulse_client_t *client, pulse_client_write_t kind, app_audio_t *app,
+                            gboolean success, gboolean resent, gpointer user_data)
+{
+    volmix_t *vm = (volmix_t *)user_data;
+    volmix_waiters_t *waiters = &vm->master_waiters;
+    volmix_status_t status = success ? VOLMIX_OK : VOLMIX_ERROR_FAILED;
+    
+    if (app) {
+        volmix_stream_t *stream = g_hash_table_lookup(vm->streams, GUINT_TO_POINTER(app->index));
+        if (!stream) {
+            return;
+        }
+        waiters = &stream->waiters;
+    }
+    
+    // Only mutes sent for API callers come back here, oldest first; the
+    // engine's own (schedules) complete without a waiter
+    if (kind == PULSE_CLIENT_WRITE_MUTE) {
+        complete_one(vm, &waiters->mute, status);
+        return;
+    }
+    
+    // The coalesced values went out as the next write, or couldn't be sent
+    GQueue done = waiters->volume_sent;
+    GQueue unsent = G_QUEUE_INIT;
+    if (resent) {
+        waiters->volume_sent = waiters->volume_queued;
+    } else {
+        unsent = waiters->volume_queued;
+        g_queue_init(&waiters->volume_sent);
+    }
+    g_queue_init(&waiters->volume_queued);
+    
+    complete_all(vm, &done, status);
+    complete_all(vm, &unsent, VOLMIX_ERROR_FAILED);
+}
+
+const char *volmix_version(void)
+{
+    return VOLMIX_VERSION;
+}
+
+volmix_t *volmix_new(const char *backend)
+{
+    return volmix_new_for_server(backend, NULL);
+}
+
+volmix_t *volmix_new_for_server(const char *backend, const char *server)
+{
+    volmix_t *vm = g_new0(volmix_t, 1);
+    
+    if (!pulse_client_init_server(&vm->client, backend, server)) {
+        g_free(vm);
+        return NULL;
+    }
+    
+    vm->streams = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, stream_free);
+    waiters_init(&vm->master_waiters);
+    pulse_client_set_event_callback(&vm->client, on_client_event, vm);
+    pulse_client_set_write_callback(&vm->client, on_client_write, vm);
+    return vm;
+}
+
+void volmix_free(volmix_t *vm)
+{
+    if (!vm) {
+        return;
+    }
+    
+    // No more events from here on; outstanding setters are cancelled
+    pulse_client_set_event_callback(&vm->client, NULL, NULL);
+    pulse_client_set_write_callback(&vm->client, NULL, NULL);
+    waiters_fail(vm, &vm->master_waiters, VOLMIX_ERROR_CANCELLED);
+    g_hash_table_destroy(vm->streams);
+    
+    pulse_client_disconnect(&vm->client);
+    pulse_client_cleanup(&vm->client);
+    g_free(vm);
+}
+
+volmix_status_t volmix_connect_async(volmix_t *vm)
+{
+    if (!vm) {
+        return VOLMIX_ERROR_INVALID;
+    }
+    
+    return pulse_client_connect_async(&vm->client) ? VOLMIX_OK : VOLMIX_ERROR_NOT_CONNECTED;
+}
+
+volmix_status_t volmix_connect(volmix_t *vm)
+{
+    if (!vm) {
+        return VOLMIX_ERROR_INVALID;
+    }
+    
+    return pulse_client_connect(&vm->client) ? VOLMIX_OK : VOLMIX_ERROR_NOT_CONNECTED;
+}
+
+int volmix_is_connected(const volmix_t *vm)
+{
+    return vm && vm->client.connected;
+}
+
+const char *volmix_get_backend_name(const volmix_t *vm)
+{
+    return vm ? pulse_client_get_backend_name(client_of(vm)) : NULL;
+}
+
+const char *volmix_get_server(const volmix_t *vm)
+{
+    return vm ? pulse_client_get_server(client_of(vm)) : NULL;
+}
+
+void volmix_set_event_callback(volmix_t *vm, volmix_event_cb cb, void *user_data)
+{
+    if (!vm) {
+        return;
+    }
+    
+    vm->event_cb = cb;
+    vm->event_cb_data = user_data;
+}
+
+void volmix_foreach_stream(volmix_t *vm, volmix_stream_func func, void *user_data)
+{
+    if (!vm || !func) {
+        return;
+    }
+    
+    for (GList *item = pulse_client_get_apps(&vm->client); item; item = item->next) {
+        app_audio_t *app = (app_audio_t *)item->data;
+        volmix_stream_t *stream = g_hash_table_lookup(vm->streams, GUINT_TO_POINTER(app->index));
+        if (stream) {
+            func(stream, user_data);
+        }
+    }
+}
+
+void volmix_foreach_stream_of_pid(volmix_t *vm, uint32_t pid, volmix_stream_func func,
+                                  void *user_data)
+{
+    if (!vm || !func) {
+        return;
+    }
+    
+    for (GSList *item = pulse_client_get_apps_by_pid(&vm->client, pid); item; item = item->next) {
+        app_audio_t *app = (app_audio_t *)item->data;
+        volmix_stream_t *stream = g_hash_table_lookup(vm->streams, GUINT_TO_POINTER(app->index));
+        if (stream) {
+            func(stream, user_data);
+        }
+    }
+}
+
+unsigned int volmix_get_stream_count(const volmix_t *vm)
+{
+    return vm ? g_hash_table_size(vm->streams) : 0;
+}
+
+volmix_stream_t *volmix_find_stream(volmix_t *vm, uint32_t index)
+{
+    return vm ? g_hash_table_lookup(vm->streams, GUINT_TO_POINTER(index)) : NULL;
+}
+
+// Generations
+
+uint64_t volmix_get_generation(const volmix_t *vm)
+{
+    return vm ? pulse_client_get_generation(client_of(vm)) : 0;
+}
+
+uint64_t volmix_get_master_generation(const volmix_t *vm)
+{
+    return vm ? pulse_client_get_master_generation(client_of(vm)) : 0;
+}
+
+typedef struct {
+    volmix_t *vm;
+    volmix_index_func removed;
+    volmix_stream_func changed;
+    void *user_data;
+} changes_visit_t;
+
+static void visit_removed(pulse_client_t *client, uint32_t index, gpointer user_data)
+{
+    changes_visit_t *visit = (changes_visit_t *)user_data;
+    
+    if (visit->removed) {
+        visit->removed(index, visit->user_data);
+    }
+}
+
+static void visit_changed(pulse_client_t *client, app_audio_t *app, gpointer user_data)
+{
+    changes_visit_t *visit = (changes_visit_t *)user_data;
+    volmix_stream_t *stream = g_hash_table_lookup(visit->vm->streams, GUINT_TO_POINTER(app->index));
+    
+    if (stream && visit->changed) {
+        visit->changed(stream, visit->user_data);
+    }
+}
+
+int volmix_changes_since(volmix_t *vm, uint64_t since, volmix_index_func removed,
+                         volmix_stream_func changed, void *user_data)
+{
+    if (!vm) {
+        return 0;
+    }
+    
+    changes_visit_t visit = { vm, removed, changed, user_data };
+    return pulse_client_changes_since(&vm->client, since, visit_removed, visit_changed, &visit);
+}
+
+// Master
+
+int volmix_get_master_volume(const volmix_t *vm)
+{
+    return vm ? pulse_client_get_master_volume(client_of(vm)) : -1;
+}
+
+int volmix_get_master_muted(const volmix_t *vm)
+{
+    return vm && pulse_client_get_master_muted(client_of(vm));
+}
+
+float volmix_get_master_balance(const volmix_t *vm)
+{
+    return vm ? pulse_client_get_master_balance(client_of(vm)) : 0.0f;
+}
+
+int volmix_master_can_balance(const volmix_t *vm)
+{
+    return vm && pulse_client_master_can_balance(client_of(vm));
+}
+
+int volmix_master_write_pending(const volmix_t *vm)
+{
+    return vm && (vm->client.master_write_in_flight || vm->client.master_volume_dirty);
+}
+
+volmix_status_t volmix_set_master_volume(volmix_t *vm, int volume,
+                                         volmix_result_cb cb, void *user_data)
+{
+    if (!volmix_is_connected(vm)) {
+        return VOLMIX_ERROR_NOT_CONNECTED;
+    }
+    if (volume < 0 || volume > 100) {
+        return VOLMIX_ERROR_INVALID;
+    }
+    
+    gboolean in_flight = vm->client.master_write_in_flight;
+    if (!pulse_client_set_master_volume(&vm->client, volume)) {
+        return VOLMIX_ERROR_FAILED;
+    }
+    add_volume_waiter(&vm->master_waiters, in_flight, cb, user_data);
+    return VOLMIX_OK;
+}
+
+volmix_status_t volmix_step_master_volume(volmix_t *vm, int delta,
+                                          volmix_result_cb cb, void *user_data)
+{
+    if (!volmix_is_connected(vm)) {
+        return VOLMIX_ERROR_NOT_CONNECTED;
+    }
+    
+    int volume = CLAMP(volmix_get_master_volume(vm) + delta, 0, 100);
+    return volmix_set_master_volume(vm, volume, cb, user_data);
+}
+
+volmix_status_t volmix_set_master_balance(volmix_t *vm, float balance,
+                                          volmix_result_cb cb, void *user_data)
+{
+    if (!volmix_is_connected(vm)) {
+        return VOLMIX_ERROR_NOT_CONNECTED;
+    }
+    if (!volmix_master_can_balance(vm) || balance < -1.0f || balance > 1.0f) {
+        return VOLMIX_ERROR_INVALID;
+    }
+    
+    gboolean in_flight = vm->client.master_write_in_flight;
+    if (!pulse_client_set_master_balance(&vm->client, balance)) {
+        return VOLMIX_ERROR_FAILED;
+    }
+    add_volume_waiter(&vm->master_waiters, in_flight, cb, user_data);
+    return VOLMIX_OK;
+}
+
+volmix_status_t volmix_set_master_muted(volmix_t *vm, int muted,
+                                        volmix_result_cb cb, void *user_data)
+{
+    if (!volmix_is_connected(vm)) {
+        return VOLMIX_ERROR_NOT_CONNECTED;
+    }
+    
+    if (!pulse_client_set_master_mute(&vm->client, muted ? TRUE : FALSE)) {
+        return VOLMIX_ERROR_FAILED;
+    }
+    add_waiter(&vm->master_waiters.mute, cb, user_data);
+    return VOLMIX_OK;
+}
+
+// Streams
+
+uint32_t volmix_stream_get_index(const volmix_stream_t *stream)
+{
+    return stream ? stream->app->index : PA_INVALID_INDEX;
+}
+
+const char *volmix_stream_get_name(const volmix_stream_t *stream)
+{
+    return stream ? stream->app->name : NULL;
+}
+
+const char *volmix_stream_get_process_name(const volmix_stream_t *stream)
+{
+    return stream ? stream->app->process_name : NULL;
+}
+
+uint32_t volmix_stream_get_pid(const volmix_stream_t *stream)
+{
+    return stream ? stream->app->pid : 0;
+}
+
+const char *volmix_stream_get_icon_name(const volmix_stream_t *stream)
+{
+    return stream ? stream->app->icon_name : NULL;
+}
+
+int volmix_stream_get_volume(const volmix_stream_t *stream)
+{
+    return stream ? app_audio_get_volume_percent(stream->app) : 0;
+}
+
+int volmix_stream_get_muted(const volmix_stream_t *stream)
+{
+    return stream && stream->app->muted;
+}
+
+float volmix_stream_get_balance(const volmix_stream_t *stream)
+{
+    return stream ? app_audio_get_balance(stream->app) : 0.0f;
+}
+
+float volmix_stream_get_fade(const volmix_stream_t *stream)
+{
+    return stream ? app_audio_get_fade(stream->app) : 0.0f;
+}
+
+int volmix_stream_can_balance(const volmix_stream_t *stream)
+{
+    return stream && app_audio_can_balance(stream->app);
+}
+
+int volmix_stream_can_fade(const volmix_stream_t *stream)
+{
+    return stream && app_audio_can_fade(stream->app);
+}
+
+int volmix_stream_is_corked(const volmix_stream_t *stream)
+{
+    return stream && stream->app->corked;
+}
+
+int64_t volmix_stream_get_last_active(const volmix_stream_t *stream)
+{
+    return stream ? stream->app->last_active_us : 0;
+}
+
+int volmix_stream_write_pending(const volmix_stream_t *stream)
+{
+    return stream && (stream->app->write_in_flight || stream->app->volume_dirty);
+}
+
+uint64_t volmix_stream_get_generation(const volmix_stream_t *stream)
+{
+    return stream ? stream->app->generation : 0;
+}
+
+// Shared tail of the volume/balance/fade setters
+typedef gboolean (*stream_shape_setter_t)(pulse_client_t *client, uint32_t index, float value);
+
+static volmix_status_t set_stream_volume(volmix_stream_t *stream, gboolean valid,
+                                         stream_shape_setter_t setter, float value,
+                                         volmix_result_cb cb, void *user_data)
+{
+    if (!stream) {
+        return VOLMIX_ERROR_INVALID;
+    }
+    if (!volmix_is_connected(stream->vm)) {
+        return VOLMIX_ERROR_NOT_CONNECTED;
+    }
+    if (!valid) {
+        return VOLMIX_ERROR_INVALID;
+    }
+    
+    gboolean in_flight = stream->app->write_in_flight;
+    if (!setter(&stream->vm->client, stream->app->index, value)) {
+        return VOLMIX_ERROR_FAILED;
+    }
+    add_volume_waiter(&stream->waiters, in_flight, cb, user_data);
+    return VOLMIX_OK;
+}
+
+static gboolean set_app_volume_percent(pulse_client_t *client, uint32_t index, float volume)
+{
+    return pulse_client_set_app_volume(client, index, (int)volume);
+}
+
+volmix_status_t volmix_stream_set_volume(volmix_stream_t *stream, int volume,
+                                         volmix_result_cb cb, void *user_data)
+{
+    return set_stream_volume(stream, volume >= 0 && volume <= 100,
+                             set_app_volume_percent, (float)volume, cb, user_data);
+}
+
+volmix_status_t volmix_stream_set_balance(volmix_stream_t *stream, float balance,
+                                          volmix_result_cb cb, void *user_data)
+{
+    return set_stream_volume(stream,
+                             volmix_stream_can_balance(stream) &&
+                             balance >= -1.0f && balance <= 1.0f,
+                             pulse_client_set_app_balance, balance, cb, user_data);
+}
+
+volmix_status_t volmix_stream_set_fade(volmix_stream_t *stream, float fade,
+                                       volmix_result_cb cb, void *user_data)
+{
+    return set_stream_volume(stream,
+                             volmix_stream_can_fade(stream) && fade >= -1.0f && fade <= 1.0f,
+                             pulse_client_set_app_fade, fade, cb, user_data);
+}
+
+volmix_status_t volmix_stream_set_muted(volmix_stream_t *stream, int muted,
+                                        volmix_result_cb cb, void *user_data)
+{
+    if (!stream) {
+        return VOLMIX_ERROR_INVALID;
+    }
+    if (!volmix_is_connected(stream->vm)) {
+        return VOLMIX_ERROR_NOT_CONNECTED;
+    }
+    
+    if (!pulse_client_set_app_mute(&stream->vm->client, stream->app->index, muted ? TRUE : FALSE)) {
+        return VOLMIX_ERROR_FAILED;
+    }
+    add_waiter(&stream->waiters.mute, cb, user_data);
+    return VOLMIX_OK;
+}
+
+// Health counters
+
+unsigned int volmix_get_write_stats(const volmix_t *vm, int64_t *avg_us, int64_t *max_us)
+{
+    gint64 avg = 0, max = 0;
+    guint count = vm ? pulse_client_get_write_stats(client_of(vm), &avg, &max) : 0;
+    
+    if (avg_us) *avg_us = avg;
+    if (max_us) *max_us = max;
+    return count;
+}
+
+unsigned int volmix_get_event_stats(const volmix_t *vm, int64_t *avg_us, int64_t *max_us)
+{
+    gint64 avg = 0, max = 0;
+    guint count = vm ? pulse_client_get_event_stats(client_of(vm), &avg, &max) : 0;
+    
+    if (avg_us) *avg_us = avg;
+    if (max_us) *max_us = max;
+    return count;
+}
+
+unsigned int volmix_get_pending_requests(const volmix_t *vm)
+{
+    return vm ? pulse_client_get_pending_requests(client_of(vm)) : 0;
+}
+
+unsigned int volmix_get_cap_stats(const volmix_t *vm, int64_t *max_us)
+{
+    gint64 max = 0;
+    guint count = vm ? pulse_client_get_cap_stats(client_of(vm), &max) : 0;
+    
+    if (max_us) *max_us = max;
+    return count;
+}
+
+// Schedule
+
+unsigned int volmix_get_schedule(const volmix_t *vm, int64_t *next_in_us, int *master_cap)
+{
+    gint64 next = -1;
+    guint count = vm ? pulse_client_get_schedule(client_of(vm), &next) : 0;
+    
+    if (next_in_us) *next_in_us = next;
+    if (master_cap) *master_cap = vm ? vm->client.schedule_master_cap : -1;
+    return count;
+}
+
+unsigned int volmix_reload_schedule(volmix_t *vm)
+{
+    if (!vm) {
+        return 0;
+    }
+    
+    pulse_client_reload_schedule(&vm->client);
+    return pulse_client_get_schedule(&vm->client, NULL);
+}
+
+// Flight recorder
+
+void volmix_flight_mark(const char *what, uint32_t index, int64_t value, int64_t duration_ns)
+{
+    if (what) {
+        flight_recorder_add(what, index, value, duration_ns);
+    }
+}
+
+int volmix_flight_dump(const char *path)
+{
+    return path && flight_recorder_dump(path);
+}
+
+// Leveling
+
+volmix_status_t volmix_set_leveling(volmix_t *vm, int enabled, float target_dbfs)
+{
+    if (!vm) {
+        return VOLMIX_ERROR_INVALID;
+    }
+    
+    if (!pulse_client_set_leveling(&vm->client, enabled ? TRUE : FALSE, target_dbfs)) {
+        return VOLMIX_ERROR_INVALID;
+    }
+    return VOLMIX_OK;
+}
+
+int volmix_get_leveling(const volmix_t *vm, float *target_dbfs)
+{
+    return vm ? pulse_client_get_leveling(client_of(vm), target_dbfs) : 0;
+}
+
+float volmix_stream_get_level(const volmix_stream_t *stream)
+{
+    if (!stream || !stream->app->level.monitored || stream->app->level.active_us == 0) {
+        return -100.0f;
+    }
+    return stream->app->level.db;
+}
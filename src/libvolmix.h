@@ -0,0 +1,240 @@
+#ifndef LIBVOLMIX_H
+#define LIBVOLMIX_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// libvolmix: per-application volume control on PulseAudio or PipeWire.
+//
+// The handles are opaque and only plain C types cross the API, so the ABI
+// stays stable as the internals change; enum values are fixed and new ones
+// are only ever appended. The library dispatches server events from the
+// default GLib main context, so the application has to run a GLib (or GTK)
+// main loop. All calls and callbacks happen on that loop's thread. Any
+// number of handles can share the loop, e.g. one per server.
+
+typedef struct volmix volmix_t;
+
+// One playback stream. A handle stays valid until the VOLMIX_EVENT_STREAM_REMOVED
+// event for it has returned.
+typedef struct volmix_stream volmix_stream_t;
+
+typedef enum {
+    VOLMIX_EVENT_STREAM_ADDED = 0,
+    VOLMIX_EVENT_STREAM_CHANGED = 1,
+    VOLMIX_EVENT_STREAM_REMOVED = 2,   // stream is still valid during the callback
+    VOLMIX_EVENT_MASTER_CHANGED = 3,   // stream is NULL
+    VOLMIX_EVENT_CONNECTED = 4,        // stream is NULL
+    VOLMIX_EVENT_DISCONNECTED = 5      // stream is NULL; connect failed or connection lost
+} volmix_event_t;
+
+typedef enum {
+    VOLMIX_OK = 0,
+    VOLMIX_ERROR_FAILED = -1,          // Rejected by the sound server
+    VOLMIX_ERROR_NOT_CONNECTED = -2,
+    VOLMIX_ERROR_INVALID = -3,         // Value out of range or not applicable
+    VOLMIX_ERROR_GONE = -4,            // Stream went away before the reply
+    VOLMIX_ERROR_CANCELLED = -5        // Handle freed before the reply
+} volmix_status_t;
+
+typedef void (*volmix_event_cb)(volmix_t *vm, volmix_event_t event,
+                                volmix_stream_t *stream, void *user_data);
+
+// Completion of a setter. Volume writes are coalesced while one is in
+// flight, so several setters may complete with the same reply; each gets
+// its callback exactly once.
+typedef void (*volmix_result_cb)(volmix_t *vm, volmix_status_t status, void *user_data);
+
+typedef void (*volmix_stream_func)(volmix_stream_t *stream, void *user_data);
+typedef void (*volmix_index_func)(uint32_t index, void *user_data);
+
+// Library version, e.g. "0.1.0"
+const char *volmix_version(void);
+
+// Create a handle on a backend ("pulse", "pipewire") or on the default one
+// for NULL: $VOLMIX_BACKEND, else native PipeWire when available, else
+// libpulse. Returns NULL if the backend is unknown or fails to start.
+volmix_t *volmix_new(const char *backend);
+
+// Create a handle for a specific server: a PulseAudio server string (as in
+// $PULSE_SERVER, e.g. "unix:/run/user/1001/pulse/native" or "tcp:host"), or
+// a PipeWire remote name with the "pipewire" backend. A server string
+// implies the "pulse" backend when backend is NULL. NULL server is the
+// default server, as volmix_new.
+volmix_t *volmix_new_for_server(const char *backend, const char *server);
+
+// Pending setter callbacks complete with VOLMIX_ERROR_CANCELLED
+void volmix_free(volmix_t *vm);
+
+// Start connecting to the sound server. The outcome is a CONNECTED or
+// DISCONNECTED event; once connected the master sink is known and streams
+// are reported through STREAM_ADDED events as they are listed. A connection
+// that drops later removes its streams and reports DISCONNECTED; calling
+// this again reconnects.
+volmix_status_t volmix_connect_async(volmix_t *vm);
+
+// Connect and wait for the outcome, running the default GLib main context
+// meanwhile. Events are delivered as for volmix_connect_async.
+volmix_status_t volmix_connect(volmix_t *vm);
+
+int volmix_is_connected(const volmix_t *vm);
+const char *volmix_get_backend_name(const volmix_t *vm);
+
+// Server string the handle was created for, NULL for the default server
+const char *volmix_get_server(const volmix_t *vm);
+
+// One listener; NULL clears it
+void volmix_set_event_callback(volmix_t *vm, volmix_event_cb cb, void *user_data);
+
+// Streams in the order they appeared
+void volmix_foreach_stream(volmix_t *vm, volmix_stream_func func, void *user_data);
+unsigned int volmix_get_stream_count(const volmix_t *vm);
+volmix_stream_t *volmix_find_stream(volmix_t *vm, uint32_t index);
+
+// Change generations. Every change to the registry (a stream added,
+// changed or removed, the master, the connection, a local write) bumps
+// the handle's generation. A consumer remembers the generation it is
+// current with and catches up on what changed since, in time proportional
+// to the changes; any number of consumers can do so independently of each
+// other and of the event callback. Generations start at 1, so 0 means
+// "nothing seen yet".
+uint64_t volmix_get_generation(const volmix_t *vm);
+
+// Generation of the last change to the master or the connection state
+uint64_t volmix_get_master_generation(const volmix_t *vm);
+
+// Report each stream removed after generation 'since' by index, then each
+// stream added or changed after it, oldest change first. The callbacks
+// must not change the registry (no setters). Returns 0, reporting
+// nothing, when the removals are too old to be known; the consumer then
+// compares itself with volmix_foreach_stream instead.
+int volmix_changes_since(volmix_t *vm, uint64_t since, volmix_index_func removed,
+                         volmix_stream_func changed, void *user_data);
+
+// Streams of one process (application.process.id), e.g. the focused
+// window's; a hash lookup, no server round trip
+void volmix_foreach_stream_of_pid(volmix_t *vm, uint32_t pid, volmix_stream_func func,
+                                  void *user_data);
+
+// Master (default sink). Volumes are percent 0-100 of the loudest channel;
+// balance is -1.0 (left) .. 1.0 (right).
+int volmix_get_master_volume(const volmix_t *vm);
+int volmix_get_master_muted(const volmix_t *vm);
+float volmix_get_master_balance(const volmix_t *vm);
+int volmix_master_can_balance(const volmix_t *vm);
+
+// A master volume write is in flight; the getters show the value being sent
+int volmix_master_write_pending(const volmix_t *vm);
+
+// Setters return at once. On VOLMIX_OK the callback (may be NULL) runs once
+// the server has answered; on any other status it is never called.
+volmix_status_t volmix_set_master_volume(volmix_t *vm, int volume,
+                                         volmix_result_cb cb, void *user_data);
+volmix_status_t volmix_step_master_volume(volmix_t *vm, int delta,
+                                          volmix_result_cb cb, void *user_data);
+volmix_status_t volmix_set_master_balance(volmix_t *vm, float balance,
+                                          volmix_result_cb cb, void *user_data);
+volmix_status_t volmix_set_master_muted(volmix_t *vm, int muted,
+                                        volmix_result_cb cb, void *user_data);
+
+// Stream properties. Strings belong to the stream and may change with a
+// STREAM_CHANGED event. Icon names are interned: equal names share one
+// pointer for the life of the process.
+uint32_t volmix_stream_get_index(const volmix_stream_t *stream);
+const char *volmix_stream_get_name(const volmix_stream_t *stream);
+const char *volmix_stream_get_process_name(const volmix_stream_t *stream);
+const char *volmix_stream_get_icon_name(const volmix_stream_t *stream);
+
+// Process that owns the stream, 0 if the server doesn't say
+uint32_t volmix_stream_get_pid(const volmix_stream_t *stream);
+int volmix_stream_get_volume(const volmix_stream_t *stream);
+int volmix_stream_get_muted(const volmix_stream_t *stream);
+
+// Balance is left/right, fade rear/front, both -1.0 .. 1.0; only
+// meaningful where the channel map has that axis
+float volmix_stream_get_balance(const volmix_stream_t *stream);
+float volmix_stream_get_fade(const volmix_stream_t *stream);
+int volmix_stream_can_balance(const volmix_stream_t *stream);
+int volmix_stream_can_fade(const volmix_stream_t *stream);
+
+// Paused by its application, and since when it was last seen playing
+// (CLOCK_MONOTONIC microseconds, as g_get_monotonic_time)
+int volmix_stream_is_corked(const volmix_stream_t *stream);
+int64_t volmix_stream_get_last_active(const volmix_stream_t *stream);
+
+int volmix_stream_write_pending(const volmix_stream_t *stream);
+
+// Generation of the stream's last change
+uint64_t volmix_stream_get_generation(const volmix_stream_t *stream);
+
+volmix_status_t volmix_stream_set_volume(volmix_stream_t *stream, int volume,
+                                         volmix_result_cb cb, void *user_data);
+volmix_status_t volmix_stream_set_balance(volmix_stream_t *stream, float balance,
+                                          volmix_result_cb cb, void *user_data);
+volmix_status_t volmix_stream_set_fade(volmix_stream_t *stream, float fade,
+                                       volmix_result_cb cb, void *user_data);
+volmix_status_t volmix_stream_set_muted(volmix_stream_t *stream, int muted,
+                                        volmix_result_cb cb, void *user_data);
+
+// Loudness leveling: each stream's short-term level is measured and its
+// volume slowly steered toward target_dbfs (-60.0 .. 0.0, e.g. -14.0), at
+// most a few writes a second per stream. Paused, muted and silent streams
+// are left alone, as is a stream for a while after its volume is set by
+// anyone else. Off by default; VOLMIX_ERROR_INVALID if the backend can't
+// measure streams (native PipeWire) or the target is out of range.
+#define VOLMIX_LEVELING_DEFAULT_DBFS (-14.0f)
+volmix_status_t volmix_set_leveling(volmix_t *vm, int enabled, float target_dbfs);
+int volmix_get_leveling(const volmix_t *vm, float *target_dbfs);
+
+// Smoothed level of a stream while leveling is on, dBFS; -100.0 when not
+// measured or nothing has been heard yet
+float volmix_stream_get_level(const volmix_stream_t *stream);
+
+// Volume write round trips so far (count returned, times in microseconds)
+// and server requests still awaiting a reply, for health monitoring
+unsigned int volmix_get_write_stats(const volmix_t *vm, int64_t *avg_us, int64_t *max_us);
+
+// Stream events from the server so far and the average and worst time
+// from their arrival to the registry (and so the event callback) having
+// the new state, in microseconds
+unsigned int volmix_get_event_stats(const volmix_t *vm, int64_t *avg_us, int64_t *max_us);
+unsigned int volmix_get_pending_requests(const volmix_t *vm);
+
+// Volume caps from ~/.config/volmix/volmix.conf ([caps] app.NAME=N and
+// sink.NAME=N) are enforced by the library: setters are clamped, and a
+// stream or sink reported above its cap is written back down at once.
+// Returns how many such corrections were made; max_us is the slowest
+// from the report to the corrected write's reply.
+unsigned int volmix_get_cap_stats(const volmix_t *vm, int64_t *max_us);
+
+// Timed policies from the [schedule] group of ~/.config/volmix/volmix.conf:
+// quiet hours capping the master, daily fades of the master, and mutes of
+// listed applications during the events of a local .ics calendar. They
+// are enforced by the library from a single timer armed for the next
+// deadline. Returns the number of rules waiting; next_in_us is the time to
+// the next deadline (-1 if none) and master_cap the quiet hours cap in
+// effect (-1 if none).
+unsigned int volmix_get_schedule(const volmix_t *vm, int64_t *next_in_us, int *master_cap);
+
+// Re-read the schedule and the calendar; policies no longer listed end now
+unsigned int volmix_reload_schedule(volmix_t *vm);
+
+// Flight recorder: the library always keeps the last few thousand engine
+// events (server events, stream reports, volume and mute writes with their
+// round trips, connection changes) in a fixed in-memory ring, at nanosecond
+// timestamps and for the cost of a clock read each. Applications can add
+// their own entries, e.g. timed UI updates; 'what' is stored by pointer and
+// must be a string literal. The ring is process-wide, shared by all handles.
+void volmix_flight_mark(const char *what, uint32_t index, int64_t value, int64_t duration_ns);
+
+// Write the recorded entries, oldest first, to 'path' as text; 0 on failure
+int volmix_flight_dump(const char *path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LIBVOLMIX_H
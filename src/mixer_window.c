@@ -0,0 +1,748 @@
+#include "mixer_window.h"
+#include "app_icon.h"
+#include <stdio.h>
+#include <string.h>
+
+// While hidden, row updates are batched at most this often instead of
+// following every event; opening the window flushes whatever is left.
+#define HIDDEN_SYNC_INTERVAL_SECONDS 2
+
+// One frame at 60Hz - the click-to-visible budget
+#define FRAME_BUDGET_US 16667
+
+// A corked stream counts as idle after this long, so a short pause
+// doesn't make its row disappear and come back
+#define IDLE_GRACE_US (5 * G_USEC_PER_SEC)
+
+static void apply_filter(mixer_window_t *mixer);
+
+// Widgets for one sink input
+typedef struct {
+    mixer_section_t *section;
+    uint32_t index;
+    GtkWidget *box;
+    GtkWidget *icon;
+    GtkWidget *label;
+    GtkWidget *volume;
+    GtkWidget *balance;
+    GtkWidget *fade;
+    gulong volume_handler;
+    gulong balance_handler;
+    gulong fade_handler;
+    const char *icon_key;         // Interned key of the icon being shown
+} mixer_row_t;
+
+static void on_app_volume_changed(GtkRange *range, gpointer user_data)
+{
+    mixer_row_t *row = (mixer_row_t *)user_data;
+    volmix_stream_t *stream = volmix_find_stream(row->section->vm, row->index);
+    int volume = (int)gtk_range_get_value(range);
+    
+    if (volmix_stream_set_volume(stream, volume, NULL, NULL) != VOLMIX_OK) {
+        printf("Failed to set volume for app %u\n", row->index);
+    }
+}
+
+static void on_app_balance_changed(GtkRange *range, gpointer user_data)
+{
+    mixer_row_t *row = (mixer_row_t *)user_data;
+    volmix_stream_t *stream = volmix_find_stream(row->section->vm, row->index);
+    float balance = (float)(gtk_range_get_value(range) / 100.0);
+    
+    if (volmix_stream_set_balance(stream, balance, NULL, NULL) != VOLMIX_OK) {
+        printf("Failed to set balance for app %u\n", row->index);
+    }
+}
+
+static void on_app_fade_changed(GtkRange *range, gpointer user_data)
+{
+    mixer_row_t *row = (mixer_row_t *)user_data;
+    volmix_stream_t *stream = volmix_find_stream(row->section->vm, row->index);
+    float fade = (float)(gtk_range_get_value(range) / 100.0);
+    
+    if (volmix_stream_set_fade(stream, fade, NULL, NULL) != VOLMIX_OK) {
+        printf("Failed to set fade for app %u\n", row->index);
+    }
+}
+
+static void on_master_balance_changed(GtkRange *range, gpointer user_data)
+{
+    mixer_section_t *section = (mixer_section_t *)user_data;
+    float balance = (float)(gtk_range_get_value(range) / 100.0);
+    
+    if (volmix_set_master_balance(section->vm, balance, NULL, NULL) != VOLMIX_OK) {
+        printf("Failed to set master balance\n");
+    }
+}
+
+// Create a centered -100..100 slider for balance (left/right) or fade (rear/front)
+static GtkWidget* create_shape_slider(void)
+{
+    GtkWidget *slider = gtk_scale_new_with_range(GTK_ORIENTATION_HORIZONTAL, -100.0, 100.0, 1.0);
+    gtk_scale_set_draw_value(GTK_SCALE(slider), FALSE);
+    gtk_scale_set_has_origin(GTK_SCALE(slider), FALSE);
+    gtk_scale_add_mark(GTK_SCALE(slider), 0.0, GTK_POS_BOTTOM, NULL);
+    gtk_widget_set_size_request(slider, 160, -1);
+    return slider;
+}
+
+// Pack a small caption + shape slider row into the given box
+static GtkWidget* pack_shape_slider(GtkWidget *box, const char *caption)
+{
+    GtkWidget *row = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 4);
+    GtkWidget *label = gtk_label_new(caption);
+    gtk_widget_set_size_request(label, 50, -1);
+    gtk_widget_set_halign(label, GTK_ALIGN_START);
+    gtk_box_pack_start(GTK_BOX(row), label, FALSE, FALSE, 0);
+    
+    GtkWidget *slider = create_shape_slider();
+    gtk_box_pack_start(GTK_BOX(row), slider, TRUE, TRUE, 0);
+    gtk_box_pack_start(GTK_BOX(box), row, FALSE, FALSE, 0);
+    return slider;
+}
+
+// Update a slider without feeding the value back to PulseAudio
+static void set_range_silently(GtkWidget *range, gulong handler, double value)
+{
+    if (gtk_range_get_value(GTK_RANGE(range)) == value) {
+        return;
+    }
+    
+    g_signal_handler_block(range, handler);
+    gtk_range_set_value(GTK_RANGE(range), value);
+    g_signal_handler_unblock(range, handler);
+}
+
+// Shape sliders live in a caption row; show or hide the whole row
+static void set_shape_visible(GtkWidget *slider, gboolean visible)
+{
+    gtk_widget_set_visible(gtk_widget_get_parent(slider), visible);
+}
+
+// Only re-resolved when the stream's identity changes; the lookup itself
+// is a cache hit for any application seen before
+static void sync_row_icon(mixer_row_t *row, const volmix_stream_t *stream)
+{
+    // Icon names come interned; process names are interned here so the
+    // key compares by pointer either way
+    const char *icon_name = volmix_stream_get_icon_name(stream);
+    const char *process_name = volmix_stream_get_process_name(stream);
+    const char *icon_key = icon_name ? icon_name : g_intern_string(process_name);
+    
+    if (row->icon_key == icon_key) {
+        return;
+    }
+    
+    GdkPixbuf *pixbuf = app_icon_lookup(icon_key, icon_name, process_name);
+    if (pixbuf) {
+        gtk_image_set_from_pixbuf(GTK_IMAGE(row->icon), pixbuf);
+    } else {
+        gtk_image_set_from_icon_name(GTK_IMAGE(row->icon), "audio-x-generic", GTK_ICON_SIZE_MENU);
+    }
+    row->icon_key = icon_key;
+}
+
+static void sync_row(mixer_row_t *row, const volmix_stream_t *stream)
+{
+    sync_row_icon(row, stream);
+    
+    char label_text[256];
+    snprintf(label_text, sizeof(label_text), "%s (%d%%)%s",
+             volmix_stream_get_name(stream), volmix_stream_get_volume(stream),
+             volmix_stream_is_corked(stream) ? " - paused" : "");
+    gtk_label_set_text(GTK_LABEL(row->label), label_text);
+    
+    // While our own writes are pending, the slider already shows the value
+    // being sent; moving it to an echoed older value would fight a drag
+    if (!volmix_stream_write_pending(stream)) {
+        set_range_silently(row->volume, row->volume_handler,
+                           volmix_stream_get_volume(stream));
+        set_range_silently(row->balance, row->balance_handler,
+                           volmix_stream_get_balance(stream) * 100.0);
+        set_range_silently(row->fade, row->fade_handler,
+                           volmix_stream_get_fade(stream) * 100.0);
+    }
+    
+    // Balance/fade only for streams whose channel map has those axes
+    // (mono has neither, stereo only balance, 4.0/5.1/7.1 both)
+    set_shape_visible(row->balance, volmix_stream_can_balance(stream));
+    set_shape_visible(row->fade, volmix_stream_can_fade(stream));
+}
+
+static mixer_row_t* create_row(mixer_section_t *section, const volmix_stream_t *stream)
+{
+    mixer_row_t *row = g_new0(mixer_row_t, 1);
+    row->section = section;
+    row->index = volmix_stream_get_index(stream);
+    
+    // Create container for this app with minimal spacing
+    row->box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 1);
+    gtk_box_pack_start(GTK_BOX(section->apps_box), row->box, FALSE, FALSE, 1);
+    
+    // Application icon and name label
+    GtkWidget *header = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 4);
+    gtk_box_pack_start(GTK_BOX(row->box), header, FALSE, FALSE, 0);
+    
+    row->icon = gtk_image_new();
+    gtk_widget_set_size_request(row->icon, APP_ICON_SIZE, APP_ICON_SIZE);
+    gtk_box_pack_start(GTK_BOX(header), row->icon, FALSE, FALSE, 0);
+    
+    row->label = gtk_label_new(NULL);
+    gtk_widget_set_halign(row->label, GTK_ALIGN_START);
+    gtk_box_pack_start(GTK_BOX(header), row->label, FALSE, FALSE, 0);
+    
+    // Volume slider
+    row->volume = gtk_scale_new_with_range(GTK_ORIENTATION_HORIZONTAL, 0.0, 100.0, 1.0);
+    gtk_scale_set_draw_value(GTK_SCALE(row->volume), TRUE);
+    gtk_scale_set_value_pos(GTK_SCALE(row->volume), GTK_POS_RIGHT);
+    gtk_widget_set_size_request(row->volume, 160, -1);
+    gtk_box_pack_start(GTK_BOX(row->box), row->volume, FALSE, FALSE, 0);
+    
+    row->balance = pack_shape_slider(row->box, "Balance");
+    row->fade = pack_shape_slider(row->box, "Fade");
+    
+    // The row is keyed by sink input index, so callbacks need no lookup by name
+    row->volume_handler = g_signal_connect(row->volume, "value-changed",
+                                           G_CALLBACK(on_app_volume_changed), row);
+    row->balance_handler = g_signal_connect(row->balance, "value-changed",
+                                            G_CALLBACK(on_app_balance_changed), row);
+    row->fade_handler = g_signal_connect(row->fade, "value-changed",
+                                         G_CALLBACK(on_app_fade_changed), row);
+    
+    gtk_widget_show_all(row->box);
+    sync_row(row, stream);
+    
+    g_hash_table_insert(section->rows, GUINT_TO_POINTER(row->index), row);
+    return row;
+}
+
+static void row_free(gpointer data)
+{
+    mixer_row_t *row = (mixer_row_t *)data;
+    
+    gtk_widget_destroy(row->box);
+    g_free(row);
+}
+
+// Master balance and connection state of one server
+static void sync_master(mixer_section_t *section)
+{
+    gboolean connected = volmix_is_connected(section->vm);
+    gboolean can_balance = connected && volmix_master_can_balance(section->vm);
+    
+    if (can_balance && !volmix_master_write_pending(section->vm)) {
+        set_range_silently(section->master_balance, section->master_balance_handler,
+                           volmix_get_master_balance(section->vm) * 100.0);
+    }
+    set_shape_visible(section->master_balance, can_balance);
+    gtk_widget_set_visible(section->status_label, !connected);
+}
+
+static void remove_row(uint32_t index, void *user_data)
+{
+    mixer_section_t *section = (mixer_section_t *)user_data;
+    
+    g_hash_table_remove(section->rows, GUINT_TO_POINTER(index));
+}
+
+static void update_row(volmix_stream_t *stream, void *user_data)
+{
+    mixer_section_t *section = (mixer_section_t *)user_data;
+    mixer_row_t *row = g_hash_table_lookup(section->rows,
+                                           GUINT_TO_POINTER(volmix_stream_get_index(stream)));
+    
+    if (row) {
+        sync_row(row, stream);
+    } else {
+        create_row(section, stream);
+    }
+}
+
+static gboolean row_is_gone(gpointer key, gpointer value, gpointer user_data)
+{
+    mixer_section_t *section = (mixer_section_t *)user_data;
+    
+    return volmix_find_stream(section->vm, GPOINTER_TO_UINT(key)) == NULL;
+}
+
+// Bring the widgets up to the registry's generation, touching only the
+// rows that changed since the last flush
+static void flush_section(mixer_section_t *section)
+{
+    uint64_t generation = volmix_get_generation(section->vm);
+    if (generation == section->generation) {
+        return;
+    }
+    
+    if (!volmix_changes_since(section->vm, section->generation, remove_row, update_row, section)) {
+        // So far behind that removals are forgotten: compare every row
+        g_hash_table_foreach_remove(section->rows, row_is_gone, section);
+        volmix_foreach_stream(section->vm, update_row, section);
+    }
+    if (volmix_get_master_generation(section->vm) > section->generation) {
+        sync_master(section);
+    }
+    
+    section->generation = generation;
+}
+
+// Apply every pending change to the widgets in one pass
+static void flush_sync(mixer_window_t *mixer)
+{
+    gint64 start_us = g_get_monotonic_time();
+    guint rows = 0;
+    
+    for (guint i = 0; i < mixer->sections->len; i++) {
+        mixer_section_t *section = g_ptr_array_index(mixer->sections, i);
+        flush_section(section);
+        rows += g_hash_table_size(section->rows);
+    }
+    
+    apply_filter(mixer);
+    volmix_flight_mark("mixer-sync", 0, rows, (g_get_monotonic_time() - start_us) * 1000);
+}
+
+static gboolean idle_recheck_callback(gpointer user_data)
+{
+    mixer_window_t *mixer = (mixer_window_t *)user_data;
+    
+    mixer->idle_recheck_source = 0;
+    apply_filter(mixer);
+    
+    return G_SOURCE_REMOVE;
+}
+
+// Filter one section's rows; returns when its next paused stream turns idle
+static gint64 filter_section(mixer_section_t *section, gint64 now)
+{
+    gint64 next_idle = G_MAXINT64;
+    guint hidden = 0;
+    GHashTableIter iter;
+    gpointer key, value;
+    
+    g_hash_table_iter_init(&iter, section->rows);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        mixer_row_t *row = (mixer_row_t *)value;
+        volmix_stream_t *stream = volmix_find_stream(section->vm, row->index);
+        gboolean shown = TRUE;
+        
+        if (section->mixer->active_only && volmix_stream_is_corked(stream)) {
+            gint64 idle_at = volmix_stream_get_last_active(stream) + IDLE_GRACE_US;
+            if (now >= idle_at) {
+                shown = FALSE;
+                hidden++;
+            } else {
+                next_idle = MIN(next_idle, idle_at);
+            }
+        }
+        
+        gtk_widget_set_visible(row->box, shown);
+    }
+    
+    if (hidden > 0) {
+        char idle_text[64];
+        snprintf(idle_text, sizeof(idle_text), "%u idle stream%s hidden",
+                 hidden, hidden == 1 ? "" : "s");
+        gtk_label_set_text(GTK_LABEL(section->idle_label), idle_text);
+    }
+    gtk_widget_set_visible(section->idle_label, hidden > 0);
+    gtk_widget_set_visible(section->no_apps_label,
+                           volmix_is_connected(section->vm) &&
+                           g_hash_table_size(section->rows) == 0);
+    
+    return next_idle;
+}
+
+// Show or hide rows by activity. Only touches widget visibility; the
+// registry already holds the cork state from CHANGE events.
+static void apply_filter(mixer_window_t *mixer)
+{
+    gint64 now = g_get_monotonic_time();
+    gint64 next_idle = G_MAXINT64;
+    
+    for (guint i = 0; i < mixer->sections->len; i++) {
+        next_idle = MIN(next_idle, filter_section(g_ptr_array_index(mixer->sections, i), now));
+    }
+    
+    // One timer for whichever paused stream crosses the grace period first,
+    // only while the window is visible; re-evaluated on show
+    if (mixer->idle_recheck_source) {
+        g_source_remove(mixer->idle_recheck_source);
+        mixer->idle_recheck_source = 0;
+    }
+    if (next_idle != G_MAXINT64 && mixer_window_is_visible(mixer)) {
+        guint delay_ms = (guint)((next_idle - now) / 1000) + 1;
+        mixer->idle_recheck_source = g_timeout_add(delay_ms, idle_recheck_callback, mixer);
+    }
+}
+
+static void on_active_only_toggled(GtkToggleButton *button, gpointer user_data)
+{
+    mixer_window_t *mixer = (mixer_window_t *)user_data;
+    
+    mixer_window_set_active_only(mixer, gtk_toggle_button_get_active(button));
+}
+
+void mixer_window_set_active_only(mixer_window_t *mixer, gboolean active_only)
+{
+    mixer->active_only = active_only;
+    
+    if (mixer->active_only_toggle &&
+        gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(mixer->active_only_toggle)) != active_only) {
+        gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(mixer->active_only_toggle), active_only);
+    }
+    
+    if (mixer->window) {
+        apply_filter(mixer);
+    }
+}
+
+static gboolean sync_callback(gpointer user_data)
+{
+    mixer_window_t *mixer = (mixer_window_t *)user_data;
+    
+    mixer->sync_source = 0;
+    flush_sync(mixer);
+    
+    return G_SOURCE_REMOVE;
+}
+
+static void schedule_sync(mixer_window_t *mixer)
+{
+    if (mixer->sync_source) {
+        return;
+    }
+    
+    if (mixer_window_is_visible(mixer)) {
+        // Coalesce an event burst into one update per main loop pass
+        mixer->sync_source = g_idle_add(sync_callback, mixer);
+    } else {
+        mixer->sync_source = g_timeout_add_seconds(HIDDEN_SYNC_INTERVAL_SECONDS,
+                                                   sync_callback, mixer);
+    }
+}
+
+static gboolean on_window_draw(GtkWidget *widget, cairo_t *cr, gpointer user_data)
+{
+    mixer_window_t *mixer = (mixer_window_t *)user_data;
+    
+    if (mixer->show_requested_us) {
+        gint64 latency = g_get_monotonic_time() - mixer->show_requested_us;
+        mixer->show_requested_us = 0;
+        volmix_flight_mark("mixer-shown", 0, 0, latency * 1000);
+        printf("Mixer window visible %.2f ms after click%s\n", latency / 1000.0,
+               latency > FRAME_BUDGET_US ? " (over one frame budget)" : "");
+    }
+    
+    return FALSE;
+}
+
+// Connected after app_icon's own handler, which empties the icon cache, so
+// the rows' lookups resolve against the new theme
+static void on_icon_theme_changed(GtkIconTheme *theme, gpointer user_data)
+{
+    mixer_window_t *mixer = (mixer_window_t *)user_data;
+    GHashTableIter iter;
+    gpointer value;
+    
+    for (guint i = 0; i < mixer->sections->len; i++) {
+        mixer_section_t *section = g_ptr_array_index(mixer->sections, i);
+        g_hash_table_iter_init(&iter, section->rows);
+        while (g_hash_table_iter_next(&iter, NULL, &value)) {
+            mixer_row_t *row = (mixer_row_t *)value;
+            volmix_stream_t *stream = volmix_find_stream(section->vm, row->index);
+            row->icon_key = NULL;
+            if (stream) {
+                sync_row_icon(row, stream);
+            }
+        }
+    }
+}
+
+static void position_window_near_cursor(GtkWindow *window)
+{
+    // Position the window near the mouse cursor
+    GdkDisplay *display = gdk_display_get_default();
+    GdkSeat *seat = gdk_display_get_default_seat(display);
+    GdkDevice *pointer = gdk_seat_get_pointer(seat);
+    GdkScreen *screen = gdk_display_get_default_screen(display);
+    gint x, y;
+    
+    gdk_device_get_position(pointer, &screen, &x, &y);
+    
+    // Get window size to position it properly
+    gint width, height;
+    gtk_window_get_size(window, &width, &height);
+    
+    // Position window so it appears near the cursor but doesn't go off screen
+    x = x - width / 2;
+    y = y - height - 20; // Above the cursor
+    
+    // Make sure window stays on screen
+    GdkRectangle screen_geometry;
+    gdk_screen_get_monitor_geometry(screen,
+        gdk_screen_get_monitor_at_point(screen, x + width/2, y + height/2),
+        &screen_geometry);
+    
+    if (x < screen_geometry.x) x = screen_geometry.x;
+    if (y < screen_geometry.y) y = screen_geometry.y;
+    if (x + width > screen_geometry.x + screen_geometry.width)
+        x = screen_geometry.x + screen_geometry.width - width;
+    if (y + height > screen_geometry.y + screen_geometry.height)
+        y = screen_geometry.y + screen_geometry.height - height;
+    
+    gtk_window_move(window, x, y);
+}
+
+static mixer_section_t* find_section(mixer_window_t *mixer, volmix_t *vm)
+{
+    // A handful of servers at most; a linear scan beats a hash here
+    for (guint i = 0; i < mixer->sections->len; i++) {
+        mixer_section_t *section = g_ptr_array_index(mixer->sections, i);
+        if (section->vm == vm) {
+            return section;
+        }
+    }
+    return NULL;
+}
+
+static void section_free(gpointer data)
+{
+    mixer_section_t *section = (mixer_section_t *)data;
+    
+    // Rows destroy their own widgets, so drop them before the window
+    g_hash_table_destroy(section->rows);
+    g_free(section);
+}
+
+// Server names only matter once there is more than one server
+static void update_section_titles(mixer_window_t *mixer)
+{
+    gboolean several = mixer->sections->len > 1;
+    
+    for (guint i = 0; i < mixer->sections->len; i++) {
+        mixer_section_t *section = g_ptr_array_index(mixer->sections, i);
+        gtk_widget_set_visible(section->title, several);
+        gtk_widget_set_visible(section->separator, several && i > 0);
+    }
+}
+
+static void build_section(mixer_section_t *section)
+{
+    mixer_window_t *mixer = section->mixer;
+    
+    section->box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 2);
+    gtk_box_pack_start(GTK_BOX(mixer->sections_box), section->box, FALSE, FALSE, 0);
+    
+    // Separates this server from the previous one
+    section->separator = gtk_separator_new(GTK_ORIENTATION_HORIZONTAL);
+    gtk_box_pack_start(GTK_BOX(section->box), section->separator, FALSE, FALSE, 2);
+    
+    const char *server = volmix_get_server(section->vm);
+    char *markup = g_markup_printf_escaped("<b>%s</b>", server ? server : "Default server");
+    section->title = gtk_label_new(NULL);
+    gtk_label_set_markup(GTK_LABEL(section->title), markup);
+    gtk_label_set_ellipsize(GTK_LABEL(section->title), PANGO_ELLIPSIZE_MIDDLE);
+    gtk_box_pack_start(GTK_BOX(section->box), section->title, FALSE, FALSE, 0);
+    g_free(markup);
+    
+    section->status_label = gtk_label_new("Not connected");
+    gtk_widget_set_sensitive(section->status_label, FALSE);
+    gtk_box_pack_start(GTK_BOX(section->box), section->status_label, FALSE, FALSE, 0);
+    
+    // Add master volume header
+    GtkWidget *master_label = gtk_label_new("Master Volume");
+    gtk_label_set_markup(GTK_LABEL(master_label), "<b>Master Volume</b>");
+    gtk_box_pack_start(GTK_BOX(section->box), master_label, FALSE, FALSE, 0);
+    
+    section->master_balance = pack_shape_slider(section->box, "Balance");
+    section->master_balance_handler = g_signal_connect(section->master_balance, "value-changed",
+                                                       G_CALLBACK(on_master_balance_changed), section);
+    
+    // Add separator
+    GtkWidget *separator1 = gtk_separator_new(GTK_ORIENTATION_HORIZONTAL);
+    gtk_box_pack_start(GTK_BOX(section->box), separator1, FALSE, FALSE, 1);
+    
+    // Add application volume controls
+    GtkWidget *apps_label = gtk_label_new("Applications");
+    gtk_label_set_markup(GTK_LABEL(apps_label), "<b>Applications</b>");
+    gtk_box_pack_start(GTK_BOX(section->box), apps_label, FALSE, FALSE, 0);
+    
+    section->no_apps_label = gtk_label_new("No applications playing audio");
+    gtk_box_pack_start(GTK_BOX(section->box), section->no_apps_label, FALSE, FALSE, 0);
+    
+    section->apps_box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 2);
+    gtk_box_pack_start(GTK_BOX(section->box), section->apps_box, FALSE, FALSE, 0);
+    
+    section->idle_label = gtk_label_new(NULL);
+    gtk_widget_set_sensitive(section->idle_label, FALSE);
+    gtk_box_pack_start(GTK_BOX(section->box), section->idle_label, FALSE, FALSE, 0);
+    
+    gtk_widget_show_all(section->box);
+    
+    // Rows for everything already in the registry: all changes since 0
+    sync_master(section);
+    flush_section(section);
+}
+
+void mixer_window_init(mixer_window_t *mixer)
+{
+    memset(mixer, 0, sizeof(mixer_window_t));
+    mixer->sections = g_ptr_array_new_with_free_func(section_free);
+}
+
+void mixer_window_add_server(mixer_window_t *mixer, volmix_t *vm)
+{
+    mixer_section_t *section = g_new0(mixer_section_t, 1);
+    section->mixer = mixer;
+    section->vm = vm;
+    section->rows = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, row_free);
+    g_ptr_array_add(mixer->sections, section);
+    
+    if (mixer->window) {
+        build_section(section);
+        update_section_titles(mixer);
+        apply_filter(mixer);
+    }
+}
+
+void mixer_window_prebuild(mixer_window_t *mixer)
+{
+    if (mixer->window) {
+        return;
+    }
+    
+    // Create popup window
+    mixer->window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
+    gtk_window_set_title(GTK_WINDOW(mixer->window), "Volume Control");
+    gtk_window_set_decorated(GTK_WINDOW(mixer->window), TRUE);
+    gtk_window_set_skip_taskbar_hint(GTK_WINDOW(mixer->window), FALSE);
+    gtk_window_set_skip_pager_hint(GTK_WINDOW(mixer->window), FALSE);
+    gtk_window_set_type_hint(GTK_WINDOW(mixer->window), GDK_WINDOW_TYPE_HINT_DIALOG);
+    gtk_window_set_resizable(GTK_WINDOW(mixer->window), FALSE);
+    
+    // Closing only hides; the window is reused for the next open
+    g_signal_connect(mixer->window, "delete-event", G_CALLBACK(gtk_widget_hide_on_delete), NULL);
+    g_signal_connect_after(mixer->window, "draw", G_CALLBACK(on_window_draw), mixer);
+    mixer->theme_handler = g_signal_connect_after(gtk_icon_theme_get_default(), "changed",
+                                                  G_CALLBACK(on_icon_theme_changed), mixer);
+    
+    // Create main container with minimal spacing
+    GtkWidget *main_box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 2);
+    gtk_container_set_border_width(GTK_CONTAINER(main_box), 4);
+    gtk_container_add(GTK_CONTAINER(mixer->window), main_box);
+    
+    mixer->sections_box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 2);
+    gtk_box_pack_start(GTK_BOX(main_box), mixer->sections_box, FALSE, FALSE, 0);
+    
+    // The filter applies to every server's applications
+    mixer->active_only_toggle = gtk_check_button_new_with_label("Active only");
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(mixer->active_only_toggle), mixer->active_only);
+    gtk_widget_set_tooltip_text(mixer->active_only_toggle, "Hide paused and idle streams");
+    g_signal_connect(mixer->active_only_toggle, "toggled", G_CALLBACK(on_active_only_toggled), mixer);
+    gtk_widget_set_halign(mixer->active_only_toggle, GTK_ALIGN_END);
+    gtk_box_pack_end(GTK_BOX(main_box), mixer->active_only_toggle, FALSE, FALSE, 0);
+    
+    gtk_widget_show_all(main_box);
+    
+    guint apps = 0;
+    for (guint i = 0; i < mixer->sections->len; i++) {
+        mixer_section_t *section = g_ptr_array_index(mixer->sections, i);
+        build_section(section);
+        apps += g_hash_table_size(section->rows);
+    }
+    update_section_titles(mixer);
+    apply_filter(mixer);
+    
+    // Have the GdkWindow ready so the first show skips realization
+    gtk_widget_realize(mixer->window);
+    
+    printf("Mixer window pre-built with %u applications on %u server%s\n", apps,
+           mixer->sections->len, mixer->sections->len == 1 ? "" : "s");
+}
+
+void mixer_window_handle_event(mixer_window_t *mixer, volmix_t *vm, volmix_event_t event,
+                               volmix_stream_t *stream)
+{
+    if (!mixer->window || !find_section(mixer, vm)) {
+        // Not built yet; prebuild reads the whole registry
+        return;
+    }
+    
+    // What changed is read from the registry's generations at flush time;
+    // events that changed nothing cost nothing there
+    schedule_sync(mixer);
+}
+
+gboolean mixer_window_is_visible(mixer_window_t *mixer)
+{
+    return mixer->window && gtk_widget_get_visible(mixer->window);
+}
+
+void mixer_window_toggle(mixer_window_t *mixer)
+{
+    if (mixer_window_is_visible(mixer)) {
+        printf("Tray icon clicked! Hiding volume control window...\n");
+        gtk_widget_hide(mixer->window);
+        if (mixer->idle_recheck_source) {
+            g_source_remove(mixer->idle_recheck_source);
+            mixer->idle_recheck_source = 0;
+        }
+        return;
+    }
+    
+    printf("Tray icon clicked! Showing volume control window...\n");
+    mixer->show_requested_us = g_get_monotonic_time();
+    
+    // Clicked before the idle prebuild ran
+    mixer_window_prebuild(mixer);
+    
+    // Apply changes batched while hidden
+    if (mixer->sync_source) {
+        g_source_remove(mixer->sync_source);
+        mixer->sync_source = 0;
+        flush_sync(mixer);
+    }
+    
+    // Show the window first so GTK can calculate its size
+    gtk_widget_show(mixer->window);
+    
+    // Paused streams may have gone idle while nobody was looking; this
+    // also arms the recheck timer now that the window is visible
+    if (mixer->active_only) {
+        apply_filter(mixer);
+    }
+    
+    // Position the window near the mouse cursor after showing
+    position_window_near_cursor(GTK_WINDOW(mixer->window));
+    gtk_window_present(GTK_WINDOW(mixer->window));
+}
+
+void mixer_window_destroy(mixer_window_t *mixer)
+{
+    if (mixer->sync_source) {
+        g_source_remove(mixer->sync_source);
+        mixer->sync_source = 0;
+    }
+    
+    if (mixer->idle_recheck_source) {
+        g_source_remove(mixer->idle_recheck_source);
+        mixer->idle_recheck_source = 0;
+    }
+    
+    if (mixer->theme_handler) {
+        g_signal_handler_disconnect(gtk_icon_theme_get_default(), mixer->theme_handler);
+        mixer->theme_handler = 0;
+    }
+    
+    // Sections destroy their rows' widgets, so drop them before the window
+    if (mixer->sections) {
+        g_ptr_array_free(mixer->sections, TRUE);
+        mixer->sections = NULL;
+    }
+    
+    if (mixer->window) {
+        gtk_widget_destroy(mixer->window);
+        mixer->window = NULL;
+    }
+}
@@ -0,0 +1,66 @@
+#ifndef MIXER_WINDOW_H
+#define MIXER_WINDOW_H
+
+#include <gtk/gtk.h>
+#include "libvolmix.h"
+
+// The mixer window is built once (from idle time after startup) and kept
+// current while hidden by catching up on registry generations, so opening
+// it from the tray only has to show, position and present it. Each sound server gets its
+// own section with its master balance and application rows.
+typedef struct mixer_window mixer_window_t;
+
+typedef struct {
+    mixer_window_t *mixer;
+    volmix_t *vm;
+    GtkWidget *box;               // Whole section, built with the window
+    GtkWidget *separator;         // Above every section but the first
+    GtkWidget *title;             // Server name, shown with several servers
+    GtkWidget *status_label;      // Shown while not connected
+    GtkWidget *apps_box;          // Holds one row per stream
+    GtkWidget *no_apps_label;
+    GtkWidget *idle_label;        // "N idle streams hidden"
+    GtkWidget *master_balance;
+    gulong master_balance_handler;
+    GHashTable *rows;             // stream index -> mixer_row_t
+    uint64_t generation;          // Registry generation the widgets show
+} mixer_section_t;
+
+struct mixer_window {
+    GtkWidget *window;
+    GtkWidget *sections_box;      // Holds one section per server
+    GtkWidget *active_only_toggle;
+    GPtrArray *sections;          // mixer_section_t, in server order
+    guint sync_source;            // Pending batched sync (idle or timeout)
+    gint64 show_requested_us;     // Click time, for click-to-visible latency
+    gboolean active_only;         // Hide corked/idle streams
+    guint idle_recheck_source;    // Fires when the next corked stream turns idle
+    gulong theme_handler;         // Icon theme "changed": rows look their icons up again
+};
+
+// Prepare the mixer (no widgets are created yet)
+void mixer_window_init(mixer_window_t *mixer);
+
+// Add a section for a server; events for it go to mixer_window_handle_event
+void mixer_window_add_server(mixer_window_t *mixer, volmix_t *vm);
+
+// Build the hidden window from the current registry; safe to call repeatedly
+void mixer_window_prebuild(mixer_window_t *mixer);
+
+// Registry event hook: schedules a (batched) catch-up with the registry
+void mixer_window_handle_event(mixer_window_t *mixer, volmix_t *vm, volmix_event_t event,
+                               volmix_stream_t *stream);
+
+// Show (near the cursor) or hide the window
+void mixer_window_toggle(mixer_window_t *mixer);
+
+gboolean mixer_window_is_visible(mixer_window_t *mixer);
+
+// Show only playing streams (idle ones are collapsed into a count) or all.
+// Works on the cached registry only; no server round trip.
+void mixer_window_set_active_only(mixer_window_t *mixer, gboolean active_only);
+
+// Destroy widgets and release all resources
+void mixer_window_destroy(mixer_window_t *mixer);
+
+#endif // MIXER_WINDOW_H
@@ -0,0 +1,29 @@
+#include "proc_stats.h"
+#include <stdio.h>
+#include <unistd.h>
+
+long proc_stats_get_rss_kib(void)
+{
+    FILE *statm = fopen("/proc/self/statm", "r");
+    if (!statm) {
+        return -1;
+    }
+    
+    // statm: total program size, then resident pages
+    long size_pages, resident_pages;
+    int fields = fscanf(statm, "%ld %ld", &size_pages, &resident_pages);
+    fclose(statm);
+    if (fields != 2) {
+        return -1;
+    }
+    
+    return resident_pages * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+void proc_stats_report_startup(const char *label, gint64 start_us)
+{
+    gint64 elapsed_us = g_get_monotonic_time() - start_us;
+    
+    printf("%s startup: %.1f ms, RSS %ld KiB\n",
+           label, elapsed_us / 1000.0, proc_stats_get_rss_kib());
+}
@@ -0,0 +1,13 @@
+#ifndef PROC_STATS_H
+#define PROC_STATS_H
+
+#include <glib.h>
+
+// Resident set size of this process in KiB, or -1 if /proc is unavailable
+long proc_stats_get_rss_kib(void);
+
+// Log the time since start_us (monotonic) and the current RSS, so the
+// tray and headless builds can be compared from their output
+void proc_stats_report_startup(const char *label, gint64 start_us);
+
+#endif // PROC_STATS_H
@@ -1,169 +1,324 @@
-#include "pulse_client.h"
-#include <stdio.h>
+#include "audio_backend.h"
+#include "caps.h"
+#include "changes.h"
+#include "event_trace.h"
+#include "flight_recorder.h"
+#include "leveler.h"
+#include "schedule.h"
 #include <stdlib.h>
 #include <string.h>
-#include <time.h>
 
-static void context_state_callback(pa_context *c, void *userdata);
-static void sink_info_callback(pa_context *c, const pa_sink_info *info, int eol, void *userdata);
-static void server_info_callback(pa_context *c, const pa_server_info *info, void *userdata);
-static void sink_input_info_callback(pa_context *c, const pa_sink_input_info *info, int eol, void *userdata);
-static void subscription_callback(pa_context *c, pa_subscription_event_type_t t, uint32_t index, void *userdata);
+static void app_audio_update_activity(app_audio_t *app, gboolean corked);
+static void begin_refresh(pulse_client_t *client);
+static void end_refresh(pulse_client_t *client);
+static void enforce_app_cap(pulse_client_t *client, app_audio_t *app);
+static void enforce_master_cap(pulse_client_t *client);
+static int master_cap_of(pulse_client_t *client);
+
+// Deliver a registry change to the listener, if any
+static void notify(pulse_client_t *client, pulse_client_event_t event, app_audio_t *app)
+{
+    if (client->event_cb) {
+        client->event_cb(client, event, app, client->event_cb_data);
+    }
+}
+
+// Report a finished write to the listener, if any
+static void notify_write(pulse_client_t *client, pulse_client_write_t kind, app_audio_t *app,
+                         gboolean success, gboolean resent)
+{
+    if (client->write_cb) {
+        client->write_cb(client, kind, app, success, resent, client->write_cb_data);
+    }
+}
+
+static const audio_backend_t *find_backend(const char *name)
+{
+    if (g_strcmp0(name, pulse_backend.name) == 0) {
+        return &pulse_backend;
+    }
+    if (g_strcmp0(name, replay_backend.name) == 0) {
+        return &replay_backend;
+    }
+#ifdef HAVE_PIPEWIRE
+    if (g_strcmp0(name, pipewire_backend.name) == 0) {
+        return &pipewire_backend;
+    }
+#endif
+    return NULL;
+}
+
+// Native PipeWire when it is built in and a daemon is listening,
+// libpulse (directly or through pipewire-pulse) otherwise
+static const char *default_backend_name(void)
+{
+#ifdef HAVE_PIPEWIRE
+    const char *runtime_dir = g_getenv("XDG_RUNTIME_DIR");
+    if (runtime_dir) {
+        gchar *socket_path = g_build_filename(runtime_dir, "pipewire-0", NULL);
+        gboolean running = g_file_test(socket_path, G_FILE_TEST_EXISTS);
+        g_free(socket_path);
+        if (running) {
+            return pipewire_backend.name;
+        }
+    }
+#endif
+    return pulse_backend.name;
+}
 
 gboolean pulse_client_init(pulse_client_t *client)
 {
-    if (!client) {
-        return FALSE;
+    return pulse_client_init_server(client, NULL, NULL);
+}
+
+gboolean pulse_client_init_server(pulse_client_t *client, const char *backend_name,
+                                  const char *server)
+{
+    if (!backend_name) {
+        const char *name = g_getenv("VOLMIX_BACKEND");
+        if (name && *name) {
+            backend_name = name;
+        }
     }
     
-    memset(client, 0, sizeof(pulse_client_t));
-    client->audio_apps = NULL;
-    client->sink_inputs_changed = FALSE;
+    // Server strings are PulseAudio addresses unless a backend was named
+    gboolean automatic = !backend_name;
+    if (automatic) {
+        backend_name = server ? pulse_backend.name : default_backend_name();
+    }
     
-    // Create mainloop
-    client->mainloop = pa_mainloop_new();
-    if (!client->mainloop) {
-        printf("Failed to create PulseAudio mainloop\n");
+    if (!pulse_client_init_backend(client, backend_name)) {
+        return FALSE;
+    }
+    client->backend_auto = automatic;
+    client->server = g_strdup(server);
+    return TRUE;
+}
+
+gboolean pulse_client_init_backend(pulse_client_t *client, const char *backend_name)
+{
+    if (!client) {
         return FALSE;
     }
     
-    client->mainloop_api = pa_mainloop_get_api(client->mainloop);
-    if (!client->mainloop_api) {
-        printf("Failed to get PulseAudio mainloop API\n");
-        pulse_client_cleanup(client);
+    const audio_backend_t *backend = find_backend(backend_name);
+    if (!backend) {
+        g_message("Unknown audio backend: %s", backend_name ? backend_name : "(null)");
         return FALSE;
     }
     
-    // Create context
-    client->context = pa_context_new(client->mainloop_api, "volmix");
-    if (!client->context) {
-        printf("Failed to create PulseAudio context\n");
+    memset(client, 0, sizeof(pulse_client_t));
+    client->audio_apps = NULL;
+    client->apps_by_index = g_hash_table_new(g_direct_hash, g_direct_equal);
+    client->apps_by_pid = g_hash_table_new(g_direct_hash, g_direct_equal);
+    client->backend = backend;
+    
+    if (!backend->init(client)) {
         pulse_client_cleanup(client);
         return FALSE;
     }
     
-    // Set state callback
-    pa_context_set_state_callback(client->context, context_state_callback, client);
+    client->default_sink_index = PA_INVALID_INDEX;
+    client->caps = volume_caps_load();
+    client->master_cap = -1;
+    client->schedule_master_cap = -1;
+    client->schedule = schedule_load(client);
     
+    const char *trace_path = g_getenv("VOLMIX_TRACE");
+    if (trace_path && *trace_path) {
+        client->trace = event_trace_open(trace_path);
+    }
+    
+    g_message("Using %s audio backend", backend->name);
     return TRUE;
 }
 
+const char* pulse_client_get_server(pulse_client_t *client)
+{
+    return client ? client->server : NULL;
+}
+
+const char* pulse_client_get_backend_name(pulse_client_t *client)
+{
+    if (!client || !client->backend) {
+        return NULL;
+    }
+    return client->backend->name;
+}
+
 void pulse_client_cleanup(pulse_client_t *client)
 {
     if (!client) {
         return;
     }
     
+    leveler_stop(client);
+    schedule_free(client->schedule);
+    client->schedule = NULL;
+    
+    if (client->trace) {
+        event_trace_close(client->trace);
+        client->trace = NULL;
+    }
+    
     // Cleanup audio apps list
+    if (client->apps_by_index) {
+        g_hash_table_destroy(client->apps_by_index);
+        client->apps_by_index = NULL;
+    }
+    
+    if (client->apps_by_pid) {
+        GHashTableIter iter;
+        gpointer apps;
+        g_hash_table_iter_init(&iter, client->apps_by_pid);
+        while (g_hash_table_iter_next(&iter, NULL, &apps)) {
+            g_slist_free(apps);
+        }
+        g_hash_table_destroy(client->apps_by_pid);
+        client->apps_by_pid = NULL;
+    }
+    
     if (client->audio_apps) {
         g_list_free_full(client->audio_apps, (GDestroyNotify)app_audio_free);
         client->audio_apps = NULL;
     }
+    changes_clear(client);
     
-    if (client->operation) {
-        pa_operation_unref(client->operation);
-        client->operation = NULL;
+    if (client->write_count > 0) {
+        gint64 avg_us, max_us;
+        pulse_client_get_write_stats(client, &avg_us, &max_us);
+        g_message("%s backend: %u volume writes, round trip avg %.2f ms, max %.2f ms",
+                  client->backend->name, client->write_count,
+                  avg_us / 1000.0, max_us / 1000.0);
     }
-    
-    if (client->context) {
-        pa_context_unref(client->context);
-        client->context = NULL;
+    if (client->event_count > 0) {
+        gint64 avg_us, max_us;
+        pulse_client_get_event_stats(client, &avg_us, &max_us);
+        g_message("%s backend: %u stream events, to registry avg %.2f ms, max %.2f ms",
+                  client->backend->name, client->event_count,
+                  avg_us / 1000.0, max_us / 1000.0);
+    }
+    if (client->cap_enforcements > 0) {
+        g_message("%s backend: %u volumes capped, slowest in %.2f ms", client->backend->name,
+                  client->cap_enforcements, client->cap_latency_max_us / 1000.0);
     }
     
-    if (client->mainloop) {
-        pa_mainloop_free(client->mainloop);
-        client->mainloop = NULL;
+    if (client->backend) {
+        client->backend->cleanup(client);
     }
     
-    client->mainloop_api = NULL;
+    volume_caps_free(client->caps);
+    client->caps = NULL;
+    g_free(client->default_sink_name);
+    client->default_sink_name = NULL;
+    g_free(client->server);
+    client->server = NULL;
+    client->connecting = FALSE;
     client->connected = FALSE;
 }
 
-gboolean pulse_client_connect(pulse_client_t *client)
+gboolean pulse_client_connect_async(pulse_client_t *client)
 {
-    if (!client || !client->context) {
+    if (!client || !client->backend || !client->backend_data) {
         return FALSE;
     }
     
-    // Connect to PulseAudio server
-    if (pa_context_connect(client->context, NULL, PA_CONTEXT_NOFLAGS, NULL) < 0) {
-        printf("Failed to connect to PulseAudio server: %s\n", 
-               pa_strerror(pa_context_errno(client->context)));
+    if (client->connecting || client->connected) {
+        return TRUE;
+    }
+    
+    client->connecting = TRUE;
+    if (client->backend->connect(client)) {
+        return TRUE;
+    }
+    client->connecting = FALSE;
+    
+    if (!client->backend_auto || client->backend == &pulse_backend) {
         return FALSE;
     }
     
-    // Wait for connection with timeout
-    int retval;
-    const int TIMEOUT_SECONDS = 5;
-    time_t start_time = time(NULL);
+    // The native daemon didn't answer; pipewire-pulse or a real
+    // PulseAudio server may still be there
+    g_message("%s connection failed, falling back to %s",
+              client->backend->name, pulse_backend.name);
+    pulse_client_event_cb cb = client->event_cb;
+    gpointer cb_data = client->event_cb_data;
+    pulse_client_write_cb write_cb = client->write_cb;
+    gpointer write_cb_data = client->write_cb_data;
+    char *server = client->server;
+    client->server = NULL;
     
-    while (TRUE) {
-        // Check for timeout
-        if (time(NULL) - start_time > TIMEOUT_SECONDS) {
-            printf("PulseAudio connection timeout after %d seconds\n", TIMEOUT_SECONDS);
-            return FALSE;
-        }
-        
-        if (pa_mainloop_iterate(client->mainloop, 1, &retval) < 0) {
-            printf("PulseAudio mainloop iteration failed\n");
-            return FALSE;
-        }
-        
-        pa_context_state_t state = pa_context_get_state(client->context);
-        if (state == PA_CONTEXT_READY) {
-            client->connected = TRUE;
-            printf("Connected to PulseAudio server\n");
-            
-            // Subscribe to sink input events to detect when applications start/stop audio
-            pa_context_set_subscribe_callback(client->context, subscription_callback, client);
-            client->operation = pa_context_subscribe(client->context, 
-                                                   PA_SUBSCRIPTION_MASK_SINK_INPUT, 
-                                                   NULL, NULL);
-            if (!client->operation) {
-                printf("Failed to subscribe to PulseAudio events\n");
-                return FALSE;
-            }
-            
-            while (pa_operation_get_state(client->operation) == PA_OPERATION_RUNNING) {
-                pa_mainloop_iterate(client->mainloop, 1, NULL);
-            }
-            pa_operation_unref(client->operation);
-            client->operation = NULL;
-            
-            // Get server info to find default sink
-            client->operation = pa_context_get_server_info(client->context, 
-                                                         server_info_callback, client);
-            if (!client->operation) {
-                printf("Failed to get server info from PulseAudio\n");
-                return FALSE;
-            }
-            
-            while (pa_operation_get_state(client->operation) == PA_OPERATION_RUNNING) {
-                pa_mainloop_iterate(client->mainloop, 1, NULL);
-            }
-            pa_operation_unref(client->operation);
-            client->operation = NULL;
-            
-            return TRUE;
-        } else if (state == PA_CONTEXT_FAILED || state == PA_CONTEXT_TERMINATED) {
-            printf("PulseAudio connection failed\n");
-            return FALSE;
+    // An empty listing retires whatever the failed backend had reported,
+    // so listeners see REMOVED for streams they were told about
+    pulse_client_registry_begin_refresh(client);
+    pulse_client_registry_end_refresh(client);
+    
+    pulse_client_cleanup(client);
+    if (!pulse_client_init_backend(client, pulse_backend.name)) {
+        g_free(server);
+        return FALSE;
+    }
+    client->server = server;
+    pulse_client_set_event_callback(client, cb, cb_data);
+    pulse_client_set_write_callback(client, write_cb, write_cb_data);
+    
+    return pulse_client_connect_async(client);
+}
+
+gboolean pulse_client_connect(pulse_client_t *client)
+{
+    if (!pulse_client_connect_async(client)) {
+        return FALSE;
+    }
+    
+    while (client->connecting) {
+        g_main_context_iteration(NULL, TRUE);
+    }
+    return client->connected;
+}
+
+void pulse_client_connection_changed(pulse_client_t *client, gboolean connected)
+{
+    gboolean was_connected = client->connected;
+    
+    if (client->trace) {
+        event_trace_record_connection(client->trace, connected);
+    }
+    
+    client->connecting = FALSE;
+    client->connected = connected;
+    
+    if (was_connected && !connected) {
+        // Pending writes went down with the connection, and so did the
+        // streams as far as anyone can tell
+        client->master_write_in_flight = FALSE;
+        client->master_volume_dirty = FALSE;
+        begin_refresh(client);
+        end_refresh(client);
+    }
+    
+    flight_recorder_add(connected ? "connected" : "disconnected", FLIGHT_MASTER, 0, 0);
+    changes_record_master(client);
+    notify(client, connected ? PULSE_CLIENT_CONNECTED : PULSE_CLIENT_DISCONNECTED, NULL);
+    
+    // Streams listed while connecting couldn't be written yet
+    if (connected && (client->caps || client->schedule)) {
+        enforce_master_cap(client);
+        for (GList *item = client->audio_apps; item; item = item->next) {
+            enforce_app_cap(client, (app_audio_t *)item->data);
         }
+        schedule_connected(client->schedule);
     }
 }
 
 void pulse_client_disconnect(pulse_client_t *client)
 {
-    if (!client || !client->context) {
+    if (!client || !client->backend_data) {
         return;
     }
     
-    if (client->operation) {
-        pa_operation_unref(client->operation);
-        client->operation = NULL;
-    }
-    
-    pa_context_disconnect(client->context);
+    client->backend->disconnect(client);
+    client->connecting = FALSE;
     client->connected = FALSE;
 }
 
@@ -173,39 +328,105 @@ int pulse_client_get_master_volume(pulse_client_t *client)
         return -1;
     }
     
-    // Return average volume as percentage
-    return (int)((pa_cvolume_avg(&client->default_sink_volume) * 100) / PA_VOLUME_NORM);
+    // Report the loudest channel so balance doesn't lower the reading
+    return pulse_client_pa_volume_to_percent(pa_cvolume_max(&client->default_sink_volume));
+}
+
+gboolean pulse_client_get_master_muted(pulse_client_t *client)
+{
+    if (!client || !client->connected) {
+        return FALSE;
+    }
+    
+    return client->default_sink_muted;
+}
+
+// Send the current master cvolume; replies are coalesced so that at most one
+// write is in flight and the newest value always goes out last
+static gboolean send_master_volume(pulse_client_t *client)
+{
+    int percent = pulse_client_pa_volume_to_percent(pa_cvolume_max(&client->default_sink_volume));
+    
+    flight_recorder_add("write", FLIGHT_MASTER, percent, 0);
+    if (!client->backend->write_master_volume(client, &client->default_sink_volume)) {
+        flight_recorder_add("write-refused", FLIGHT_MASTER, percent, 0);
+        return FALSE;
+    }
+    
+    client->master_write_in_flight = TRUE;
+    client->master_volume_dirty = FALSE;
+    client->master_write_started_us = g_get_monotonic_time();
+    return TRUE;
+}
+
+static gboolean write_master_volume(pulse_client_t *client, const pa_cvolume *new_volume)
+{
+    client->default_sink_volume = *new_volume;
+    changes_record_master(client);
+    
+    if (client->master_write_in_flight) {
+        // Sent from pulse_client_master_write_done once the pending write lands
+        flight_recorder_add("write-held", FLIGHT_MASTER,
+                            pulse_client_pa_volume_to_percent(pa_cvolume_max(new_volume)), 0);
+        client->master_volume_dirty = TRUE;
+        return TRUE;
+    }
+    
+    return send_master_volume(client);
 }
 
 gboolean pulse_client_set_master_volume(pulse_client_t *client, int volume)
 {
-    if (!client || !client->connected || volume < 0 || volume > 100) {
+    if (!client || !client->connected || client->default_sink_index == PA_INVALID_INDEX ||
+        volume < 0 || volume > 100) {
         return FALSE;
     }
     
-    // Convert percentage to PulseAudio volume
-    pa_volume_t pa_volume = pulse_client_percent_to_pa_volume(volume);
+    int cap = master_cap_of(client);
+    if (cap >= 0 && volume > cap) {
+        volume = cap;
+    }
     
-    // Set all channels to same volume
+    // Scale all channels together so the sink keeps its balance
     pa_cvolume new_volume = client->default_sink_volume;
-    pa_cvolume_set(&new_volume, new_volume.channels, pa_volume);
+    pulse_client_cvolume_scale(&new_volume, pulse_client_percent_to_pa_volume(volume));
     
-    // Send volume change to PulseAudio
-    // Clean up any previous operation (running or completed) before starting new one
-    if (client->operation) {
-        pa_operation_unref(client->operation);
+    return write_master_volume(client, &new_volume);
+}
+
+float pulse_client_get_master_balance(pulse_client_t *client)
+{
+    if (!client || !client->connected) {
+        return 0.0f;
     }
-    client->operation = pa_context_set_sink_volume_by_index(client->context,
-                                                           client->default_sink_index,
-                                                           &new_volume,
-                                                           NULL, NULL);
     
-    if (client->operation) {
-        client->default_sink_volume = new_volume;
-        return TRUE;
+    return pa_cvolume_get_balance(&client->default_sink_volume,
+                                  &client->default_sink_channel_map);
+}
+
+gboolean pulse_client_master_can_balance(pulse_client_t *client)
+{
+    if (!client || !client->connected) {
+        return FALSE;
     }
     
-    return FALSE;
+    return pa_channel_map_can_balance(&client->default_sink_channel_map) &&
+           pa_cvolume_compatible_with_channel_map(&client->default_sink_volume,
+                                                  &client->default_sink_channel_map);
+}
+
+gboolean pulse_client_set_master_balance(pulse_client_t *client, float balance)
+{
+    if (!pulse_client_master_can_balance(client) || balance < -1.0f || balance > 1.0f) {
+        return FALSE;
+    }
+    
+    pa_cvolume new_volume = client->default_sink_volume;
+    if (!pa_cvolume_set_balance(&new_volume, &client->default_sink_channel_map, balance)) {
+        return FALSE;
+    }
+    
+    return write_master_volume(client, &new_volume);
 }
 
 gboolean pulse_client_increase_master_volume(pulse_client_t *client, int delta)
@@ -238,150 +459,160 @@ gboolean pulse_client_decrease_master_volume(pulse_client_t *client, int delta)
     return pulse_client_set_master_volume(client, new_volume);
 }
 
-gboolean pulse_client_toggle_master_mute(pulse_client_t *client)
+gboolean pulse_client_set_master_mute(pulse_client_t *client, gboolean muted)
 {
-    if (!client || !client->connected) {
+    if (!client || !client->connected || client->default_sink_index == PA_INVALID_INDEX) {
         return FALSE;
     }
     
-    // Toggle mute state
-    gboolean new_mute_state = !client->default_sink_muted;
-    
-    // Clean up previous operation to prevent memory leak
-    if (client->operation) {
-        pa_operation_unref(client->operation);
-        client->operation = NULL;
-    }
-    client->operation = pa_context_set_sink_mute_by_index(client->context,
-                                                         client->default_sink_index,
-                                                         new_mute_state ? 1 : 0,
-                                                         NULL, NULL);
-    
-    if (client->operation) {
-        client->default_sink_muted = new_mute_state;
+    flight_recorder_add("mute", FLIGHT_MASTER, muted, 0);
+    if (client->backend->write_master_mute(client, muted)) {
+        client->default_sink_muted = muted;
+        changes_record_master(client);
         return TRUE;
     }
     
     return FALSE;
 }
 
-void pulse_client_iterate(pulse_client_t *client)
+gboolean pulse_client_toggle_master_mute(pulse_client_t *client)
 {
-    if (!client || !client->mainloop) {
-        return;
+    if (!client || !client->connected) {
+        return FALSE;
     }
     
-    // Process pending PulseAudio events (non-blocking)
-    int retval;
-    pa_mainloop_iterate(client->mainloop, 0, &retval);
+    return pulse_client_set_master_mute(client, !client->default_sink_muted);
 }
 
-gboolean pulse_client_sink_inputs_changed(pulse_client_t *client)
+void pulse_client_set_event_callback(pulse_client_t *client, pulse_client_event_cb cb,
+                                     gpointer user_data)
 {
     if (!client) {
-        return FALSE;
+        return;
     }
     
-    gboolean changed = client->sink_inputs_changed;
-    client->sink_inputs_changed = FALSE; // Reset the flag
-    return changed;
+    client->event_cb = cb;
+    client->event_cb_data = user_data;
 }
 
-// Callback functions
-static void context_state_callback(pa_context *c, void *userdata)
+void pulse_client_set_write_callback(pulse_client_t *client, pulse_client_write_cb cb,
+                                     gpointer user_data)
 {
-    pulse_client_t *client = (pulse_client_t *)userdata;
-    
-    switch (pa_context_get_state(c)) {
-        case PA_CONTEXT_CONNECTING:
-            printf("PulseAudio: Connecting...\n");
-            break;
-        case PA_CONTEXT_AUTHORIZING:
-            printf("PulseAudio: Authorizing...\n");
-            break;
-        case PA_CONTEXT_SETTING_NAME:
-            printf("PulseAudio: Setting name...\n");
-            break;
-        case PA_CONTEXT_READY:
-            printf("PulseAudio: Ready\n");
-            break;
-        case PA_CONTEXT_FAILED:
-            printf("PulseAudio: Connection failed\n");
-            break;
-        case PA_CONTEXT_TERMINATED:
-            printf("PulseAudio: Connection terminated\n");
-            break;
-        default:
-            break;
+    if (!client) {
+        return;
     }
+    
+    client->write_cb = cb;
+    client->write_cb_data = user_data;
 }
 
-static void sink_info_callback(pa_context *c, const pa_sink_info *info, int eol, void *userdata)
+// Application management functions
+void pulse_client_refresh_apps(pulse_client_t *client)
 {
-    pulse_client_t *client = (pulse_client_t *)userdata;
-    
-    if (eol > 0) {
+    if (!client || !client->connected) {
         return;
     }
     
-    if (!info) {
-        return;
+    client->backend->refresh_apps(client);
+}
+
+GList* pulse_client_get_apps(pulse_client_t *client)
+{
+    if (!client) {
+        return NULL;
     }
-    
-    // Store default sink information
-    client->default_sink_index = info->index;
-    client->default_sink_volume = info->volume;
-    client->default_sink_muted = info->mute ? TRUE : FALSE;
-    
-    printf("Default sink: %s (index=%u, volume=%d%%, muted=%s)\n",
-           info->name, info->index, 
-           (int)((pa_cvolume_avg(&info->volume) * 100) / PA_VOLUME_NORM),
-           info->mute ? "yes" : "no");
+    return client->audio_apps;
 }
 
-static void server_info_callback(pa_context *c, const pa_server_info *info, void *userdata)
+app_audio_t* pulse_client_get_app(pulse_client_t *client, uint32_t sink_input_index)
 {
-    pulse_client_t *client = (pulse_client_t *)userdata;
-    
-    if (!info || !info->default_sink_name) {
+    if (!client || !client->apps_by_index) {
+        return NULL;
+    }
+    return g_hash_table_lookup(client->apps_by_index, GUINT_TO_POINTER(sink_input_index));
+}
+
+GSList* pulse_client_get_apps_by_pid(pulse_client_t *client, uint32_t pid)
+{
+    if (!client || !client->apps_by_pid || pid == 0) {
+        return NULL;
+    }
+    return g_hash_table_lookup(client->apps_by_pid, GUINT_TO_POINTER(pid));
+}
+
+// The list head can change, so the table entry is rewritten each time
+static void pid_index_add(pulse_client_t *client, app_audio_t *app)
+{
+    if (app->pid == 0) {
         return;
     }
     
-    printf("Default sink name: %s\n", info->default_sink_name);
-    
-    // Get information about the default sink
-    client->operation = pa_context_get_sink_info_by_name(c, info->default_sink_name,
-                                                        sink_info_callback, client);
+    GSList *apps = g_hash_table_lookup(client->apps_by_pid, GUINT_TO_POINTER(app->pid));
+    g_hash_table_insert(client->apps_by_pid, GUINT_TO_POINTER(app->pid),
+                        g_slist_append(apps, app));
 }
 
-// Application management functions
-void pulse_client_refresh_apps(pulse_client_t *client)
+static void pid_index_remove(pulse_client_t *client, app_audio_t *app)
 {
-    if (!client || !client->connected) {
+    if (app->pid == 0) {
         return;
     }
     
-    // Clear existing apps list
-    if (client->audio_apps) {
-        g_list_free_full(client->audio_apps, (GDestroyNotify)app_audio_free);
-        client->audio_apps = NULL;
+    GSList *apps = g_hash_table_lookup(client->apps_by_pid, GUINT_TO_POINTER(app->pid));
+    apps = g_slist_remove(apps, app);
+    if (apps) {
+        g_hash_table_insert(client->apps_by_pid, GUINT_TO_POINTER(app->pid), apps);
+    } else {
+        g_hash_table_remove(client->apps_by_pid, GUINT_TO_POINTER(app->pid));
     }
+}
+
+static void remove_app(pulse_client_t *client, app_audio_t *app)
+{
+    flight_recorder_add("stream-gone", app->index, app_audio_get_volume_percent(app), 0);
+    notify(client, PULSE_CLIENT_APP_REMOVED, app);
     
-    // Get all sink inputs (applications with audio streams)
-    if (client->operation) {
-        pa_operation_unref(client->operation);
+    changes_record_removed(client, app);
+    leveler_app_removed(client, app);
+    pid_index_remove(client, app);
+    g_hash_table_remove(client->apps_by_index, GUINT_TO_POINTER(app->index));
+    client->audio_apps = g_list_remove(client->audio_apps, app);
+    app_audio_free(app);
+}
+
+static app_audio_t* find_app(pulse_client_t *client, uint32_t sink_input_index)
+{
+    return g_hash_table_lookup(client->apps_by_index, GUINT_TO_POINTER(sink_input_index));
+}
+
+static gboolean send_app_volume(pulse_client_t *client, app_audio_t *app)
+{
+    flight_recorder_add("write", app->index, app_audio_get_volume_percent(app), 0);
+    if (!client->backend->write_app_volume(client, app->index, &app->volume)) {
+        flight_recorder_add("write-refused", app->index, app_audio_get_volume_percent(app), 0);
+        return FALSE;
     }
-    client->operation = pa_context_get_sink_input_info_list(client->context,
-                                                           sink_input_info_callback,
-                                                           client);
+    
+    app->write_in_flight = TRUE;
+    app->volume_dirty = FALSE;
+    app->write_started_us = g_get_monotonic_time();
+    return TRUE;
 }
 
-GList* pulse_client_get_apps(pulse_client_t *client)
+static gboolean write_app_volume(pulse_client_t *client, app_audio_t *app, const pa_cvolume *new_volume)
 {
-    if (!client) {
-        return NULL;
+    app->volume = *new_volume;
+    changes_record_app(client, app);
+    
+    if (app->write_in_flight) {
+        // A slider drag produces far more values than round trips; keep
+        // only the latest and send it when the pending write completes
+        flight_recorder_add("write-held", app->index, app_audio_get_volume_percent(app), 0);
+        app->volume_dirty = TRUE;
+        return TRUE;
     }
-    return client->audio_apps;
+    
+    return send_app_volume(client, app);
 }
 
 gboolean pulse_client_set_app_volume(pulse_client_t *client, uint32_t sink_input_index, int volume)
@@ -390,93 +621,120 @@ gboolean pulse_client_set_app_volume(pulse_client_t *client, uint32_t sink_input
         return FALSE;
     }
     
-    // Convert percentage to PulseAudio volume
-    pa_volume_t pa_volume = pulse_client_percent_to_pa_volume(volume);
+    // Without the stream's own channel layout there is nothing to scale;
+    // a made-up one would flatten it or be rejected
+    app_audio_t *app = find_app(client, sink_input_index);
+    if (!app) {
+        return FALSE;
+    }
     
-    // Find the app to get current volume structure
-    GList *item = client->audio_apps;
-    pa_cvolume new_volume;
-    gboolean found = FALSE;
+    if (app->volume_cap >= 0 && volume > app->volume_cap) {
+        volume = app->volume_cap;
+    }
     
-    while (item) {
-        app_audio_t *app = (app_audio_t *)item->data;
-        if (app->index == sink_input_index) {
-            new_volume = app->volume;
-            pa_cvolume_set(&new_volume, new_volume.channels, pa_volume);
-            found = TRUE;
-            break;
-        }
-        item = item->next;
+    // Scale every channel by the same factor so balance and fade survive
+    pa_cvolume new_volume = app->volume;
+    pulse_client_cvolume_scale(&new_volume, pulse_client_percent_to_pa_volume(volume));
+    return write_app_volume(client, app, &new_volume);
+}
+
+gboolean pulse_client_set_app_balance(pulse_client_t *client, uint32_t sink_input_index, float balance)
+{
+    if (!client || !client->connected || balance < -1.0f || balance > 1.0f) {
+        return FALSE;
     }
     
-    if (!found) {
-        // Default to stereo if app not found
-        pa_cvolume_init(&new_volume);
-        pa_cvolume_set(&new_volume, 2, pa_volume);
+    app_audio_t *app = find_app(client, sink_input_index);
+    if (!app || !app_audio_can_balance(app)) {
+        return FALSE;
     }
     
-    // Send volume change to PulseAudio
-    // Clean up any previous operation (running or completed) before starting new one
-    if (client->operation) {
-        pa_operation_unref(client->operation);
+    pa_cvolume new_volume = app->volume;
+    if (!pa_cvolume_set_balance(&new_volume, &app->channel_map, balance)) {
+        return FALSE;
     }
-    client->operation = pa_context_set_sink_input_volume(client->context,
-                                                        sink_input_index,
-                                                        &new_volume,
-                                                        NULL, NULL);
     
-    return client->operation != NULL;
+    return write_app_volume(client, app, &new_volume);
 }
 
-gboolean pulse_client_toggle_app_mute(pulse_client_t *client, uint32_t sink_input_index)
+gboolean pulse_client_set_app_fade(pulse_client_t *client, uint32_t sink_input_index, float fade)
 {
-    if (!client || !client->connected) {
+    if (!client || !client->connected || fade < -1.0f || fade > 1.0f) {
         return FALSE;
     }
     
-    // Find the app to get current mute state
-    GList *item = client->audio_apps;
-    gboolean current_muted = FALSE;
+    app_audio_t *app = find_app(client, sink_input_index);
+    if (!app || !app_audio_can_fade(app)) {
+        return FALSE;
+    }
     
-    while (item) {
-        app_audio_t *app = (app_audio_t *)item->data;
-        if (app->index == sink_input_index) {
-            current_muted = app->muted;
-            break;
-        }
-        item = item->next;
+    pa_cvolume new_volume = app->volume;
+    if (!pa_cvolume_set_fade(&new_volume, &app->channel_map, fade)) {
+        return FALSE;
     }
     
-    // Toggle mute state
-    gboolean new_mute_state = !current_muted;
+    return write_app_volume(client, app, &new_volume);
+}
+
+static gboolean write_app_mute(pulse_client_t *client, uint32_t sink_input_index, gboolean muted,
+                               gboolean engine)
+{
+    if (!client || !client->connected) {
+        return FALSE;
+    }
     
-    // Clean up previous operation
-    if (client->operation) {
-        pa_operation_unref(client->operation);
-        client->operation = NULL;
+    // The new state arrives with the server's change event
+    flight_recorder_add("mute", sink_input_index, muted, 0);
+    return client->backend->write_app_mute(client, sink_input_index, muted, engine);
+}
+
+gboolean pulse_client_set_app_mute(pulse_client_t *client, uint32_t sink_input_index, gboolean muted)
+{
+    return write_app_mute(client, sink_input_index, muted, FALSE);
+}
+
+gboolean pulse_client_engine_set_app_mute(pulse_client_t *client, uint32_t sink_input_index,
+                                          gboolean muted)
+{
+    return write_app_mute(client, sink_input_index, muted, TRUE);
+}
+
+gboolean pulse_client_toggle_app_mute(pulse_client_t *client, uint32_t sink_input_index)
+{
+    if (!client || !client->connected) {
+        return FALSE;
     }
-    client->operation = pa_context_set_sink_input_mute(client->context,
-                                                      sink_input_index,
-                                                      new_mute_state ? 1 : 0,
-                                                      NULL, NULL);
     
-    return client->operation != NULL;
+    // Find the app to get current mute state
+    app_audio_t *app = find_app(client, sink_input_index);
+    gboolean current_muted = app ? app->muted : FALSE;
+    
+    return pulse_client_set_app_mute(client, sink_input_index, !current_muted);
 }
 
 // Helper functions for app_audio_t
 app_audio_t* app_audio_new(uint32_t index, const char *name, const char *process_name,
-                          const pa_cvolume *volume, gboolean muted)
+                          const pa_cvolume *volume, const pa_channel_map *channel_map,
+                          gboolean muted)
 {
     app_audio_t *app = g_malloc0(sizeof(app_audio_t));
     app->index = index;
     app->name = g_strdup(name ? name : "Unknown Application");
     app->process_name = g_strdup(process_name ? process_name : "unknown");
+    app->icon_name = NULL;
     if (volume) {
         app->volume = *volume;
     } else {
         pa_cvolume_init(&app->volume);
     }
+    if (channel_map) {
+        app->channel_map = *channel_map;
+    } else {
+        pa_channel_map_init(&app->channel_map);
+    }
     app->muted = muted;
+    app->last_active_us = g_get_monotonic_time();
+    app->volume_cap = -1;
     return app;
 }
 
@@ -489,12 +747,64 @@ void app_audio_free(app_audio_t *app)
     }
 }
 
+void app_audio_set_icon_name(app_audio_t *app, const char *icon_name)
+{
+    if (!app) {
+        return;
+    }
+    
+    app->icon_name = g_intern_string(icon_name);
+}
+
+// Track cork state from CHANGE events; last_active_us marks the moment a
+// stream was last known to be playing
+static void app_audio_update_activity(app_audio_t *app, gboolean corked)
+{
+    if (!corked || !app->corked) {
+        app->last_active_us = g_get_monotonic_time();
+    }
+    app->corked = corked;
+}
+
+gboolean app_audio_is_idle(const app_audio_t *app, gint64 now_us, gint64 grace_us)
+{
+    return app && app->corked && now_us - app->last_active_us >= grace_us;
+}
+
 int app_audio_get_volume_percent(const app_audio_t *app)
 {
     if (!app) {
         return 0;
     }
-    return (int)((pa_cvolume_avg(&app->volume) * 100) / PA_VOLUME_NORM);
+    return pulse_client_pa_volume_to_percent(pa_cvolume_max(&app->volume));
+}
+
+gboolean app_audio_can_balance(const app_audio_t *app)
+{
+    return app && pa_channel_map_can_balance(&app->channel_map) &&
+           pa_cvolume_compatible_with_channel_map(&app->volume, &app->channel_map);
+}
+
+gboolean app_audio_can_fade(const app_audio_t *app)
+{
+    return app && pa_channel_map_can_fade(&app->channel_map) &&
+           pa_cvolume_compatible_with_channel_map(&app->volume, &app->channel_map);
+}
+
+float app_audio_get_balance(const app_audio_t *app)
+{
+    if (!app_audio_can_balance(app)) {
+        return 0.0f;
+    }
+    return pa_cvolume_get_balance(&app->volume, &app->channel_map);
+}
+
+float app_audio_get_fade(const app_audio_t *app)
+{
+    if (!app_audio_can_fade(app)) {
+        return 0.0f;
+    }
+    return pa_cvolume_get_fade(&app->volume, &app->channel_map);
 }
 
 pa_volume_t pulse_client_percent_to_pa_volume(int volume_percent)
@@ -506,53 +816,464 @@ pa_volume_t pulse_client_percent_to_pa_volume(int volume_percent)
     return (pa_volume_t)((volume_percent * PA_VOLUME_NORM) / 100);
 }
 
-static void sink_input_info_callback(pa_context *c, const pa_sink_input_info *info, int eol, void *userdata)
+int pulse_client_pa_volume_to_percent(pa_volume_t volume)
+{
+    // Round to nearest so percent -> pa_volume -> percent is lossless
+    return (int)(((uint64_t)volume * 100 + PA_VOLUME_NORM / 2) / PA_VOLUME_NORM);
+}
+
+void pulse_client_cvolume_scale(pa_cvolume *cvolume, pa_volume_t target)
+{
+    if (!cvolume || !pa_cvolume_valid(cvolume)) {
+        return;
+    }
+    
+    if (pa_cvolume_max(cvolume) == PA_VOLUME_MUTED) {
+        pa_cvolume_set(cvolume, cvolume->channels, target);
+        return;
+    }
+    
+    // Integer per-channel multiply/divide, no float round trip
+    pa_cvolume_scale(cvolume, target);
+}
+
+// Caps are enforced from the report that shows a stream above its cap:
+// the registry already holds everything needed, so the corrected write
+// goes out at once and the whole correction costs its one round trip.
+// Reports during our own writes are echoes and are left to those.
+static void enforce_app_cap(pulse_client_t *client, app_audio_t *app)
+{
+    if (app->volume_cap < 0 || app->write_in_flight || app->volume_dirty || !client->connected ||
+        app_audio_get_volume_percent(app) <= app->volume_cap) {
+        return;
+    }
+    
+    flight_recorder_add("cap", app->index, app_audio_get_volume_percent(app), 0);
+    g_debug("%s at %d%%, over its %d%% cap", app->name,
+            app_audio_get_volume_percent(app), app->volume_cap);
+    gint64 reported_us = g_get_monotonic_time();
+    if (pulse_client_set_app_volume(client, app->index, app->volume_cap)) {
+        app->cap_enforced_us = reported_us;
+    }
+}
+
+// The tighter of the sink's cap and the schedule's, -1 for none
+static int master_cap_of(pulse_client_t *client)
+{
+    int cap = client->master_cap;
+    
+    if (client->schedule_master_cap >= 0 && (cap < 0 || client->schedule_master_cap < cap)) {
+        cap = client->schedule_master_cap;
+    }
+    return cap;
+}
+
+static void enforce_master_cap(pulse_client_t *client)
 {
-    pulse_client_t *client = (pulse_client_t *)userdata;
+    int volume = pulse_client_pa_volume_to_percent(pa_cvolume_max(&client->default_sink_volume));
+    int cap = master_cap_of(client);
     
-    if (eol > 0) {
+    if (cap < 0 || client->master_write_in_flight ||
+        client->master_volume_dirty || !client->connected || volume <= cap) {
         return;
     }
     
-    if (!info) {
+    flight_recorder_add("cap", FLIGHT_MASTER, volume, 0);
+    g_debug("Sink %s at %d%%, over its %d%% cap", client->default_sink_name, volume, cap);
+    gint64 reported_us = g_get_monotonic_time();
+    if (pulse_client_set_master_volume(client, cap)) {
+        client->master_cap_enforced_us = reported_us;
+    }
+}
+
+void pulse_client_set_schedule_cap(pulse_client_t *client, int cap)
+{
+    if (!client) {
+        return;
+    }
+    
+    client->schedule_master_cap = cap;
+    enforce_master_cap(client);
+}
+
+static void record_cap_latency(pulse_client_t *client, gint64 *enforced_us, const char *name,
+                               gboolean success)
+{
+    gint64 latency_us = g_get_monotonic_time() - *enforced_us;
+    
+    *enforced_us = 0;
+    if (!success) {
+        return;
+    }
+    
+    client->cap_enforcements++;
+    if (latency_us > client->cap_latency_max_us) {
+        client->cap_latency_max_us = latency_us;
+    }
+    g_debug("%s capped in %.2f ms", name, latency_us / 1000.0);
+}
+
+guint pulse_client_get_cap_stats(pulse_client_t *client, gint64 *max_us)
+{
+    if (max_us) {
+        *max_us = client ? client->cap_latency_max_us : 0;
+    }
+    return client ? client->cap_enforcements : 0;
+}
+
+// Registry updates from the backends
+
+void pulse_client_registry_set_master(pulse_client_t *client, uint32_t index,
+                                      const char *name, const pa_cvolume *volume,
+                                      const pa_channel_map *channel_map,
+                                      gboolean muted)
+{
+    if (client->trace) {
+        event_trace_record_master(client->trace, index, name, volume, channel_map, muted);
+    }
+    
+    // Servers report the sink again for changes we don't show
+    gboolean changed = index != client->default_sink_index || muted != client->default_sink_muted ||
+                       !pa_channel_map_equal(channel_map, &client->default_sink_channel_map);
+    
+    if (g_strcmp0(client->default_sink_name, name) != 0) {
+        changed = TRUE;
+        g_free(client->default_sink_name);
+        client->default_sink_name = g_strdup(name);
+        client->master_cap = volume_caps_for_sink(client->caps, name);
+    }
+    
+    // Store default sink information. While our own writes are pending the
+    // server echoes older values; the local volume is the newest one then.
+    client->default_sink_index = index;
+    if (!client->master_write_in_flight && !client->master_volume_dirty) {
+        changed |= !pa_cvolume_equal(volume, &client->default_sink_volume);
+        client->default_sink_volume = *volume;
+    }
+    client->default_sink_channel_map = *channel_map;
+    client->default_sink_muted = muted;
+    if (changed) {
+        changes_record_master(client);
+    }
+    flight_recorder_add("master", FLIGHT_MASTER,
+                        pulse_client_pa_volume_to_percent(pa_cvolume_max(volume)), 0);
+    enforce_master_cap(client);
+    
+    notify(client, PULSE_CLIENT_MASTER_CHANGED, NULL);
+}
+
+// Readings go to zero and writes are refused until a sink is reported
+void pulse_client_registry_clear_master(pulse_client_t *client)
+{
+    if (client->default_sink_index == PA_INVALID_INDEX) {
         return;
     }
     
-    // Extract application name from properties
-    const char *app_name = pa_proplist_gets(info->proplist, PA_PROP_APPLICATION_NAME);
-    const char *process_name = pa_proplist_gets(info->proplist, PA_PROP_APPLICATION_PROCESS_BINARY);
+    if (client->trace) {
+        pa_cvolume volume;
+        pa_channel_map channel_map;
+        pa_cvolume_init(&volume);
+        pa_channel_map_init(&channel_map);
+        event_trace_record_master(client->trace, PA_INVALID_INDEX, NULL, &volume,
+                                  &channel_map, FALSE);
+    }
+    
+    g_message("Default sink %s went away",
+              client->default_sink_name ? client->default_sink_name : "(unnamed)");
+    client->default_sink_index = PA_INVALID_INDEX;
+    g_free(client->default_sink_name);
+    client->default_sink_name = NULL;
+    client->master_cap = -1;
+    pa_cvolume_init(&client->default_sink_volume);
+    pa_channel_map_init(&client->default_sink_channel_map);
+    client->default_sink_muted = FALSE;
     
-    if (!app_name) {
-        app_name = pa_proplist_gets(info->proplist, "application.name");
+    changes_record_master(client);
+    flight_recorder_add("master-gone", FLIGHT_MASTER, 0, 0);
+    notify(client, PULSE_CLIENT_MASTER_CHANGED, NULL);
+}
+
+static void record_event_latency(pulse_client_t *client, gint64 event_us)
+{
+    gint64 latency_us = g_get_monotonic_time() - event_us;
+    
+    client->event_count++;
+    client->event_latency_total_us += latency_us;
+    if (latency_us > client->event_latency_max_us) {
+        client->event_latency_max_us = latency_us;
+    }
+}
+
+app_audio_t* pulse_client_registry_update(pulse_client_t *client, const audio_stream_info_t *info)
+{
+    if (client->trace) {
+        event_trace_record_stream(client->trace, info);
+    }
+    if (info->event_us > 0) {
+        record_event_latency(client, info->event_us);
     }
     
-    if (!process_name) {
-        process_name = pa_proplist_gets(info->proplist, "application.process.binary");
+    const char *app_name = info->name ? info->name : "Unknown Application";
+    const char *process_name = info->process_name ? info->process_name : "unknown";
+    
+    // Interned so consumers can cache per application by pointer
+    const char *icon_name = g_intern_string(info->icon_name);
+    
+    app_audio_t *app = find_app(client, info->index);
+    if (app) {
+        gboolean renamed = FALSE;
+        const char *old_icon_name = app->icon_name;
+        
+        // Update in place so existing widgets and in-flight writes stay attached
+        if (g_strcmp0(app->name, app_name) != 0) {
+            g_free(app->name);
+            app->name = g_strdup(app_name);
+            renamed = TRUE;
+        }
+        if (g_strcmp0(app->process_name, process_name) != 0) {
+            g_free(app->process_name);
+            app->process_name = g_strdup(process_name);
+            renamed = TRUE;
+        }
+        if (renamed) {
+            app->volume_cap = volume_caps_for_app(client->caps, info->process_name, info->name);
+        }
+        app_audio_set_icon_name(app, icon_name);
+        
+        // Refreshes report every stream again; only real differences are changes
+        gboolean changed = renamed || app->icon_name != old_icon_name || app->pid != info->pid ||
+                           app->muted != info->muted || app->corked != info->corked ||
+                           !pa_channel_map_equal(&app->channel_map, &info->channel_map);
+        if (app->pid != info->pid) {
+            pid_index_remove(client, app);
+            app->pid = info->pid;
+            pid_index_add(client, app);
+        }
+        // Echoes of our own pending writes carry older volumes
+        if (!app->write_in_flight && !app->volume_dirty) {
+            changed |= !pa_cvolume_equal(&app->volume, &info->volume);
+            app->volume = info->volume;
+        }
+        app->channel_map = info->channel_map;
+        app->muted = info->muted;
+        app_audio_update_activity(app, info->corked);
+        app->seen_serial = client->refresh_serial;
+        if (changed) {
+            changes_record_app(client, app);
+        }
+        flight_recorder_add(changed ? "stream" : "stream-same", app->index,
+                            pulse_client_pa_volume_to_percent(pa_cvolume_max(&info->volume)), 0);
+        enforce_app_cap(client, app);
+        
+        notify(client, PULSE_CLIENT_APP_CHANGED, app);
+        return app;
     }
     
     // Create new app audio entry
-    app_audio_t *app = app_audio_new(info->index, app_name, process_name, &info->volume, info->mute);
+    app = app_audio_new(info->index, app_name, process_name,
+                        &info->volume, &info->channel_map, info->muted);
+    app_audio_set_icon_name(app, icon_name);
+    app->pid = info->pid;
+    app->corked = info->corked;
+    app->seen_serial = client->refresh_serial;
+    app->volume_cap = volume_caps_for_app(client->caps, info->process_name, info->name);
     
     // Add to list
     client->audio_apps = g_list_append(client->audio_apps, app);
+    g_hash_table_insert(client->apps_by_index, GUINT_TO_POINTER(app->index), app);
+    pid_index_add(client, app);
+    changes_record_app(client, app);
+    schedule_app_added(client->schedule, app);
+    flight_recorder_add("stream-new", app->index, app_audio_get_volume_percent(app), 0);
+    leveler_app_added(client, app);
+    enforce_app_cap(client, app);
     
-    printf("Found audio app: %s (process: %s, index=%u, volume=%d%%, muted=%s)\n",
-           app->name, app->process_name, app->index, 
-           app_audio_get_volume_percent(app),
-           app->muted ? "yes" : "no");
+    g_debug("Found audio app: %s (process: %s, index=%u, volume=%d%%, muted=%s, corked=%s)",
+            app->name, app->process_name, app->index, 
+            app_audio_get_volume_percent(app),
+            app->muted ? "yes" : "no",
+            app->corked ? "yes" : "no");
+    
+    notify(client, PULSE_CLIENT_APP_ADDED, app);
+    return app;
+}
+
+uint32_t pulse_client_parse_pid(const char *value)
+{
+    char *end = NULL;
+    guint64 pid;
+    
+    if (!value || !value[0]) {
+        return 0;
+    }
+    
+    pid = g_ascii_strtoull(value, &end, 10);
+    return (*end || pid > G_MAXUINT32) ? 0 : (uint32_t)pid;
 }
 
-// Subscription callback to handle PulseAudio events
-static void subscription_callback(pa_context *c, pa_subscription_event_type_t t, uint32_t index, void *userdata)
+void pulse_client_registry_remove(pulse_client_t *client, uint32_t index)
 {
-    pulse_client_t *client = (pulse_client_t *)userdata;
+    if (client->trace) {
+        event_trace_record_remove(client->trace, index);
+    }
     
-    // Check if this is a sink input event
-    if ((t & PA_SUBSCRIPTION_EVENT_FACILITY_MASK) == PA_SUBSCRIPTION_EVENT_SINK_INPUT) {
-        // Mark that sink inputs have changed - this will trigger UI update
-        client->sink_inputs_changed = TRUE;
-        printf("Sink input event detected (index=%u, type=%s)\n", index,
-               (t & PA_SUBSCRIPTION_EVENT_TYPE_MASK) == PA_SUBSCRIPTION_EVENT_NEW ? "NEW" :
-               (t & PA_SUBSCRIPTION_EVENT_TYPE_MASK) == PA_SUBSCRIPTION_EVENT_REMOVE ? "REMOVE" : "CHANGE");
+    app_audio_t *app = find_app(client, index);
+    if (app) {
+        remove_app(client, app);
+    }
+}
+
+// Entries not reported between begin and end of a listing are dropped at
+// its end; the rest are updated in place so widgets and pending writes
+// stay valid
+static void begin_refresh(pulse_client_t *client)
+{
+    client->refresh_serial++;
+    flight_recorder_add("refresh", FLIGHT_MASTER, g_list_length(client->audio_apps), 0);
+}
+
+static void end_refresh(pulse_client_t *client)
+{
+    GList *item = client->audio_apps;
+    while (item) {
+        GList *next = item->next;
+        app_audio_t *app = (app_audio_t *)item->data;
+        if (app->seen_serial != client->refresh_serial) {
+            remove_app(client, app);
+        }
+        item = next;
     }
-}
\ No newline at end of file
+}
+
+void pulse_client_registry_begin_refresh(pulse_client_t *client)
+{
+    if (client->trace) {
+        event_trace_record_refresh(client->trace, TRUE);
+    }
+    begin_refresh(client);
+}
+
+void pulse_client_registry_end_refresh(pulse_client_t *client)
+{
+    if (client->trace) {
+        event_trace_record_refresh(client->trace, FALSE);
+    }
+    end_refresh(client);
+}
+
+static void record_write_rtt(pulse_client_t *client, gint64 started_us)
+{
+    gint64 rtt_us = g_get_monotonic_time() - started_us;
+    
+    client->write_count++;
+    client->write_rtt_total_us += rtt_us;
+    if (rtt_us > client->write_rtt_max_us) {
+        client->write_rtt_max_us = rtt_us;
+    }
+}
+
+guint pulse_client_get_write_stats(pulse_client_t *client, gint64 *avg_us, gint64 *max_us)
+{
+    if (!client || client->write_count == 0) {
+        if (avg_us) *avg_us = 0;
+        if (max_us) *max_us = 0;
+        return 0;
+    }
+    
+    if (avg_us) *avg_us = client->write_rtt_total_us / client->write_count;
+    if (max_us) *max_us = client->write_rtt_max_us;
+    return client->write_count;
+}
+
+guint pulse_client_get_event_stats(pulse_client_t *client, gint64 *avg_us, gint64 *max_us)
+{
+    if (!client || client->event_count == 0) {
+        if (avg_us) *avg_us = 0;
+        if (max_us) *max_us = 0;
+        return 0;
+    }
+    
+    if (avg_us) *avg_us = client->event_latency_total_us / client->event_count;
+    if (max_us) *max_us = client->event_latency_max_us;
+    return client->event_count;
+}
+
+guint pulse_client_get_pending_requests(pulse_client_t *client)
+{
+    if (!client || !client->backend_data) {
+        return 0;
+    }
+    
+    return client->backend->pending_requests(client);
+}
+
+// Writes are timed from sending to the reply
+static int64_t write_duration_ns(gint64 started_us)
+{
+    return (g_get_monotonic_time() - started_us) * 1000;
+}
+
+// Completion of a master volume write: flush a value coalesced meanwhile
+void pulse_client_master_write_done(pulse_client_t *client, gboolean success)
+{
+    gboolean resent = FALSE;
+    
+    flight_recorder_add("write-done", FLIGHT_MASTER, success,
+                        write_duration_ns(client->master_write_started_us));
+    client->master_write_in_flight = FALSE;
+    if (success) {
+        record_write_rtt(client, client->master_write_started_us);
+    }
+    if (client->master_cap_enforced_us) {
+        record_cap_latency(client, &client->master_cap_enforced_us, "Master", success);
+    }
+    
+    if (client->master_volume_dirty && client->connected) {
+        resent = send_master_volume(client);
+    }
+    
+    notify_write(client, PULSE_CLIENT_WRITE_VOLUME, NULL, success, resent);
+}
+
+// Completion of a sink input volume write: flush a value coalesced meanwhile
+void pulse_client_app_write_done(pulse_client_t *client, uint32_t index, gboolean success)
+{
+    // The stream may have gone away or the list been refreshed meanwhile
+    app_audio_t *app = find_app(client, index);
+    if (app && app->write_in_flight) {
+        gboolean resent = FALSE;
+        
+        flight_recorder_add("write-done", index, success, write_duration_ns(app->write_started_us));
+        app->write_in_flight = FALSE;
+        if (success) {
+            record_write_rtt(client, app->write_started_us);
+        }
+        if (app->cap_enforced_us) {
+            record_cap_latency(client, &app->cap_enforced_us, app->name, success);
+        }
+        if (app->volume_dirty && client->connected) {
+            resent = send_app_volume(client, app);
+        }
+        
+        notify_write(client, PULSE_CLIENT_WRITE_VOLUME, app, success, resent);
+    } else {
+        // A reply for an index the registry no longer tracks
+        flight_recorder_add("write-done-stale", index, success, 0);
+    }
+}
+
+void pulse_client_master_mute_done(pulse_client_t *client, gboolean success)
+{
+    flight_recorder_add("mute-done", FLIGHT_MASTER, success, 0);
+    notify_write(client, PULSE_CLIENT_WRITE_MUTE, NULL, success, FALSE);
+}
+
+void pulse_client_app_mute_done(pulse_client_t *client, uint32_t index, gboolean success,
+                                gboolean engine)
+{
+    flight_recorder_add("mute-done", index, success, 0);
+    app_audio_t *app = find_app(client, index);
+    if (app && !engine) {
+        notify_write(client, PULSE_CLIENT_WRITE_MUTE, app, success, FALSE);
+    }
+}
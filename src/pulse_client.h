@@ -4,43 +4,169 @@
 #include <pulse/pulseaudio.h>
 #include <glib.h>
 
+// Loudness leveling state of one stream (see pulse_client_set_leveling)
+typedef struct {
+    gboolean monitored;       // The backend is measuring this stream
+    gint64 monitor_us;        // Monotonic time the measurement was last started
+    float db;                 // Smoothed peak level, dBFS
+    gint64 active_us;         // Last sample above the silence gate, 0 if none yet
+    gboolean adjusting;       // Outside the hysteresis band, moving toward target
+    gint64 write_us;          // Last leveling write
+    int volume;               // Percent last written by leveling, -1 if none
+    gint64 hold_until_us;     // Left alone after a change made elsewhere
+} app_level_t;
+
 // Structure to represent an audio application (sink input)
 typedef struct {
     uint32_t index;           // PulseAudio sink input index
     char *name;               // Application name
     char *process_name;       // Process name for icon lookup
+    const char *icon_name;    // Interned application.icon_name, or NULL
+    uint32_t pid;             // application.process.id, 0 if unknown
     pa_cvolume volume;        // Current volume levels
+    pa_channel_map channel_map; // Channel positions matching volume
     gboolean muted;           // Mute state
+    gboolean corked;          // Stream is paused by its application
+    gint64 last_active_us;    // Monotonic time the stream was last seen playing
+    gboolean write_in_flight; // A volume write is awaiting its reply
+    gboolean volume_dirty;    // volume changed again while write was in flight
+    guint seen_serial;        // Refresh serial this entry was last reported in
+    gint64 write_started_us;  // Monotonic time the in-flight write was sent
+    int volume_cap;           // Maximum percent from volmix.conf, -1 for none
+    gboolean schedule_muted;  // Muted for a calendar event, unmuted when it ends
+    gint64 cap_enforced_us;   // When a volume over the cap was reported, 0 if none pending
+    app_level_t level;        // Loudness leveling, while enabled
+    guint64 generation;       // Registry generation of the last change, 0 once removed
+    GList change_link;        // Node in pulse_client_t.changes
 } app_audio_t;
 
-typedef struct {
-    pa_mainloop *mainloop;
-    pa_mainloop_api *mainloop_api;
-    pa_context *context;
-    pa_operation *operation;
+// Registry change notifications delivered from the backend callbacks
+typedef enum {
+    PULSE_CLIENT_APP_ADDED,
+    PULSE_CLIENT_APP_CHANGED,
+    PULSE_CLIENT_APP_REMOVED,     // app is still valid during the callback
+    PULSE_CLIENT_MASTER_CHANGED,  // app is NULL
+    PULSE_CLIENT_CONNECTED,       // app is NULL
+    PULSE_CLIENT_DISCONNECTED     // app is NULL; connect failed or connection lost
+} pulse_client_event_t;
+
+// Kinds of server writes whose completion is reported
+typedef enum {
+    PULSE_CLIENT_WRITE_VOLUME,    // Volume, balance or fade
+    PULSE_CLIENT_WRITE_MUTE
+} pulse_client_write_t;
+
+struct pulse_client;
+struct audio_backend;
+struct event_trace;
+struct volume_caps;
+struct schedule;
+typedef void (*pulse_client_event_cb)(struct pulse_client *client, pulse_client_event_t event,
+                                      app_audio_t *app, gpointer user_data);
+
+// Visitors for pulse_client_changes_since
+typedef void (*pulse_client_app_func)(struct pulse_client *client, app_audio_t *app,
+                                      gpointer user_data);
+typedef void (*pulse_client_removed_func)(struct pulse_client *client, uint32_t index,
+                                          gpointer user_data);
+
+// A write has been answered; app is NULL for the master sink. Volume
+// writes are coalesced, so one completion can stand for several calls;
+// 'resent' tells that a value coalesced meanwhile went out as a new write.
+typedef void (*pulse_client_write_cb)(struct pulse_client *client, pulse_client_write_t kind,
+                                      app_audio_t *app, gboolean success, gboolean resent,
+                                      gpointer user_data);
+
+typedef struct pulse_client {
+    const struct audio_backend *backend;  // Server API in use
+    gpointer backend_data;    // Backend connection state
+    gboolean backend_auto;    // Backend was picked automatically
+    char *server;             // Server to connect to, NULL for the default
+    gboolean connecting;      // Asynchronous connect in progress
     gboolean connected;
     uint32_t default_sink_index;
+    char *default_sink_name;
     pa_cvolume default_sink_volume;
+    pa_channel_map default_sink_channel_map;
     gboolean default_sink_muted;
+    gboolean master_write_in_flight;  // Master volume write awaiting reply
+    gboolean master_volume_dirty;     // Master volume changed during write
+    gint64 master_write_started_us;   // Monotonic time the master write was sent
+    guint write_count;        // Completed volume writes
+    gint64 write_rtt_total_us;  // Summed write round trips
+    gint64 write_rtt_max_us;  // Slowest write round trip
+    guint event_count;        // Stream updates that came from a server event
+    gint64 event_latency_total_us;  // Summed time from event to registry
+    gint64 event_latency_max_us;  // Slowest of those
+    struct volume_caps *caps; // Maximum volumes (volmix.conf), NULL for none
+    int master_cap;           // Cap of the current default sink, -1 for none
+    gint64 master_cap_enforced_us;  // As app_audio_t.cap_enforced_us
+    guint cap_enforcements;   // Over-cap volumes corrected
+    gint64 cap_latency_max_us;  // Slowest report-to-corrected-write time
+    struct schedule *schedule;  // Timed policies (volmix.conf), NULL for none
+    int schedule_master_cap;  // Quiet hours cap in effect, -1 for none
     GList *audio_apps;        // List of app_audio_t
-    gboolean sink_inputs_changed;  // Flag to indicate sink inputs have changed
+    GHashTable *apps_by_index;  // sink input index -> app_audio_t (owned by audio_apps)
+    GHashTable *apps_by_pid;  // process id -> GSList of app_audio_t, in registry order
+    guint refresh_serial;     // Bumped by each full list refresh
+    guint64 generation;       // Bumped by every registry change
+    guint64 master_generation;  // Last change to the master sink or the connection
+    GQueue changes;           // app_audio_t by generation, oldest first
+    GQueue tombstones;        // Removed streams by generation, oldest first
+    guint64 tombstone_floor;  // Removals up to this generation are forgotten
+    pulse_client_event_cb event_cb;
+    gpointer event_cb_data;
+    pulse_client_write_cb write_cb;
+    gpointer write_cb_data;
+    struct event_trace *trace;  // Registry input being recorded ($VOLMIX_TRACE)
+    gboolean leveling;        // Loudness leveling enabled
+    float leveling_target_db; // Level streams are steered toward, dBFS
+    guint leveling_source;    // Control tick while leveling
 } pulse_client_t;
 
-// Initialize PulseAudio client
+// Initialize the client on the default backend: $VOLMIX_BACKEND if set,
+// else native PipeWire when built in and running, else libpulse
 gboolean pulse_client_init(pulse_client_t *client);
 
-// Cleanup PulseAudio client
+// Initialize the client on a named backend ("pulse" or "pipewire")
+gboolean pulse_client_init_backend(pulse_client_t *client, const char *backend_name);
+
+// Initialize the client for a specific server: a PulseAudio server string
+// (as in $PULSE_SERVER) or a PipeWire remote name. NULL backend_name picks
+// as pulse_client_init does, except that a server string implies libpulse
+// unless $VOLMIX_BACKEND says otherwise.
+gboolean pulse_client_init_server(pulse_client_t *client, const char *backend_name,
+                                  const char *server);
+
+// Server this client talks to, NULL for the default one
+const char* pulse_client_get_server(pulse_client_t *client);
+
+// Name of the backend in use
+const char* pulse_client_get_backend_name(pulse_client_t *client);
+
+// Cleanup client and backend
 void pulse_client_cleanup(pulse_client_t *client);
 
-// Connect to PulseAudio server
+// Start connecting to the sound server. The outcome arrives as a
+// PULSE_CLIENT_CONNECTED or PULSE_CLIENT_DISCONNECTED event from the GLib
+// main loop; FALSE means the attempt failed at once. An automatically
+// picked PipeWire backend falls back to libpulse if the native connection
+// fails.
+gboolean pulse_client_connect_async(pulse_client_t *client);
+
+// Connect and wait for the outcome, running the default GLib main context
+// meanwhile
 gboolean pulse_client_connect(pulse_client_t *client);
 
-// Disconnect from PulseAudio server
+// Disconnect from the sound server
 void pulse_client_disconnect(pulse_client_t *client);
 
 // Get current master volume (0-100)
 int pulse_client_get_master_volume(pulse_client_t *client);
 
+// Get current master mute state
+gboolean pulse_client_get_master_muted(pulse_client_t *client);
+
 // Set master volume (0-100)
 gboolean pulse_client_set_master_volume(pulse_client_t *client, int volume);
 
@@ -50,28 +176,121 @@ gboolean pulse_client_increase_master_volume(pulse_client_t *client, int delta);
 // Decrease master volume by percentage
 gboolean pulse_client_decrease_master_volume(pulse_client_t *client, int delta);
 
-// Toggle master mute
+// Set or toggle master mute
+gboolean pulse_client_set_master_mute(pulse_client_t *client, gboolean muted);
 gboolean pulse_client_toggle_master_mute(pulse_client_t *client);
 
-// Process PulseAudio events (call periodically)
-void pulse_client_iterate(pulse_client_t *client);
+// Get/set master balance (-1.0 = left, 0.0 = center, 1.0 = right)
+float pulse_client_get_master_balance(pulse_client_t *client);
+gboolean pulse_client_set_master_balance(pulse_client_t *client, float balance);
+gboolean pulse_client_master_can_balance(pulse_client_t *client);
 
-// Check if sink inputs have changed since last check
-gboolean pulse_client_sink_inputs_changed(pulse_client_t *client);
+// Receive registry changes as they arrive (one listener, NULL to clear)
+void pulse_client_set_event_callback(pulse_client_t *client, pulse_client_event_cb cb,
+                                     gpointer user_data);
+
+// Receive write completions (one listener, NULL to clear)
+void pulse_client_set_write_callback(pulse_client_t *client, pulse_client_write_cb cb,
+                                     gpointer user_data);
 
 // Application management functions
+// The registry is kept current from subscription events; a refresh
+// re-lists all sink inputs asynchronously and updates entries in place.
 void pulse_client_refresh_apps(pulse_client_t *client);
 GList* pulse_client_get_apps(pulse_client_t *client);
+app_audio_t* pulse_client_get_app(pulse_client_t *client, uint32_t sink_input_index);
+
+// Streams of one process, kept current with the registry (owned by the client)
+GSList* pulse_client_get_apps_by_pid(pulse_client_t *client, uint32_t pid);
 gboolean pulse_client_set_app_volume(pulse_client_t *client, uint32_t sink_input_index, int volume);
+gboolean pulse_client_set_app_mute(pulse_client_t *client, uint32_t sink_input_index, gboolean muted);
+// A mute of the engine's own (schedules): its completion doesn't reach the
+// write callback, so it can't be taken for an API caller's mute
+gboolean pulse_client_engine_set_app_mute(pulse_client_t *client, uint32_t sink_input_index,
+                                          gboolean muted);
 gboolean pulse_client_toggle_app_mute(pulse_client_t *client, uint32_t sink_input_index);
 
+// Registry generations. Every change (a stream added, changed or removed,
+// the master sink or the connection) takes the next generation, so any
+// number of consumers can each remember the generation they are current
+// with and catch up on just what changed since, independently of each
+// other and of the event callback. Local writes count as changes too.
+guint64 pulse_client_get_generation(pulse_client_t *client);
+guint64 pulse_client_get_master_generation(pulse_client_t *client);
+
+// Report the streams removed after generation 'since', then those added or
+// changed after it (each once, with its current state, oldest change
+// first). The visitors must not change the registry. FALSE, with nothing
+// reported, if removals that old are forgotten: the consumer then has to
+// compare itself with the whole registry.
+gboolean pulse_client_changes_since(pulse_client_t *client, guint64 since,
+                                    pulse_client_removed_func removed,
+                                    pulse_client_app_func changed, gpointer user_data);
+
+// Loudness leveling: measure each stream's short-term peak level and
+// slowly steer its volume toward target_db (dBFS), a few writes a second
+// at most. Streams that are paused, muted or silent are left alone, and
+// so is a stream for a while after its volume was changed elsewhere.
+// FALSE if the backend can't measure streams.
+gboolean pulse_client_set_leveling(pulse_client_t *client, gboolean enabled, float target_db);
+gboolean pulse_client_get_leveling(pulse_client_t *client, float *target_db);
+
+// Timed policies from the [schedule] group of volmix.conf (see schedule.h):
+// quiet hours capping the master, daily fades, mutes during calendar
+// events. Loaded with the client; reloading re-reads the file and the
+// calendar. Returns the number of rules waiting; next_in_us is the time to
+// the earliest deadline, -1 if none.
+gboolean pulse_client_reload_schedule(pulse_client_t *client);
+guint pulse_client_get_schedule(pulse_client_t *client, gint64 *next_in_us);
+
+// Cap the master (-1 to lift it) on top of the sink's own cap, pulling it
+// down at once if it is above; used by the schedule
+void pulse_client_set_schedule_cap(pulse_client_t *client, int cap);
+
+// Per-channel shape of an application stream, preserved by set_app_volume.
+// Balance is left/right (-1.0 .. 1.0), fade is rear/front (-1.0 .. 1.0).
+gboolean pulse_client_set_app_balance(pulse_client_t *client, uint32_t sink_input_index, float balance);
+gboolean pulse_client_set_app_fade(pulse_client_t *client, uint32_t sink_input_index, float fade);
+
 // Helper functions for app_audio_t
 app_audio_t* app_audio_new(uint32_t index, const char *name, const char *process_name, 
-                          const pa_cvolume *volume, gboolean muted);
+                          const pa_cvolume *volume, const pa_channel_map *channel_map,
+                          gboolean muted);
 void app_audio_free(app_audio_t *app);
+void app_audio_set_icon_name(app_audio_t *app, const char *icon_name);
 int app_audio_get_volume_percent(const app_audio_t *app);
 
-// Volume conversion helper
+// A stream is idle once it has been corked for at least grace_us
+gboolean app_audio_is_idle(const app_audio_t *app, gint64 now_us, gint64 grace_us);
+float app_audio_get_balance(const app_audio_t *app);
+float app_audio_get_fade(const app_audio_t *app);
+gboolean app_audio_can_balance(const app_audio_t *app);
+gboolean app_audio_can_fade(const app_audio_t *app);
+
+// Volumes pulled back under their cap (see caps.h) and the slowest time
+// from the report of an over-cap volume to the corrected write's reply
+guint pulse_client_get_cap_stats(pulse_client_t *client, gint64 *max_us);
+
+// Average and worst volume write round trip so far, in microseconds
+guint pulse_client_get_write_stats(pulse_client_t *client, gint64 *avg_us, gint64 *max_us);
+
+// Average and worst time from a server event about a stream reaching the
+// backend to the registry holding the new state, in microseconds. On
+// PulseAudio that includes the info query the event needs; PipeWire
+// events carry the state themselves.
+guint pulse_client_get_event_stats(pulse_client_t *client, gint64 *avg_us, gint64 *max_us);
+
+// Server requests still awaiting their reply. Together with the stream
+// count this should stay flat over a long session.
+guint pulse_client_get_pending_requests(pulse_client_t *client);
+
+// Volume conversion helpers
 pa_volume_t pulse_client_percent_to_pa_volume(int volume_percent);
+int pulse_client_pa_volume_to_percent(pa_volume_t volume);
+
+// Scale a cvolume so its loudest channel becomes 'target', keeping the
+// ratios between channels (balance/fade). A silent cvolume has no shape
+// left to keep and is set flat instead.
+void pulse_client_cvolume_scale(pa_cvolume *cvolume, pa_volume_t target);
 
 #endif // PULSE_CLIENT_H
\ No newline at end of file
@@ -0,0 +1,317 @@
+#include "scenes.h"
+#include "conf.h"
+#include <glib/gstdio.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#define APP_KEY_PREFIX "app."
+
+// One recall in progress; freed once its last write has been answered
+typedef struct {
+    char *name;
+    guint outstanding;        // Writes awaiting a reply, plus one while issuing
+    guint writes;
+    guint failed;
+    gint64 started_us;
+    scenes_recall_cb cb;
+    gpointer user_data;
+} scene_recall_t;
+
+// What scenes_recall hands to the per-stream pass
+typedef struct {
+    scene_recall_t *recall;
+    GKeyFile *keyfile;
+    const char *name;
+    guint skipped;
+} scene_apply_t;
+
+static char* scenes_path(void)
+{
+    return conf_path("scenes.ini");
+}
+
+// A missing file is an empty set of scenes. 'readable' (may be NULL) is
+// cleared if the file is there but couldn't be read or parsed; writing the
+// empty set back would then lose every scene in it.
+static GKeyFile* load_scenes(gboolean *readable)
+{
+    GKeyFile *keyfile = g_key_file_new();
+    char *path = scenes_path();
+    GError *error = NULL;
+    gboolean ok = TRUE;
+    
+    if (!g_key_file_load_from_file(keyfile, path, G_KEY_FILE_KEEP_COMMENTS, &error)) {
+        if (!g_error_matches(error, G_FILE_ERROR, G_FILE_ERROR_NOENT)) {
+            printf("Failed to read %s: %s\n", path, error->message);
+            ok = FALSE;
+        }
+        g_error_free(error);
+    }
+    
+    if (readable) {
+        *readable = ok;
+    }
+    g_free(path);
+    return keyfile;
+}
+
+static gboolean store_scenes(GKeyFile *keyfile)
+{
+    char *path = scenes_path();
+    char *dir = g_path_get_dirname(path);
+    gsize length;
+    char *data = g_key_file_to_data(keyfile, &length, NULL);
+    GError *error = NULL;
+    gboolean ok = TRUE;
+    
+    if (g_mkdir_with_parents(dir, 0700) < 0 ||
+        !g_file_set_contents(path, data, (gssize)length, &error)) {
+        printf("Failed to write %s: %s\n", path, error ? error->message : g_strerror(errno));
+        g_clear_error(&error);
+        ok = FALSE;
+    }
+    
+    g_free(data);
+    g_free(dir);
+    g_free(path);
+    return ok;
+}
+
+// Group names can't hold brackets or line breaks
+static gboolean valid_scene_name(const char *name)
+{
+    if (!name || !name[0]) {
+        return FALSE;
+    }
+    
+    for (const char *c = name; *c; c++) {
+        if (*c == '[' || *c == ']' || *c == '\n' || *c == '\r') {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+// Key for a stream's application: its process name, else its stream name,
+// reduced to characters a key file key can hold. NULL if it has neither.
+static char* stream_key(const volmix_stream_t *stream)
+{
+    const char *identity = volmix_stream_get_process_name(stream);
+    if (!identity || !identity[0]) {
+        identity = volmix_stream_get_name(stream);
+    }
+    if (!identity || !identity[0]) {
+        return NULL;
+    }
+    
+    return conf_key(APP_KEY_PREFIX, identity);
+}
+
+// "40" or "40,muted"
+static gboolean parse_app_entry(const char *value, int *volume, gboolean *muted)
+{
+    char *end = NULL;
+    gint64 parsed = g_ascii_strtoll(value, &end, 10);
+    
+    if (end == value || parsed < 0 || parsed > 100) {
+        return FALSE;
+    }
+    
+    *volume = (int)parsed;
+    *muted = strcmp(end, ",muted") == 0;
+    return *end == '\0' || *muted;
+}
+
+static void save_stream(volmix_stream_t *stream, void *user_data)
+{
+    scene_apply_t *apply = (scene_apply_t *)user_data;
+    char *key = stream_key(stream);
+    
+    // The first stream of an application speaks for it
+    if (key && !g_key_file_has_key(apply->keyfile, apply->name, key, NULL)) {
+        char *value = g_strdup_printf("%d%s", volmix_stream_get_volume(stream),
+                                      volmix_stream_get_muted(stream) ? ",muted" : "");
+        g_key_file_set_string(apply->keyfile, apply->name, key, value);
+        g_free(value);
+    }
+    
+    g_free(key);
+}
+
+gboolean scenes_save(volmix_t *vm, const char *name)
+{
+    if (!valid_scene_name(name)) {
+        printf("Invalid scene name\n");
+        return FALSE;
+    }
+    
+    gboolean readable;
+    GKeyFile *keyfile = load_scenes(&readable);
+    if (!readable) {
+        printf("Not saving scene '%s' over an unreadable scenes file\n", name);
+        g_key_file_free(keyfile);
+        return FALSE;
+    }
+    
+    scene_apply_t apply = { NULL, keyfile, name, 0 };
+    
+    g_key_file_remove_group(keyfile, name, NULL);
+    g_key_file_set_integer(keyfile, name, "master-volume", volmix_get_master_volume(vm));
+    g_key_file_set_boolean(keyfile, name, "master-muted", volmix_get_master_muted(vm));
+    volmix_foreach_stream(vm, save_stream, &apply);
+    
+    gboolean ok = store_scenes(keyfile);
+    if (ok) {
+        printf("Scene '%s' saved with %u streams\n", name, volmix_get_stream_count(vm));
+    }
+    
+    g_key_file_free(keyfile);
+    return ok;
+}
+
+static void recall_release(scene_recall_t *recall)
+{
+    if (--recall->outstanding > 0) {
+        return;
+    }
+    
+    gint64 latency = g_get_monotonic_time() - recall->started_us;
+    printf("Scene '%s' recalled: %u writes, %u failed, %.2f ms\n",
+           recall->name, recall->writes, recall->failed, latency / 1000.0);
+    
+    if (recall->cb) {
+        recall->cb(recall->name, recall->writes, recall->failed, latency, recall->user_data);
+    }
+    
+    g_free(recall->name);
+    g_free(recall);
+}
+
+static void on_recall_write_done(volmix_t *vm, volmix_status_t status, void *user_data)
+{
+    scene_recall_t *recall = (scene_recall_t *)user_data;
+    
+    if (status != VOLMIX_OK) {
+        recall->failed++;
+    }
+    recall_release(recall);
+}
+
+// Account for a setter just called with on_recall_write_done
+static void recall_issued(scene_recall_t *recall, volmix_status_t status)
+{
+    recall->writes++;
+    if (status == VOLMIX_OK) {
+        recall->outstanding++;
+    } else {
+        // Setters that fail at once never call back
+        recall->failed++;
+    }
+}
+
+static void recall_stream(volmix_stream_t *stream, void *user_data)
+{
+    scene_apply_t *apply = (scene_apply_t *)user_data;
+    scene_recall_t *recall = apply->recall;
+    char *key = stream_key(stream);
+    char *value = key ? g_key_file_get_string(apply->keyfile, apply->name, key, NULL) : NULL;
+    int volume;
+    gboolean muted;
+    
+    if (value && parse_app_entry(value, &volume, &muted)) {
+        gboolean changed = FALSE;
+        
+        if (volmix_stream_get_volume(stream) != volume) {
+            recall_issued(recall, volmix_stream_set_volume(stream, volume,
+                                                           on_recall_write_done, recall));
+            changed = TRUE;
+        }
+        if (!volmix_stream_get_muted(stream) != !muted) {
+            recall_issued(recall, volmix_stream_set_muted(stream, muted,
+                                                          on_recall_write_done, recall));
+            changed = TRUE;
+        }
+        if (!changed) {
+            apply->skipped++;
+        }
+    }
+    
+    g_free(value);
+    g_free(key);
+}
+
+gboolean scenes_recall(volmix_t *vm, const char *name, guint *writes, guint *skipped,
+                       scenes_recall_cb cb, gpointer user_data)
+{
+    GKeyFile *keyfile = load_scenes(NULL);
+    
+    if (!valid_scene_name(name) || !g_key_file_has_group(keyfile, name)) {
+        g_key_file_free(keyfile);
+        return FALSE;
+    }
+    
+    scene_recall_t *recall = g_new0(scene_recall_t, 1);
+    recall->name = g_strdup(name);
+    recall->started_us = g_get_monotonic_time();
+    recall->cb = cb;
+    recall->user_data = user_data;
+    
+    // Held while issuing, so replies to early writes can't finish the recall
+    recall->outstanding = 1;
+    
+    scene_apply_t apply = { recall, keyfile, name, 0 };
+    GError *error = NULL;
+    
+    // The writes are all sent before any reply is read; the server answers
+    // them in order, so the whole batch costs about one round trip
+    int master_volume = g_key_file_get_integer(keyfile, name, "master-volume", &error);
+    if (!error && volmix_get_master_volume(vm) != master_volume) {
+        recall_issued(recall, volmix_set_master_volume(vm, master_volume,
+                                                       on_recall_write_done, recall));
+    }
+    g_clear_error(&error);
+    
+    gboolean master_muted = g_key_file_get_boolean(keyfile, name, "master-muted", &error);
+    if (!error && !volmix_get_master_muted(vm) != !master_muted) {
+        recall_issued(recall, volmix_set_master_muted(vm, master_muted,
+                                                      on_recall_write_done, recall));
+    }
+    g_clear_error(&error);
+    
+    volmix_foreach_stream(vm, recall_stream, &apply);
+    
+    if (writes) {
+        *writes = recall->writes;
+    }
+    if (skipped) {
+        *skipped = apply.skipped;
+    }
+    
+    g_key_file_free(keyfile);
+    recall_release(recall);
+    return TRUE;
+}
+
+gboolean scenes_delete(const char *name)
+{
+    gboolean readable;
+    GKeyFile *keyfile = load_scenes(&readable);
+    gboolean ok = FALSE;
+    
+    if (readable && valid_scene_name(name) && g_key_file_remove_group(keyfile, name, NULL)) {
+        ok = store_scenes(keyfile);
+    }
+    
+    g_key_file_free(keyfile);
+    return ok;
+}
+
+gchar** scenes_list(void)
+{
+    GKeyFile *keyfile = load_scenes(NULL);
+    gchar **names = g_key_file_get_groups(keyfile, NULL);
+    
+    g_key_file_free(keyfile);
+    return names;
+}
@@ -0,0 +1,42 @@
+#ifndef SCENES_H
+#define SCENES_H
+
+#include <glib.h>
+#include "libvolmix.h"
+
+// Named mixer scenes ("meeting", "gaming", ...) kept in
+// $XDG_CONFIG_HOME/volmix/scenes.ini, one group per scene:
+//
+//   [meeting]
+//   master-volume=40
+//   master-muted=false
+//   app.firefox=20
+//   app.spotify=35,muted
+//
+// Applications are matched by identity (process name, else stream name),
+// so a scene applies to every stream of that application whatever its
+// index is today. Streams not named in the scene are left alone.
+
+// Outcome of a recall once every write has been answered
+typedef void (*scenes_recall_cb)(const char *name, guint writes, guint failed,
+                                 gint64 latency_us, gpointer user_data);
+
+// Store the current master and stream state under 'name', replacing a
+// scene of that name. Saving and deleting refuse to touch a scenes file
+// that exists but can't be read or parsed, rather than overwrite it.
+gboolean scenes_save(volmix_t *vm, const char *name);
+
+// Send every write the scene needs at once, without waiting for replies
+// in between; streams and master already in the scene's state are skipped.
+// Returns FALSE if there is no such scene. 'writes' and 'skipped' (may be
+// NULL) tell what was sent; cb (may be NULL) runs when the last reply is in,
+// right away if nothing had to change.
+gboolean scenes_recall(volmix_t *vm, const char *name, guint *writes, guint *skipped,
+                       scenes_recall_cb cb, gpointer user_data);
+
+gboolean scenes_delete(const char *name);
+
+// Saved scene names in file order; free with g_strfreev
+gchar** scenes_list(void);
+
+#endif // SCENES_H
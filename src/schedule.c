@@ -0,0 +1,585 @@
+#include "schedule.h"
+#include "conf.h"
+#include <stdio.h>
+#include <string.h>
+
+#define SCHEDULE_GROUP "schedule"
+#define MINUTES_PER_DAY (24 * 60)
+
+// Monotonic timers don't run during suspend and don't see the wall clock
+// being set, so never sleep longer than this before checking it again
+#define MAX_SLEEP_US ((gint64)3600 * G_USEC_PER_SEC)
+
+// A fade moves one percent per step, but no faster than this
+#define MIN_FADE_STEP_US (G_USEC_PER_SEC / 10)
+
+// How late a fade may still start, however short it is: the timer is
+// rounded up and the main loop may be busy, so a 0 s fade (a plain set at
+// that time) would otherwise always count as missed
+#define FADE_GRACE_US ((gint64)60 * G_USEC_PER_SEC)
+
+typedef enum {
+    RULE_QUIET,
+    RULE_FADE,
+    RULE_EVENT
+} rule_kind_t;
+
+typedef struct {
+    rule_kind_t kind;
+    int start_minute;             // Daily rules: minutes after local midnight
+    int end_minute;               // Quiet window end
+    gint64 start_us;              // Calendar event, wall clock
+    gint64 end_us;
+    int volume;                   // Quiet cap or fade target, percent
+    int duration_s;               // Fade length
+    gboolean active;              // Window open, event on or fade running
+    gint64 due_us;                // Next deadline, wall clock
+    int fade_from;
+    gint64 fade_start_us;
+    int fade_written;             // Percent the fade last wrote, -1 if none
+} schedule_rule_t;
+
+struct schedule {
+    pulse_client_t *client;
+    GSequence *queue;             // schedule_rule_t by due_us; owns the rules
+    guint timer;                  // The only timer, armed for the queue head
+    gchar **mute_apps;            // Muted during calendar events, as conf_key names
+    guint events_active;
+};
+
+static int compare_due(gconstpointer a, gconstpointer b, gpointer user_data)
+{
+    gint64 due_a = ((const schedule_rule_t *)a)->due_us;
+    gint64 due_b = ((const schedule_rule_t *)b)->due_us;
+    
+    return due_a < due_b ? -1 : due_a > due_b;
+}
+
+// Local time of day, in minutes, at wall clock time 'now_us'
+static int minute_of_day(gint64 now_us)
+{
+    GDateTime *now = g_date_time_new_from_unix_local(now_us / G_USEC_PER_SEC);
+    int minute = g_date_time_get_hour(now) * 60 + g_date_time_get_minute(now);
+    
+    g_date_time_unref(now);
+    return minute;
+}
+
+// Next time after 'now_us' the local clock shows 'minute'
+static gint64 next_daily_us(gint64 now_us, int minute)
+{
+    GDateTime *now = g_date_time_new_from_unix_local(now_us / G_USEC_PER_SEC);
+    GDateTime *at = g_date_time_new_local(g_date_time_get_year(now),
+                                          g_date_time_get_month(now),
+                                          g_date_time_get_day_of_month(now),
+                                          minute / 60, minute % 60, 0);
+    gint64 at_us = g_date_time_to_unix(at) * G_USEC_PER_SEC;
+    
+    if (at_us <= now_us) {
+        GDateTime *tomorrow = g_date_time_add_days(at, 1);
+        at_us = g_date_time_to_unix(tomorrow) * G_USEC_PER_SEC;
+        g_date_time_unref(tomorrow);
+    }
+    
+    g_date_time_unref(at);
+    g_date_time_unref(now);
+    return at_us;
+}
+
+static gboolean in_window(const schedule_rule_t *rule, int minute)
+{
+    if (rule->start_minute <= rule->end_minute) {
+        return minute >= rule->start_minute && minute < rule->end_minute;
+    }
+    // Across midnight
+    return minute >= rule->start_minute || minute < rule->end_minute;
+}
+
+// The tightest cap of the open quiet windows. Only runs when a window
+// opens or closes, so the scan costs nothing between deadlines.
+static void update_quiet_cap(schedule_t *schedule)
+{
+    int cap = -1;
+    GSequenceIter *iter = g_sequence_get_begin_iter(schedule->queue);
+    
+    for (; !g_sequence_iter_is_end(iter); iter = g_sequence_iter_next(iter)) {
+        schedule_rule_t *rule = g_sequence_get(iter);
+        if (rule->kind == RULE_QUIET && rule->active && (cap < 0 || rule->volume < cap)) {
+            cap = rule->volume;
+        }
+    }
+    
+    if (cap == schedule->client->schedule_master_cap) {
+        return;
+    }
+    
+    if (cap >= 0) {
+        g_message("Quiet hours: master capped at %d%%", cap);
+    } else {
+        g_message("Quiet hours over");
+    }
+    pulse_client_set_schedule_cap(schedule->client, cap);
+}
+
+static gboolean mute_listed(schedule_t *schedule, const app_audio_t *app)
+{
+    // Named as in scenes and caps: process name, else stream name
+    const char *name = app->process_name && app->process_name[0] ? app->process_name : app->name;
+    if (!schedule->mute_apps || !name || !name[0]) {
+        return FALSE;
+    }
+    
+    char *key = conf_key("", name);
+    gboolean found = FALSE;
+    for (gchar **listed = schedule->mute_apps; *listed && !found; listed++) {
+        found = strcmp(*listed, key) == 0;
+    }
+    g_free(key);
+    return found;
+}
+
+static void mute_for_event(schedule_t *schedule, app_audio_t *app)
+{
+    // Already muted by its user: not ours to unmute later
+    if (!app->muted && mute_listed(schedule, app) &&
+        pulse_client_engine_set_app_mute(schedule->client, app->index, TRUE)) {
+        app->schedule_muted = TRUE;
+    }
+}
+
+static void mute_all_for_event(schedule_t *schedule)
+{
+    for (GList *item = schedule->client->audio_apps; item; item = item->next) {
+        mute_for_event(schedule, (app_audio_t *)item->data);
+    }
+}
+
+// Unmute what the events muted; also used when a reload drops the events
+static void release_event_mutes(pulse_client_t *client)
+{
+    for (GList *item = client->audio_apps; item; item = item->next) {
+        app_audio_t *app = (app_audio_t *)item->data;
+        if (app->schedule_muted) {
+            app->schedule_muted = FALSE;
+            if (app->muted) {
+                pulse_client_engine_set_app_mute(client, app->index, FALSE);
+            }
+        }
+    }
+}
+
+static void fire_quiet(schedule_t *schedule, schedule_rule_t *rule, gint64 now_us)
+{
+    // Read from the clock rather than toggled, so a deadline missed in
+    // suspend can't leave the window inverted
+    rule->active = in_window(rule, minute_of_day(now_us));
+    rule->due_us = next_daily_us(now_us, rule->active ? rule->end_minute : rule->start_minute);
+    update_quiet_cap(schedule);
+}
+
+static void end_fade(schedule_rule_t *rule, gint64 now_us)
+{
+    rule->active = FALSE;
+    rule->due_us = next_daily_us(now_us, rule->start_minute);
+}
+
+static void fire_fade(schedule_t *schedule, schedule_rule_t *rule, gint64 now_us)
+{
+    pulse_client_t *client = schedule->client;
+    int current = pulse_client_get_master_volume(client);
+    gint64 duration_us = (gint64)rule->duration_s * G_USEC_PER_SEC;
+    
+    if (!rule->active) {
+        // Started late (suspended, or not connected) by more than its length: skip the day
+        if (current < 0 || now_us - rule->due_us > MAX(duration_us, FADE_GRACE_US)) {
+            end_fade(rule, now_us);
+            return;
+        }
+        rule->active = TRUE;
+        rule->fade_from = current;
+        rule->fade_start_us = now_us;
+        rule->fade_written = -1;
+        g_message("Fading master from %d%% to %d%% over %d s", current, rule->volume,
+                  rule->duration_s);
+    } else if (current != rule->fade_written) {
+        g_message("Fade cancelled: master volume changed elsewhere");
+        end_fade(rule, now_us);
+        return;
+    }
+    
+    gint64 elapsed_us = MIN(now_us - rule->fade_start_us, duration_us);
+    int span = rule->volume - rule->fade_from;
+    int volume = duration_us > 0 ?
+                 rule->fade_from + (int)(span * elapsed_us / duration_us) : rule->volume;
+    
+    if (volume != current && !pulse_client_set_master_volume(client, volume)) {
+        end_fade(rule, now_us);
+        return;
+    }
+    // A cap may have clamped it; compare with what the master shows
+    rule->fade_written = pulse_client_get_master_volume(client);
+    
+    if (elapsed_us >= duration_us || volume == rule->volume) {
+        end_fade(rule, now_us);
+        return;
+    }
+    rule->due_us = now_us + MAX(duration_us / ABS(span), MIN_FADE_STEP_US);
+}
+
+// FALSE once the event is over and the rule can go
+static gboolean fire_event(schedule_t *schedule, schedule_rule_t *rule, gint64 now_us)
+{
+    if (!rule->active && now_us < rule->end_us) {
+        rule->active = TRUE;
+        rule->due_us = rule->end_us;
+        if (schedule->events_active++ == 0) {
+            g_message("Calendar event started: muting listed applications");
+            mute_all_for_event(schedule);
+        }
+        return TRUE;
+    }
+    
+    if (rule->active && --schedule->events_active == 0) {
+        g_message("Calendar event over: unmuting");
+        release_event_mutes(schedule->client);
+    }
+    return FALSE;
+}
+
+static gboolean on_timer(gpointer user_data);
+
+static void arm(schedule_t *schedule)
+{
+    if (schedule->timer) {
+        g_source_remove(schedule->timer);
+        schedule->timer = 0;
+    }
+    
+    GSequenceIter *head = g_sequence_get_begin_iter(schedule->queue);
+    if (g_sequence_iter_is_end(head)) {
+        return;
+    }
+    
+    schedule_rule_t *rule = g_sequence_get(head);
+    gint64 delay_us = CLAMP(rule->due_us - g_get_real_time(), 0, MAX_SLEEP_US);
+    
+    // Rounded up, so the timer never fires just before the deadline
+    schedule->timer = g_timeout_add((guint)((delay_us + 999) / 1000), on_timer, schedule);
+}
+
+static gboolean on_timer(gpointer user_data)
+{
+    schedule_t *schedule = (schedule_t *)user_data;
+    gint64 now_us = g_get_real_time();
+    
+    schedule->timer = 0;
+    
+    for (;;) {
+        GSequenceIter *head = g_sequence_get_begin_iter(schedule->queue);
+        if (g_sequence_iter_is_end(head)) {
+            break;
+        }
+        
+        schedule_rule_t *rule = g_sequence_get(head);
+        if (rule->due_us > now_us) {
+            break;
+        }
+        
+        gboolean keep = TRUE;
+        switch (rule->kind) {
+            case RULE_QUIET:
+                fire_quiet(schedule, rule, now_us);
+                break;
+            case RULE_FADE:
+                fire_fade(schedule, rule, now_us);
+                break;
+            case RULE_EVENT:
+                keep = fire_event(schedule, rule, now_us);
+                break;
+        }
+        
+        // Every rule moves its deadline past now, so this loop ends
+        if (keep) {
+            g_sequence_sort_changed(head, compare_due, NULL);
+        } else {
+            g_sequence_remove(head);
+        }
+    }
+    
+    arm(schedule);
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean parse_minute(int hour, int minute, int *minute_of_day)
+{
+    if (hour < 0 || hour > 23 || minute < 0 || minute > 59) {
+        return FALSE;
+    }
+    *minute_of_day = hour * 60 + minute;
+    return TRUE;
+}
+
+static void add_rule(schedule_t *schedule, const schedule_rule_t *rule)
+{
+    schedule_rule_t *copy = g_new(schedule_rule_t, 1);
+    
+    *copy = *rule;
+    g_sequence_insert_sorted(schedule->queue, copy, compare_due, NULL);
+}
+
+// "22:00-07:00 40"
+static gboolean add_quiet(schedule_t *schedule, const char *text, gint64 now_us)
+{
+    int start_hour, start_minute, end_hour, end_minute, volume;
+    schedule_rule_t rule = { RULE_QUIET };
+    
+    if (sscanf(text, "%d:%d-%d:%d %d", &start_hour, &start_minute, &end_hour, &end_minute,
+               &volume) != 5 ||
+        !parse_minute(start_hour, start_minute, &rule.start_minute) ||
+        !parse_minute(end_hour, end_minute, &rule.end_minute) ||
+        rule.start_minute == rule.end_minute || volume < 0 || volume > 100) {
+        return FALSE;
+    }
+    
+    rule.volume = volume;
+    rule.active = in_window(&rule, minute_of_day(now_us));
+    rule.due_us = next_daily_us(now_us, rule.active ? rule.end_minute : rule.start_minute);
+    add_rule(schedule, &rule);
+    return TRUE;
+}
+
+// "23:30 20 600"
+static gboolean add_fade(schedule_t *schedule, const char *text, gint64 now_us)
+{
+    int hour, minute, volume, duration_s;
+    schedule_rule_t rule = { RULE_FADE };
+    
+    if (sscanf(text, "%d:%d %d %d", &hour, &minute, &volume, &duration_s) != 4 ||
+        !parse_minute(hour, minute, &rule.start_minute) ||
+        volume < 0 || volume > 100 || duration_s < 0 || duration_s >= MINUTES_PER_DAY * 60) {
+        return FALSE;
+    }
+    
+    rule.volume = volume;
+    rule.duration_s = duration_s;
+    rule.fade_written = -1;
+    rule.due_us = next_daily_us(now_us, rule.start_minute);
+    add_rule(schedule, &rule);
+    return TRUE;
+}
+
+// DTSTART/DTEND values: 20261020T093000Z is UTC; without the Z (or with a
+// TZID parameter, which isn't resolved) it is local time; 20261020 is an
+// all-day date
+static gboolean parse_ics_time(const char *value, gint64 *time_us)
+{
+    int year, month, day, hour = 0, minute = 0, second = 0;
+    char utc = 0;
+    
+    int fields = sscanf(value, "%4d%2d%2dT%2d%2d%2d%c", &year, &month, &day,
+                        &hour, &minute, &second, &utc);
+    if (fields != 3 && fields < 6) {
+        return FALSE;
+    }
+    
+    GTimeZone *zone = utc == 'Z' ? g_time_zone_new_utc() : g_time_zone_new_local();
+    GDateTime *time = g_date_time_new(zone, year, month, day, hour, minute, second);
+    g_time_zone_unref(zone);
+    if (!time) {
+        return FALSE;
+    }
+    
+    *time_us = g_date_time_to_unix(time) * G_USEC_PER_SEC;
+    g_date_time_unref(time);
+    return TRUE;
+}
+
+static guint add_calendar(schedule_t *schedule, const char *path, gint64 now_us)
+{
+    char *contents = NULL;
+    GError *error = NULL;
+    guint count = 0;
+    
+    if (!g_file_get_contents(path, &contents, NULL, &error)) {
+        g_message("Failed to read calendar %s: %s", path, error->message);
+        g_error_free(error);
+        return 0;
+    }
+    
+    gchar **lines = g_strsplit(contents, "\n", -1);
+    gint64 start_us = 0, end_us = 0;
+    gboolean in_event = FALSE;
+    
+    for (gchar **line = lines; *line; line++) {
+        g_strchomp(*line);
+        const char *value = strchr(*line, ':');
+        
+        if (strcmp(*line, "BEGIN:VEVENT") == 0) {
+            in_event = TRUE;
+            start_us = end_us = 0;
+        } else if (!in_event || !value) {
+            continue;
+        } else if (g_str_has_prefix(*line, "DTSTART")) {
+            parse_ics_time(value + 1, &start_us);
+        } else if (g_str_has_prefix(*line, "DTEND")) {
+            parse_ics_time(value + 1, &end_us);
+        } else if (strcmp(*line, "END:VEVENT") == 0) {
+            in_event = FALSE;
+            // Past events are of no interest; ongoing ones start right away
+            if (start_us > 0 && end_us > start_us && end_us > now_us) {
+                schedule_rule_t rule = { RULE_EVENT };
+                rule.start_us = start_us;
+                rule.end_us = end_us;
+                rule.due_us = start_us;
+                add_rule(schedule, &rule);
+                count++;
+            }
+        }
+    }
+    
+    g_strfreev(lines);
+    g_free(contents);
+    return count;
+}
+
+static char* expand_home(const char *path)
+{
+    if (g_str_has_prefix(path, "~/")) {
+        return g_build_filename(g_get_home_dir(), path + 2, NULL);
+    }
+    return g_strdup(path);
+}
+
+// Each entry of a ';' separated list through 'add'; bad ones are reported
+static void add_list(schedule_t *schedule, GKeyFile *keyfile, const char *key, const char *path,
+                     gboolean (*add)(schedule_t *, const char *, gint64), gint64 now_us)
+{
+    gchar **entries = g_key_file_get_string_list(keyfile, SCHEDULE_GROUP, key, NULL, NULL);
+    
+    for (gchar **entry = entries; entry && *entry; entry++) {
+        if (!add(schedule, g_strstrip(*entry), now_us)) {
+            g_message("%s: ignoring %s entry \"%s\"", path, key, *entry);
+        }
+    }
+    g_strfreev(entries);
+}
+
+schedule_t* schedule_load(pulse_client_t *client)
+{
+    GKeyFile *keyfile = g_key_file_new();
+    char *path = conf_path("volmix.conf");
+    gint64 now_us = g_get_real_time();
+    
+    if (!g_key_file_load_from_file(keyfile, path, G_KEY_FILE_NONE, NULL) ||
+        !g_key_file_has_group(keyfile, SCHEDULE_GROUP)) {
+        g_key_file_free(keyfile);
+        g_free(path);
+        return NULL;
+    }
+    
+    schedule_t *schedule = g_new0(schedule_t, 1);
+    schedule->client = client;
+    schedule->queue = g_sequence_new(g_free);
+    schedule->mute_apps = g_key_file_get_string_list(keyfile, SCHEDULE_GROUP, "calendar-mute",
+                                                     NULL, NULL);
+    for (gchar **name = schedule->mute_apps; name && *name; name++) {
+        char *key = conf_key("", g_strstrip(*name));
+        g_free(*name);
+        *name = key;
+    }
+    
+    add_list(schedule, keyfile, "quiet", path, add_quiet, now_us);
+    add_list(schedule, keyfile, "fade", path, add_fade, now_us);
+    
+    char *calendar = g_key_file_get_string(keyfile, SCHEDULE_GROUP, "calendar", NULL);
+    if (calendar) {
+        char *calendar_path = expand_home(calendar);
+        g_message("%u upcoming events in %s", add_calendar(schedule, calendar_path, now_us),
+                  calendar_path);
+        g_free(calendar_path);
+        g_free(calendar);
+    }
+    
+    g_key_file_free(keyfile);
+    
+    if (g_sequence_get_length(schedule->queue) == 0) {
+        g_message("%s: [schedule] has no usable rules", path);
+        g_free(path);
+        schedule_free(schedule);
+        return NULL;
+    }
+    
+    g_message("Loaded %d schedule rules from %s", g_sequence_get_length(schedule->queue), path);
+    g_free(path);
+    
+    // Windows open and events on right now take effect at once
+    update_quiet_cap(schedule);
+    on_timer(schedule);
+    return schedule;
+}
+
+void schedule_free(schedule_t *schedule)
+{
+    if (!schedule) {
+        return;
+    }
+    
+    if (schedule->timer) {
+        g_source_remove(schedule->timer);
+    }
+    g_sequence_free(schedule->queue);
+    g_strfreev(schedule->mute_apps);
+    g_free(schedule);
+}
+
+void schedule_app_added(schedule_t *schedule, app_audio_t *app)
+{
+    if (schedule && schedule->events_active > 0) {
+        mute_for_event(schedule, app);
+    }
+}
+
+void schedule_connected(schedule_t *schedule)
+{
+    // Streams listed while connecting couldn't be muted yet
+    if (schedule && schedule->events_active > 0) {
+        mute_all_for_event(schedule);
+    }
+}
+
+gboolean pulse_client_reload_schedule(pulse_client_t *client)
+{
+    if (!client) {
+        return FALSE;
+    }
+    
+    schedule_free(client->schedule);
+    client->schedule = schedule_load(client);
+    
+    // Policies that are gone end now
+    if (!client->schedule) {
+        pulse_client_set_schedule_cap(client, -1);
+    }
+    if (!client->schedule || client->schedule->events_active == 0) {
+        release_event_mutes(client);
+    }
+    return client->schedule != NULL;
+}
+
+guint pulse_client_get_schedule(pulse_client_t *client, gint64 *next_in_us)
+{
+    schedule_t *schedule = client ? client->schedule : NULL;
+    
+    if (next_in_us) {
+        *next_in_us = -1;
+    }
+    if (!schedule) {
+        return 0;
+    }
+    
+    GSequenceIter *head = g_sequence_get_begin_iter(schedule->queue);
+    if (next_in_us && !g_sequence_iter_is_end(head)) {
+        *next_in_us = MAX(((schedule_rule_t *)g_sequence_get(head))->due_us - g_get_real_time(), 0);
+    }
+    return (guint)g_sequence_get_length(schedule->queue);
+}
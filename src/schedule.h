@@ -0,0 +1,37 @@
+#ifndef SCHEDULE_H
+#define SCHEDULE_H
+
+#include "pulse_client.h"
+
+// Time-based volume policies from the [schedule] group of
+// $XDG_CONFIG_HOME/volmix/volmix.conf:
+//
+//   [schedule]
+//   quiet=22:00-07:00 40;13:00-14:00 60
+//   fade=23:30 20 600
+//   calendar=~/.local/share/volmix/meetings.ics
+//   calendar-mute=zoom;teams
+//
+// quiet: daily windows during which the master is capped at a percent, on
+// top of any sink cap (see caps.h).
+// fade: daily, from the given time, take the master from wherever it is to
+// a percent over so many seconds; moving the volume meanwhile cancels it.
+// calendar: during each event in the file (DTSTART/DTEND; recurrence rules
+// are not expanded) the calendar-mute applications, named as in scenes,
+// are muted, and unmuted once the last overlapping event ends.
+//
+// All rules wait in one queue ordered by their next deadline (a window
+// opening or closing, an event starting or ending, a fade step) under a
+// single timer armed for the earliest, so hundreds of rules cost nothing
+// between deadlines.
+typedef struct schedule schedule_t;
+
+// Read the rules and apply those already in effect; NULL when there are none
+schedule_t* schedule_load(pulse_client_t *client);
+void schedule_free(schedule_t *schedule);
+
+// Registry hooks; schedule may be NULL
+void schedule_app_added(schedule_t *schedule, app_audio_t *app);
+void schedule_connected(schedule_t *schedule);
+
+#endif // SCHEDULE_H
@@ -0,0 +1,707 @@
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <string.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+#include "libvolmix.h"
+#include "event_trace.h"
+#include "proc_stats.h"
+
+// Soak test (make check). A synthetic trace of server events - streams
+// appearing, changing and going away, full refreshes, master changes and
+// a vanishing default sink - is replayed through libvolmix on the replay
+// backend round after round, each round a connect and a disconnect. The
+// event callback answers with clicks (mute toggles, master steps) and
+// drags (bursts of volume and balance writes), and a consumer catches up
+// through volmix_changes_since as the mixer does.
+//
+// After every round nothing may be left over: no streams, no setter
+// callback still owed, no backend request outstanding. Once the warm-up
+// rounds are done the heap and RSS are sampled each round, and the test
+// fails if either has grown past its bound by the end.
+//
+// The replay backend has no requests of its own to lose, so with
+// --server (or $VOLMIX_SOAK_SERVER; "default" for the default server) the
+// rounds run against a live server instead: a new handle per round, so
+// connect and teardown are soaked too, and pairs of writes to the master
+// and the streams there, each pair leaving things as they were. That
+// soaks the backend's request accounting and its in-flight writes. Use a
+// server of its own (a null sink is enough): the volumes do move.
+
+#define DEFAULT_EVENTS 2000000
+#define ROUND_RECORDS 10000       // Server events per round
+#define WARMUP_ROUNDS 5           // Caches and the allocator settle meanwhile
+#define DEFAULT_MAX_HEAP_GROWTH_KIB 256
+#define DEFAULT_MAX_RSS_GROWTH_KIB 4096
+#define LIVE_STREAMS 24           // Streams alive at once, about
+#define DRAG_STEPS 8
+#define CONSUMER_INTERVAL 1000    // Events between changes_since catch-ups
+#define SOAK_SEED 0x766d78
+#define LIVE_DEFAULT_EVENTS 200000
+#define LIVE_ROUND_PAIRS 500      // Write pairs per live round
+#define LIVE_MAX_OUTSTANDING 16   // Setters in flight before the driver waits
+#define LIVE_SETTLE_US ((gint64)5 * G_USEC_PER_SEC)  // For the last replies of a round
+
+// A bounded set of applications: names are interned by the engine for
+// good, so unbounded names would read as a leak
+static const char *app_names[][2] = {
+    { "Firefox", "firefox" },
+    { "Spotify", "spotify" },
+    { "mpv", "mpv" },
+    { "Zoom", "zoom" },
+    { "Chromium", "chromium" },
+    { "Steam", "steam" },
+    { "Discord", "discord" },
+    { "VLC media player", "vlc" },
+};
+
+// One stream as the generated trace reports it
+typedef struct {
+    uint32_t index;
+    guint app;
+    int volume;
+    gboolean muted;
+    gboolean corked;
+} soak_stream_t;
+
+typedef struct {
+    GMainLoop *loop;
+    volmix_t *vm;
+    GRand *rand;
+    guint rounds;             // Rounds to run
+    guint round;
+    guint64 events;           // Registry events seen
+    guint64 clicks;
+    guint64 drags;
+    guint64 issued;           // Setters accepted...
+    guint64 completed;        // ...and their callbacks so far
+    guint64 generation;       // Consumer position for changes_since
+    guint64 caught_up;        // Streams reported to the consumer
+    gboolean acting;          // Our own writes raise events; ignore those
+    gboolean live;            // Against a server rather than the trace
+    const char *backend;      // Live: backend and server, NULL for defaults
+    const char *server;
+    guint pairs;              // Live: write pairs sent this round
+    guint drive_source;
+    gint64 settle_start_us;   // Live: all pairs sent, waiting for replies since
+    long heap_base_kib;
+    long rss_base_kib;
+    long heap_max_growth_kib;
+    long rss_max_growth_kib;
+    gboolean failed;
+} soak_t;
+
+// Bytes handed out by malloc and not yet freed, -1 where glibc can't say
+static long heap_in_use_kib(void)
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    struct mallinfo2 info = mallinfo2();
+    return (long)((info.uordblks + info.hblkhd) / 1024);
+#else
+    return -1;
+#endif
+}
+
+static void stereo_volume(int percent, pa_cvolume *volume, pa_channel_map *channel_map)
+{
+    pa_cvolume_set(volume, 2, (pa_volume_t)((guint64)PA_VOLUME_NORM * percent / 100));
+    pa_channel_map_init_stereo(channel_map);
+}
+
+static void record_stream(event_trace_t *trace, const soak_stream_t *stream)
+{
+    audio_stream_info_t info = {
+        .index = stream->index,
+        .name = app_names[stream->app][0],
+        .process_name = app_names[stream->app][1],
+        .icon_name = app_names[stream->app][1],
+        .pid = 1000 + stream->app,
+        .muted = stream->muted,
+        .corked = stream->corked,
+    };
+    
+    stereo_volume(stream->volume, &info.volume, &info.channel_map);
+    event_trace_record_stream(trace, &info);
+}
+
+static void record_master(event_trace_t *trace, GRand *rand)
+{
+    pa_cvolume volume;
+    pa_channel_map channel_map;
+    
+    stereo_volume(g_rand_int_range(rand, 0, 101), &volume, &channel_map);
+    event_trace_record_master(trace, 0, "soak.sink", &volume, &channel_map,
+                              g_rand_int_range(rand, 0, 10) == 0);
+}
+
+static void add_stream(GArray *live, uint32_t *next_index, GRand *rand)
+{
+    soak_stream_t stream = {
+        .index = (*next_index)++,
+        .app = (guint)g_rand_int_range(rand, 0, G_N_ELEMENTS(app_names)),
+        .volume = g_rand_int_range(rand, 0, 101),
+        .corked = g_rand_boolean(rand),
+    };
+    g_array_append_val(live, stream);
+}
+
+// One round: connect, an initial listing, then a mix of server events
+// weighted toward stream changes, then the connection going down
+static gboolean write_trace(const char *path, guint *records)
+{
+    event_trace_t *trace = event_trace_open(path);
+    if (!trace) {
+        return FALSE;
+    }
+    
+    GRand *rand = g_rand_new_with_seed(SOAK_SEED);
+    GArray *live = g_array_new(FALSE, FALSE, sizeof(soak_stream_t));
+    uint32_t next_index = 1;
+    guint count = 0;
+    
+    event_trace_record_connection(trace, TRUE);
+    record_master(trace, rand);
+    event_trace_record_refresh(trace, TRUE);
+    while (live->len < LIVE_STREAMS) {
+        add_stream(live, &next_index, rand);
+        record_stream(trace, &g_array_index(live, soak_stream_t, live->len - 1));
+    }
+    event_trace_record_refresh(trace, FALSE);
+    count += 3 + LIVE_STREAMS;
+    
+    while (count < ROUND_RECORDS) {
+        int what = g_rand_int_range(rand, 0, 100);
+        guint pick = live->len ? (guint)g_rand_int_range(rand, 0, (gint32)live->len) : 0;
+        
+        if (what < 60 && live->len > 0) {
+            soak_stream_t *stream = &g_array_index(live, soak_stream_t, pick);
+            switch (g_rand_int_range(rand, 0, 3)) {
+                case 0:
+                    stream->volume = g_rand_int_range(rand, 0, 101);
+                    break;
+                case 1:
+                    stream->muted = !stream->muted;
+                    break;
+                default:
+                    stream->corked = !stream->corked;
+                    break;
+            }
+            record_stream(trace, stream);
+            count++;
+        } else if (what < 72 && live->len < 2 * LIVE_STREAMS) {
+            add_stream(live, &next_index, rand);
+            record_stream(trace, &g_array_index(live, soak_stream_t, live->len - 1));
+            count++;
+        } else if (what < 84 && live->len > 0) {
+            event_trace_record_remove(trace, g_array_index(live, soak_stream_t, pick).index);
+            g_array_remove_index_fast(live, pick);
+            count++;
+        } else if (what < 94) {
+            record_master(trace, rand);
+            count++;
+        } else if (what < 97) {
+            // A full listing that misses one stream: the refresh drops it
+            if (live->len > 0) {
+                g_array_remove_index_fast(live, pick);
+            }
+            event_trace_record_refresh(trace, TRUE);
+            for (guint i = 0; i < live->len; i++) {
+                record_stream(trace, &g_array_index(live, soak_stream_t, i));
+            }
+            event_trace_record_refresh(trace, FALSE);
+            count += 2 + live->len;
+        } else {
+            // The default sink goes away and comes back
+            pa_cvolume volume;
+            pa_channel_map channel_map;
+            pa_cvolume_init(&volume);
+            pa_channel_map_init(&channel_map);
+            event_trace_record_master(trace, PA_INVALID_INDEX, NULL, &volume, &channel_map, FALSE);
+            record_master(trace, rand);
+            count += 2;
+        }
+    }
+    
+    event_trace_record_connection(trace, FALSE);
+    count++;
+    
+    event_trace_close(trace);
+    g_array_free(live, TRUE);
+    g_rand_free(rand);
+    *records = count;
+    return TRUE;
+}
+
+static void fail(soak_t *soak, const char *message)
+{
+    fprintf(stderr, "FAIL round %u: %s\n", soak->round, message);
+    soak->failed = TRUE;
+}
+
+static void on_result(volmix_t *vm, volmix_status_t status, void *user_data)
+{
+    soak_t *soak = (soak_t *)user_data;
+    
+    soak->completed++;
+    if (soak->completed > soak->issued) {
+        fail(soak, "setter callback ran twice");
+    }
+}
+
+static void count_setter(soak_t *soak, volmix_status_t status)
+{
+    if (status == VOLMIX_OK) {
+        soak->issued++;
+    }
+}
+
+// A slider dragged across: writes faster than the replies come back
+static void drag_stream(soak_t *soak, volmix_stream_t *stream)
+{
+    int volume = volmix_stream_get_volume(stream);
+    int step = g_rand_boolean(soak->rand) ? 3 : -3;
+    
+    for (int i = 0; i < DRAG_STEPS; i++) {
+        volume = CLAMP(volume + step, 0, 100);
+        count_setter(soak, volmix_stream_set_volume(stream, volume, on_result, soak));
+    }
+    if (volmix_stream_can_balance(stream)) {
+        float balance = (float)g_rand_double_range(soak->rand, -1.0, 1.0);
+        count_setter(soak, volmix_stream_set_balance(stream, balance, on_result, soak));
+    }
+    soak->drags++;
+}
+
+static void act_on_stream(soak_t *soak, volmix_stream_t *stream)
+{
+    int what = g_rand_int_range(soak->rand, 0, 100);
+    
+    if (what < 5) {
+        drag_stream(soak, stream);
+    } else if (what < 8) {
+        count_setter(soak, volmix_stream_set_muted(stream, !volmix_stream_get_muted(stream),
+                                                   on_result, soak));
+        soak->clicks++;
+    }
+}
+
+static void act_on_master(soak_t *soak)
+{
+    int what = g_rand_int_range(soak->rand, 0, 100);
+    
+    if (what < 5) {
+        int delta = g_rand_boolean(soak->rand) ? 5 : -5;
+        count_setter(soak, volmix_step_master_volume(soak->vm, delta, on_result, soak));
+        soak->clicks++;
+    } else if (what < 7) {
+        count_setter(soak, volmix_set_master_muted(soak->vm, !volmix_get_master_muted(soak->vm),
+                                                   on_result, soak));
+        soak->clicks++;
+    }
+}
+
+static void on_consumer_removed(uint32_t index, void *user_data)
+{
+    ((soak_t *)user_data)->caught_up++;
+}
+
+static void on_consumer_changed(volmix_stream_t *stream, void *user_data)
+{
+    ((soak_t *)user_data)->caught_up++;
+}
+
+static gboolean end_round(gpointer user_data);
+static void live_event(soak_t *soak, volmix_event_t event);
+
+static void on_event(volmix_t *vm, volmix_event_t event, volmix_stream_t *stream,
+                     void *user_data)
+{
+    soak_t *soak = (soak_t *)user_data;
+    
+    if (soak->acting) {
+        return;
+    }
+    
+    soak->events++;
+    if (soak->live) {
+        live_event(soak, event);
+        return;
+    }
+    
+    soak->acting = TRUE;
+    switch (event) {
+        case VOLMIX_EVENT_STREAM_CHANGED:
+            act_on_stream(soak, stream);
+            break;
+        case VOLMIX_EVENT_MASTER_CHANGED:
+            act_on_master(soak);
+            break;
+        case VOLMIX_EVENT_DISCONNECTED:
+            // Replies still queued complete first, at default idle priority
+            g_idle_add_full(G_PRIORITY_LOW, end_round, soak, NULL);
+            break;
+        default:
+            break;
+    }
+    soak->acting = FALSE;
+    
+    if (soak->events % CONSUMER_INTERVAL == 0) {
+        uint64_t generation = volmix_get_generation(vm);
+        volmix_changes_since(vm, soak->generation, on_consumer_removed,
+                             on_consumer_changed, soak);
+        soak->generation = generation;
+    }
+}
+
+static void check_growth(soak_t *soak, const char *what, long base_kib, long now_kib,
+                         long max_kib)
+{
+    if (base_kib < 0 || now_kib < 0) {
+        fprintf(stderr, "%s: not measurable here\n", what);
+        return;
+    }
+    
+    fprintf(stderr, "%s: %ld KiB after warm-up, %ld KiB at the end (%+ld KiB, limit %ld)\n",
+            what, base_kib, now_kib, now_kib - base_kib, max_kib);
+    if (now_kib - base_kib > max_kib) {
+        char *message = g_strdup_printf("%s grew by %ld KiB", what, now_kib - base_kib);
+        fail(soak, message);
+        g_free(message);
+    }
+}
+
+// Sample the heap and RSS after a round; FALSE once the run is over
+static gboolean round_done(soak_t *soak)
+{
+    soak->round++;
+    long heap_kib = heap_in_use_kib();
+    long rss_kib = proc_stats_get_rss_kib();
+    if (soak->round == WARMUP_ROUNDS) {
+        soak->heap_base_kib = heap_kib;
+        soak->rss_base_kib = rss_kib;
+    }
+    if (soak->round % 20 == 0 || soak->round == soak->rounds) {
+        fprintf(stderr, "round %u/%u: %llu events, %llu clicks, %llu drags, "
+                "heap %ld KiB, RSS %ld KiB\n", soak->round, soak->rounds,
+                (unsigned long long)soak->events, (unsigned long long)soak->clicks,
+                (unsigned long long)soak->drags, heap_kib, rss_kib);
+    }
+    
+    if (soak->failed || soak->round == soak->rounds) {
+        if (soak->round >= WARMUP_ROUNDS) {
+            check_growth(soak, "heap", soak->heap_base_kib, heap_kib, soak->heap_max_growth_kib);
+            check_growth(soak, "RSS", soak->rss_base_kib, rss_kib, soak->rss_max_growth_kib);
+        }
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static gboolean end_round(gpointer user_data)
+{
+    soak_t *soak = (soak_t *)user_data;
+    
+    if (volmix_get_stream_count(soak->vm) != 0) {
+        fail(soak, "streams left after the disconnect");
+    }
+    if (soak->completed != soak->issued) {
+        fail(soak, "setter callbacks still owed after the disconnect");
+    }
+    if (volmix_get_pending_requests(soak->vm) != 0) {
+        fail(soak, "backend requests outstanding after the disconnect");
+    }
+    
+    if (!round_done(soak)) {
+        g_main_loop_quit(soak->loop);
+        return G_SOURCE_REMOVE;
+    }
+    
+    if (volmix_connect_async(soak->vm) != VOLMIX_OK) {
+        fail(soak, "reconnect failed");
+        g_main_loop_quit(soak->loop);
+    }
+    return G_SOURCE_REMOVE;
+}
+
+// Replay the trace round after round until 'events' have gone by
+static void run(soak_t *soak, gint64 events, const char *trace_path, guint records)
+{
+    soak->rounds = (guint)MAX((events + records - 1) / records, WARMUP_ROUNDS + 1);
+    soak->vm = volmix_new_for_server("replay", trace_path);
+    if (!soak->vm) {
+        fail(soak, "the replay backend did not start");
+        return;
+    }
+    
+    soak->rand = g_rand_new_with_seed(SOAK_SEED);
+    soak->loop = g_main_loop_new(NULL, FALSE);
+    volmix_set_event_callback(soak->vm, on_event, soak);
+    
+    fprintf(stderr, "Soaking: %u rounds of %u server events\n", soak->rounds, records);
+    gint64 start_us = g_get_monotonic_time();
+    if (volmix_connect_async(soak->vm) != VOLMIX_OK) {
+        fail(soak, "connect failed");
+    } else {
+        g_main_loop_run(soak->loop);
+    }
+    
+    fprintf(stderr, "%llu events, %llu setters, %llu consumer updates in %.1f s\n",
+            (unsigned long long)soak->events, (unsigned long long)soak->issued,
+            (unsigned long long)soak->caught_up,
+            (g_get_monotonic_time() - start_us) / (double)G_USEC_PER_SEC);
+    
+    volmix_free(soak->vm);
+    g_main_loop_unref(soak->loop);
+    g_rand_free(soak->rand);
+}
+
+static void pick_nth(volmix_stream_t *stream, void *user_data)
+{
+    gpointer *pick = (gpointer *)user_data;
+    
+    if (GPOINTER_TO_UINT(pick[1]) == 0) {
+        pick[0] = stream;
+    }
+    pick[1] = GUINT_TO_POINTER(GPOINTER_TO_UINT(pick[1]) - 1);
+}
+
+// Two writes, the second undoing the first
+static void live_pair(soak_t *soak)
+{
+    volmix_t *vm = soak->vm;
+    guint count = volmix_get_stream_count(vm);
+    volmix_stream_t *stream = NULL;
+    
+    if (count > 0 && g_rand_boolean(soak->rand)) {
+        gpointer pick[2] = { NULL, GUINT_TO_POINTER(g_rand_int_range(soak->rand, 0, (gint32)count)) };
+        volmix_foreach_stream(vm, pick_nth, pick);
+        stream = pick[0];
+    }
+    
+    if (stream && g_rand_boolean(soak->rand)) {
+        int volume = volmix_stream_get_volume(stream);
+        count_setter(soak, volmix_stream_set_volume(stream, volume < 50 ? volume + 1 : volume - 1,
+                                                    on_result, soak));
+        count_setter(soak, volmix_stream_set_volume(stream, volume, on_result, soak));
+        soak->drags++;
+    } else if (stream) {
+        int muted = volmix_stream_get_muted(stream);
+        count_setter(soak, volmix_stream_set_muted(stream, !muted, on_result, soak));
+        count_setter(soak, volmix_stream_set_muted(stream, muted, on_result, soak));
+        soak->clicks++;
+    } else if (volmix_get_master_volume(vm) >= 0 && g_rand_boolean(soak->rand)) {
+        int volume = volmix_get_master_volume(vm);
+        count_setter(soak, volmix_set_master_volume(vm, volume < 50 ? volume + 1 : volume - 1,
+                                                    on_result, soak));
+        count_setter(soak, volmix_set_master_volume(vm, volume, on_result, soak));
+        soak->drags++;
+    } else if (volmix_get_master_volume(vm) >= 0) {
+        int muted = volmix_get_master_muted(vm);
+        count_setter(soak, volmix_set_master_muted(vm, !muted, on_result, soak));
+        count_setter(soak, volmix_set_master_muted(vm, muted, on_result, soak));
+        soak->clicks++;
+    }
+}
+
+static void live_start_round(soak_t *soak);
+
+// Send the round's pairs a few at a time, then wait for every reply and
+// request; the handle goes once nothing is left
+static gboolean live_drive(gpointer user_data)
+{
+    soak_t *soak = (soak_t *)user_data;
+    
+    while (soak->pairs < LIVE_ROUND_PAIRS &&
+           soak->issued - soak->completed < LIVE_MAX_OUTSTANDING) {
+        live_pair(soak);
+        soak->pairs++;
+    }
+    if (soak->pairs < LIVE_ROUND_PAIRS) {
+        return G_SOURCE_CONTINUE;
+    }
+    
+    gint64 now_us = g_get_monotonic_time();
+    if (!soak->settle_start_us) {
+        soak->settle_start_us = now_us;
+    }
+    gboolean settled = soak->completed == soak->issued &&
+                       volmix_get_pending_requests(soak->vm) == 0;
+    if (!settled && now_us - soak->settle_start_us < LIVE_SETTLE_US) {
+        return G_SOURCE_CONTINUE;
+    }
+    
+    if (soak->completed != soak->issued) {
+        fail(soak, "setter callbacks still owed at the end of the round");
+    }
+    if (volmix_get_pending_requests(soak->vm) != 0) {
+        fail(soak, "backend requests outstanding at the end of the round");
+    }
+    
+    soak->drive_source = 0;
+    volmix_free(soak->vm);
+    soak->vm = NULL;
+    if (round_done(soak)) {
+        live_start_round(soak);
+    } else {
+        g_main_loop_quit(soak->loop);
+    }
+    return G_SOURCE_REMOVE;
+}
+
+static void live_event(soak_t *soak, volmix_event_t event)
+{
+    if (event == VOLMIX_EVENT_CONNECTED && !soak->drive_source) {
+        soak->drive_source = g_timeout_add(1, live_drive, soak);
+    } else if (event == VOLMIX_EVENT_DISCONNECTED) {
+        fail(soak, "the server connection went down");
+        if (soak->drive_source) {
+            g_source_remove(soak->drive_source);
+            soak->drive_source = 0;
+        }
+        g_main_loop_quit(soak->loop);
+    }
+}
+
+static void live_start_round(soak_t *soak)
+{
+    soak->pairs = 0;
+    soak->settle_start_us = 0;
+    soak->vm = volmix_new_for_server(soak->backend, soak->server);
+    if (!soak->vm) {
+        fail(soak, "the backend did not start");
+        g_main_loop_quit(soak->loop);
+        return;
+    }
+    
+    volmix_set_event_callback(soak->vm, on_event, soak);
+    if (volmix_connect_async(soak->vm) != VOLMIX_OK) {
+        fail(soak, "connect failed");
+        g_main_loop_quit(soak->loop);
+    }
+}
+
+// Rounds against the server until 'events' have gone by, about two per pair
+static void run_live(soak_t *soak, gint64 events)
+{
+    soak->live = TRUE;
+    soak->rounds = (guint)MAX(events / (2 * LIVE_ROUND_PAIRS), WARMUP_ROUNDS + 1);
+    soak->rand = g_rand_new_with_seed(SOAK_SEED);
+    soak->loop = g_main_loop_new(NULL, FALSE);
+    
+    fprintf(stderr, "Soaking against %s: %u rounds of %u write pairs\n",
+            soak->server ? soak->server : "the default server", soak->rounds, LIVE_ROUND_PAIRS);
+    gint64 start_us = g_get_monotonic_time();
+    live_start_round(soak);
+    if (!soak->failed) {
+        g_main_loop_run(soak->loop);
+    }
+    
+    fprintf(stderr, "%llu events, %llu setters in %.1f s\n",
+            (unsigned long long)soak->events, (unsigned long long)soak->issued,
+            (g_get_monotonic_time() - start_us) / (double)G_USEC_PER_SEC);
+    
+    volmix_free(soak->vm);
+    g_main_loop_unref(soak->loop);
+    g_rand_free(soak->rand);
+}
+
+static void discard_log(const gchar *domain, GLogLevelFlags level, const gchar *message,
+                        gpointer user_data)
+{
+}
+
+int main(int argc, char **argv)
+{
+    soak_t soak;
+    gint64 events = 0;
+    char *backend = NULL;
+    char *server = NULL;
+    gint max_heap = DEFAULT_MAX_HEAP_GROWTH_KIB;
+    gint max_rss = DEFAULT_MAX_RSS_GROWTH_KIB;
+    GError *error = NULL;
+    
+    GOptionEntry entries[] = {
+        { "events", 'n', 0, G_OPTION_ARG_INT64, &events,
+          "Server events to go through (default 2000000, live 200000)", "N" },
+        { "server", 's', 0, G_OPTION_ARG_STRING, &server,
+          "Soak against this live server, \"default\" for the default one "
+          "(default $VOLMIX_SOAK_SERVER, else the replayed trace)", "SERVER" },
+        { "backend", 'b', 0, G_OPTION_ARG_STRING, &backend,
+          "Backend for the live server", "NAME" },
+        { "max-heap-growth", 0, 0, G_OPTION_ARG_INT, &max_heap,
+          "Heap growth allowed after warm-up, KiB (default 256)", "KIB" },
+        { "max-rss-growth", 0, 0, G_OPTION_ARG_INT, &max_rss,
+          "RSS growth allowed after warm-up, KiB (default 4096)", "KIB" },
+        { NULL }
+    };
+    GOptionContext *context = g_option_context_new(NULL);
+    g_option_context_add_main_entries(context, entries, NULL);
+    gboolean parsed = g_option_context_parse(context, &argc, &argv, &error);
+    g_option_context_free(context);
+    if (!parsed) {
+        fprintf(stderr, "%s\n", error->message);
+        g_error_free(error);
+        return 2;
+    }
+    if (!server && g_getenv("VOLMIX_SOAK_SERVER") && *g_getenv("VOLMIX_SOAK_SERVER")) {
+        server = g_strdup(g_getenv("VOLMIX_SOAK_SERVER"));
+    }
+    if (events <= 0) {
+        events = server ? LIVE_DEFAULT_EVENTS : DEFAULT_EVENTS;
+    }
+    
+    // Nothing from the user's configuration. On the trace, caps on one
+    // application and the sink keep the enforcement paths in the loop; a
+    // live server gets none, so its real streams are never clamped.
+    char *dir = g_dir_make_tmp("volmix-soak-XXXXXX", &error);
+    if (!dir) {
+        fprintf(stderr, "%s\n", error->message);
+        g_error_free(error);
+        return 2;
+    }
+    char *config_dir = g_build_filename(dir, "volmix", NULL);
+    char *config_path = g_build_filename(config_dir, "volmix.conf", NULL);
+    char *trace_path = g_build_filename(dir, "soak.vmt", NULL);
+    g_setenv("XDG_CONFIG_HOME", dir, TRUE);
+    g_unsetenv("VOLMIX_TRACE");
+    g_unsetenv("VOLMIX_REPLAY_SPEED");
+    g_mkdir_with_parents(config_dir, 0700);
+    if (!server) {
+        g_file_set_contents(config_path, "[caps]\napp.spotify=50\nsink.soak.sink=90\n", -1, NULL);
+    }
+    
+    // A round's worth of connects and stream logging, times thousands of
+    // rounds, would be the whole test log; only this report goes out
+    g_log_set_handler("libvolmix", G_LOG_LEVEL_MESSAGE | G_LOG_LEVEL_INFO | G_LOG_LEVEL_DEBUG,
+                      discard_log, NULL);
+    
+    memset(&soak, 0, sizeof(soak));
+    soak.heap_max_growth_kib = max_heap;
+    soak.rss_max_growth_kib = max_rss;
+    guint records = 0;
+    if (server) {
+        soak.backend = backend;
+        soak.server = g_strcmp0(server, "default") == 0 ? NULL : server;
+        run_live(&soak, events);
+    } else if (!write_trace(trace_path, &records)) {
+        fail(&soak, "could not write the trace");
+    } else {
+        run(&soak, events, trace_path, records);
+    }
+    
+    g_unlink(trace_path);
+    g_unlink(config_path);
+    g_rmdir(config_dir);
+    g_rmdir(dir);
+    g_free(trace_path);
+    g_free(config_path);
+    g_free(config_dir);
+    g_free(dir);
+    g_free(backend);
+    g_free(server);
+    
+    fprintf(stderr, soak.failed ? "FAIL\n" : "PASS\n");
+    return soak.failed ? 1 : 0;
+}
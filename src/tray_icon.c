@@ -0,0 +1,237 @@
+#include "tray_icon.h"
+#include <stdio.h>
+#include <string.h>
+
+#define DEFAULT_ICON_SIZE 22
+
+// The artwork is decoded once at this size; variants are scaled down from it
+#define BASE_DECODE_SIZE 128
+
+// Fallback theme icons when the PNG can't be loaded
+static const char *level_icon_names[TRAY_LEVEL_COUNT] = {
+    "audio-volume-muted",
+    "audio-volume-muted",
+    "audio-volume-low",
+    "audio-volume-medium",
+    "audio-volume-high"
+};
+
+static tray_level_t level_for_volume(int volume_percent, gboolean muted)
+{
+    if (muted) {
+        return TRAY_LEVEL_MUTED;
+    }
+    if (volume_percent <= 0) {
+        return TRAY_LEVEL_ZERO;
+    }
+    if (volume_percent < 34) {
+        return TRAY_LEVEL_LOW;
+    }
+    if (volume_percent < 67) {
+        return TRAY_LEVEL_MEDIUM;
+    }
+    return TRAY_LEVEL_HIGH;
+}
+
+static GdkPixbuf* load_base_artwork(void)
+{
+    // Load the inverted sound icon PNG (white speaker)
+    // Try development location first, then installed location
+    gchar *dev_icon_path = g_build_filename("data", "icons", "sound-icon-inverted.png", NULL);
+    gchar *installed_icon_path = g_build_filename(DATADIR, "volmix", "icons", "sound-icon-inverted.png", NULL);
+    GError *error = NULL;
+    GdkPixbuf *icon_pixbuf = NULL;
+    
+    // Check development location first
+    if (g_file_test(dev_icon_path, G_FILE_TEST_EXISTS | G_FILE_TEST_IS_REGULAR)) {
+        icon_pixbuf = gdk_pixbuf_new_from_file_at_size(dev_icon_path, BASE_DECODE_SIZE,
+                                                       BASE_DECODE_SIZE, &error);
+    }
+    // Check installed location if development location failed
+    else if (g_file_test(installed_icon_path, G_FILE_TEST_EXISTS | G_FILE_TEST_IS_REGULAR)) {
+        icon_pixbuf = gdk_pixbuf_new_from_file_at_size(installed_icon_path, BASE_DECODE_SIZE,
+                                                       BASE_DECODE_SIZE, &error);
+    }
+    
+    g_free(dev_icon_path);
+    g_free(installed_icon_path);
+    
+    if (icon_pixbuf) {
+        g_print("Loaded inverted sound icon PNG\n");
+    } else {
+        // Fallback to system icons if file not found
+        g_warning("Could not load sound icon (%s), using system icons",
+                  error ? error->message : "file not found");
+    }
+    
+    if (error) g_error_free(error);
+    return icon_pixbuf;
+}
+
+// Render one variant: the speaker with as many waves as the level has,
+// and a cross instead of waves when muted. The waves in the artwork are
+// arcs around its center, so they are revealed by a circular clip.
+static GdkPixbuf* render_variant(GdkPixbuf *base, gint size, tray_level_t level)
+{
+    double width = gdk_pixbuf_get_width(base);
+    double height = gdk_pixbuf_get_height(base);
+    double scale = size / MAX(width, height);
+    
+    cairo_surface_t *surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, size, size);
+    cairo_t *cr = cairo_create(surface);
+    
+    // Center the artwork in the square icon, then work in artwork pixels
+    cairo_translate(cr, (size - width * scale) / 2.0, (size - height * scale) / 2.0);
+    cairo_scale(cr, scale, scale);
+    
+    if (level != TRAY_LEVEL_HIGH) {
+        // Speaker body is the left ~58%; waves are reached by the radius
+        double wave_radius = 0.0;
+        if (level == TRAY_LEVEL_LOW) {
+            wave_radius = 0.25 * width;
+        } else if (level == TRAY_LEVEL_MEDIUM) {
+            wave_radius = 0.38 * width;
+        }
+        
+        cairo_rectangle(cr, 0, 0, 0.58 * width, height);
+        if (wave_radius > 0.0) {
+            cairo_new_sub_path(cr);
+            cairo_arc(cr, 0.5 * width, 0.5 * height, wave_radius, 0, 2 * G_PI);
+        }
+        cairo_clip(cr);
+    }
+    
+    gdk_cairo_set_source_pixbuf(cr, base, 0, 0);
+    cairo_paint(cr);
+    
+    if (level == TRAY_LEVEL_MUTED) {
+        cairo_reset_clip(cr);
+        cairo_set_source_rgb(cr, 0.9, 0.2, 0.2);
+        cairo_set_line_width(cr, 0.09 * height);
+        cairo_set_line_cap(cr, CAIRO_LINE_CAP_ROUND);
+        cairo_move_to(cr, 0.66 * width, 0.30 * height);
+        cairo_line_to(cr, 0.94 * width, 0.70 * height);
+        cairo_move_to(cr, 0.94 * width, 0.30 * height);
+        cairo_line_to(cr, 0.66 * width, 0.70 * height);
+        cairo_stroke(cr);
+    }
+    
+    cairo_destroy(cr);
+    
+    GdkPixbuf *pixbuf = gdk_pixbuf_get_from_surface(surface, 0, 0, size, size);
+    cairo_surface_destroy(surface);
+    return pixbuf;
+}
+
+static void clear_variants(tray_icon_t *tray)
+{
+    for (int i = 0; i < TRAY_LEVEL_COUNT; i++) {
+        g_clear_object(&tray->variants[i]);
+    }
+}
+
+static void render_variants(tray_icon_t *tray, gint size)
+{
+    clear_variants(tray);
+    tray->size = size;
+    
+    if (!tray->base) {
+        return;
+    }
+    
+    for (int i = 0; i < TRAY_LEVEL_COUNT; i++) {
+        tray->variants[i] = render_variant(tray->base, size, (tray_level_t)i);
+    }
+}
+
+static void apply_level(tray_icon_t *tray, tray_level_t level)
+{
+    if (tray->variants[level]) {
+        gtk_status_icon_set_from_pixbuf(tray->status_icon, tray->variants[level]);
+    } else {
+        gtk_status_icon_set_from_icon_name(tray->status_icon, level_icon_names[level]);
+    }
+    tray->shown_level = level;
+}
+
+// The panel changed the icon size (or scale); re-render the cache once
+static gboolean on_size_changed(GtkStatusIcon *status_icon, gint size, gpointer user_data)
+{
+    tray_icon_t *tray = (tray_icon_t *)user_data;
+    
+    if (size <= 0 || size == tray->size) {
+        return FALSE;
+    }
+    
+    printf("Tray icon size changed to %d, re-rendering icons\n", size);
+    render_variants(tray, size);
+    if (tray->shown_level >= 0) {
+        apply_level(tray, (tray_level_t)tray->shown_level);
+    }
+    
+    return TRUE;
+}
+
+void tray_icon_init(tray_icon_t *tray)
+{
+    memset(tray, 0, sizeof(tray_icon_t));
+    tray->shown_level = -1;
+    tray->shown_percent = -1;
+    
+    tray->status_icon = gtk_status_icon_new();
+    tray->base = load_base_artwork();
+    render_variants(tray, DEFAULT_ICON_SIZE);
+    
+    apply_level(tray, TRAY_LEVEL_HIGH);
+    gtk_status_icon_set_tooltip_text(tray->status_icon,
+                                    "volmix - Per-Application Audio Control");
+    
+    g_signal_connect(tray->status_icon, "size-changed",
+                    G_CALLBACK(on_size_changed), tray);
+    
+    gtk_status_icon_set_visible(tray->status_icon, TRUE);
+}
+
+void tray_icon_update(tray_icon_t *tray, int volume_percent, gboolean muted)
+{
+    if (!tray->status_icon) {
+        return;
+    }
+    
+    // No server: shown like a muted master rather than the last volume seen
+    gboolean connected = volume_percent >= 0;
+    if (!connected) {
+        volume_percent = -1;
+        muted = TRUE;
+    }
+    
+    tray_level_t level = level_for_volume(volume_percent, muted);
+    if ((int)level != tray->shown_level) {
+        apply_level(tray, level);
+    }
+    
+    if (volume_percent != tray->shown_percent || muted != tray->shown_muted) {
+        char tooltip[64];
+        if (connected) {
+            snprintf(tooltip, sizeof(tooltip), "volmix - Master volume: %d%%%s",
+                     volume_percent, muted ? " (muted)" : "");
+        } else {
+            snprintf(tooltip, sizeof(tooltip), "volmix - Not connected");
+        }
+        gtk_status_icon_set_tooltip_text(tray->status_icon, tooltip);
+        tray->shown_percent = volume_percent;
+        tray->shown_muted = muted;
+    }
+}
+
+void tray_icon_cleanup(tray_icon_t *tray)
+{
+    if (tray->status_icon) {
+        gtk_status_icon_set_visible(tray->status_icon, FALSE);
+        g_object_unref(tray->status_icon);
+        tray->status_icon = NULL;
+    }
+    
+    clear_variants(tray);
+    g_clear_object(&tray->base);
+}
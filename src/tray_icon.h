@@ -0,0 +1,38 @@
+#ifndef TRAY_ICON_H
+#define TRAY_ICON_H
+
+#include <gtk/gtk.h>
+
+// Volume buckets with their own icon variant
+typedef enum {
+    TRAY_LEVEL_MUTED,
+    TRAY_LEVEL_ZERO,
+    TRAY_LEVEL_LOW,
+    TRAY_LEVEL_MEDIUM,
+    TRAY_LEVEL_HIGH,
+    TRAY_LEVEL_COUNT
+} tray_level_t;
+
+// Tray icon reflecting master volume and mute. The speaker PNG is decoded
+// once and every variant is pre-rendered for the current icon size, so
+// volume changes only swap cached pixbufs.
+typedef struct {
+    GtkStatusIcon *status_icon;
+    GdkPixbuf *base;                          // Decoded speaker artwork
+    GdkPixbuf *variants[TRAY_LEVEL_COUNT];    // Rendered at 'size'
+    gint size;
+    int shown_level;                          // -1 until first update
+    int shown_percent;
+    gboolean shown_muted;
+} tray_icon_t;
+
+// Create the status icon and render the variant cache
+void tray_icon_init(tray_icon_t *tray);
+
+// Reflect the given master state; cheap when nothing visible changes.
+// A negative volume means there is no server to show.
+void tray_icon_update(tray_icon_t *tray, int volume_percent, gboolean muted);
+
+void tray_icon_cleanup(tray_icon_t *tray);
+
+#endif // TRAY_ICON_H
@@ -0,0 +1,240 @@
+#include "tray_menu.h"
+#include "active_window.h"
+#include <stdio.h>
+#include <string.h>
+
+// Fixed positions at the top of the menu; application items follow
+#define FIRST_APP_POSITION 3      // After "Mute", a separator and "No applications"
+
+typedef struct {
+    tray_menu_t *menu;
+    uint32_t index;
+    GtkWidget *item;
+    gulong handler;
+} tray_menu_item_t;
+
+// Update a check item without feeding the state back to the server
+static void set_active_silently(GtkWidget *item, gulong handler, gboolean active)
+{
+    if (gtk_check_menu_item_get_active(GTK_CHECK_MENU_ITEM(item)) == active) {
+        return;
+    }
+    
+    g_signal_handler_block(item, handler);
+    gtk_check_menu_item_set_active(GTK_CHECK_MENU_ITEM(item), active);
+    g_signal_handler_unblock(item, handler);
+}
+
+static void sync_item(tray_menu_item_t *entry, const volmix_stream_t *stream)
+{
+    const char *name = volmix_stream_get_name(stream);
+    
+    if (g_strcmp0(gtk_menu_item_get_label(GTK_MENU_ITEM(entry->item)), name) != 0) {
+        gtk_menu_item_set_label(GTK_MENU_ITEM(entry->item), name);
+    }
+    set_active_silently(entry->item, entry->handler, volmix_stream_get_muted(stream) != 0);
+}
+
+static void sync_master(tray_menu_t *menu)
+{
+    set_active_silently(menu->master_item, menu->master_handler,
+                        volmix_get_master_muted(menu->vm) != 0);
+    gtk_widget_set_sensitive(menu->master_item, volmix_is_connected(menu->vm));
+}
+
+static void sync_all(tray_menu_t *menu)
+{
+    GHashTableIter iter;
+    gpointer value;
+    
+    g_hash_table_iter_init(&iter, menu->items);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        tray_menu_item_t *entry = (tray_menu_item_t *)value;
+        volmix_stream_t *stream = volmix_find_stream(menu->vm, entry->index);
+        if (stream) {
+            sync_item(entry, stream);
+        }
+    }
+    sync_master(menu);
+}
+
+// A rejected write leaves the items showing what was asked for; the server
+// sends no change event to correct them
+static void on_mute_done(volmix_t *vm, volmix_status_t status, void *user_data)
+{
+    tray_menu_t *menu = (tray_menu_t *)user_data;
+    
+    if (status != VOLMIX_OK && status != VOLMIX_ERROR_CANCELLED && menu->menu) {
+        sync_all(menu);
+    }
+}
+
+static void on_master_toggled(GtkCheckMenuItem *item, gpointer user_data)
+{
+    tray_menu_t *menu = (tray_menu_t *)user_data;
+    
+    volmix_set_master_muted(menu->vm, gtk_check_menu_item_get_active(item),
+                            on_mute_done, menu);
+}
+
+static void on_app_toggled(GtkCheckMenuItem *item, gpointer user_data)
+{
+    tray_menu_item_t *entry = (tray_menu_item_t *)user_data;
+    volmix_stream_t *stream = volmix_find_stream(entry->menu->vm, entry->index);
+    
+    if (stream) {
+        volmix_stream_set_muted(stream, gtk_check_menu_item_get_active(item),
+                                on_mute_done, entry->menu);
+    }
+}
+
+static void add_item(tray_menu_t *menu, volmix_stream_t *stream)
+{
+    uint32_t index = volmix_stream_get_index(stream);
+    if (g_hash_table_contains(menu->items, GUINT_TO_POINTER(index))) {
+        return;
+    }
+    
+    tray_menu_item_t *entry = g_new0(tray_menu_item_t, 1);
+    entry->menu = menu;
+    entry->index = index;
+    entry->item = gtk_check_menu_item_new_with_label(volmix_stream_get_name(stream));
+    gtk_check_menu_item_set_active(GTK_CHECK_MENU_ITEM(entry->item),
+                                   volmix_stream_get_muted(stream) != 0);
+    entry->handler = g_signal_connect(entry->item, "toggled", G_CALLBACK(on_app_toggled), entry);
+    
+    gtk_menu_shell_insert(GTK_MENU_SHELL(menu->menu), entry->item,
+                          FIRST_APP_POSITION + menu->app_count);
+    gtk_widget_show(entry->item);
+    
+    g_hash_table_insert(menu->items, GUINT_TO_POINTER(index), entry);
+    menu->app_count++;
+    gtk_widget_set_visible(menu->no_apps_item, FALSE);
+}
+
+static void remove_item(tray_menu_t *menu, uint32_t index)
+{
+    tray_menu_item_t *entry = g_hash_table_lookup(menu->items, GUINT_TO_POINTER(index));
+    if (!entry) {
+        return;
+    }
+    
+    gtk_widget_destroy(entry->item);
+    g_hash_table_remove(menu->items, GUINT_TO_POINTER(index));
+    menu->app_count--;
+    gtk_widget_set_visible(menu->no_apps_item, menu->app_count == 0);
+}
+
+typedef struct {
+    guint32 pid;
+    tray_menu_t *menu;
+    guint changed;
+} mute_others_t;
+
+static void mute_unless_focused(volmix_stream_t *stream, void *user_data)
+{
+    mute_others_t *request = (mute_others_t *)user_data;
+    gboolean mute = volmix_stream_get_pid(stream) != request->pid;
+    
+    if (!volmix_stream_get_muted(stream) != !mute &&
+        volmix_stream_set_muted(stream, mute, on_mute_done, request->menu) == VOLMIX_OK) {
+        request->changed++;
+    }
+}
+
+// The popup doesn't take the focus, so the active window is still the one
+// the user came from. Its streams are unmuted, every other one muted.
+static void on_mute_others_activate(GtkMenuItem *item, gpointer user_data)
+{
+    tray_menu_t *menu = (tray_menu_t *)user_data;
+    mute_others_t request = { active_window_get_pid(), menu, 0 };
+    
+    if (request.pid == 0) {
+        printf("No focused window with a known process\n");
+        return;
+    }
+    
+    volmix_foreach_stream(menu->vm, mute_unless_focused, &request);
+    printf("Muted all but process %u: %u streams changed\n", request.pid, request.changed);
+}
+
+static void add_stream_item(volmix_stream_t *stream, void *user_data)
+{
+    add_item((tray_menu_t *)user_data, stream);
+}
+
+void tray_menu_init(tray_menu_t *menu, volmix_t *vm)
+{
+    memset(menu, 0, sizeof(tray_menu_t));
+    menu->vm = vm;
+    menu->items = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+    menu->menu = gtk_menu_new();
+    
+    menu->master_item = gtk_check_menu_item_new_with_label("Mute");
+    menu->master_handler = g_signal_connect(menu->master_item, "toggled",
+                                            G_CALLBACK(on_master_toggled), menu);
+    gtk_menu_shell_append(GTK_MENU_SHELL(menu->menu), menu->master_item);
+    gtk_menu_shell_append(GTK_MENU_SHELL(menu->menu), gtk_separator_menu_item_new());
+    
+    menu->no_apps_item = gtk_menu_item_new_with_label("No applications");
+    gtk_widget_set_sensitive(menu->no_apps_item, FALSE);
+    gtk_menu_shell_append(GTK_MENU_SHELL(menu->menu), menu->no_apps_item);
+    
+    GtkWidget *mute_others_item = gtk_menu_item_new_with_label("Mute All Except Focused");
+    g_signal_connect(mute_others_item, "activate", G_CALLBACK(on_mute_others_activate), menu);
+    gtk_menu_shell_append(GTK_MENU_SHELL(menu->menu), gtk_separator_menu_item_new());
+    gtk_menu_shell_append(GTK_MENU_SHELL(menu->menu), mute_others_item);
+    gtk_menu_shell_append(GTK_MENU_SHELL(menu->menu), gtk_separator_menu_item_new());
+    
+    gtk_widget_show_all(menu->menu);
+    
+    volmix_foreach_stream(vm, add_stream_item, menu);
+    gtk_widget_set_visible(menu->no_apps_item, menu->app_count == 0);
+    sync_master(menu);
+}
+
+void tray_menu_handle_event(tray_menu_t *menu, volmix_event_t event, volmix_stream_t *stream)
+{
+    if (!menu->menu) {
+        return;
+    }
+    
+    switch (event) {
+        case VOLMIX_EVENT_STREAM_ADDED:
+            add_item(menu, stream);
+            break;
+        case VOLMIX_EVENT_STREAM_CHANGED: {
+            uint32_t index = volmix_stream_get_index(stream);
+            tray_menu_item_t *entry = g_hash_table_lookup(menu->items, GUINT_TO_POINTER(index));
+            if (entry) {
+                sync_item(entry, stream);
+            }
+            break;
+        }
+        case VOLMIX_EVENT_STREAM_REMOVED:
+            remove_item(menu, volmix_stream_get_index(stream));
+            break;
+        case VOLMIX_EVENT_MASTER_CHANGED:
+        case VOLMIX_EVENT_CONNECTED:
+        case VOLMIX_EVENT_DISCONNECTED:
+            sync_master(menu);
+            break;
+    }
+}
+
+void tray_menu_popup(tray_menu_t *menu)
+{
+    gtk_menu_popup_at_pointer(GTK_MENU(menu->menu), NULL);
+}
+
+void tray_menu_destroy(tray_menu_t *menu)
+{
+    if (!menu->menu) {
+        return;
+    }
+    
+    gtk_widget_destroy(menu->menu);
+    menu->menu = NULL;
+    g_hash_table_destroy(menu->items);
+    menu->items = NULL;
+}
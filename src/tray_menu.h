@@ -0,0 +1,33 @@
+#ifndef TRAY_MENU_H
+#define TRAY_MENU_H
+
+#include <gtk/gtk.h>
+#include "libvolmix.h"
+
+// Tray icon context menu, built once and kept current from registry
+// events: a mute check item for the master and one per application, then
+// "Mute All Except Focused". The caller appends its own items (scenes,
+// quit) to 'menu'. Popping it up allocates nothing and asks the server
+// nothing; an event only touches the item it is about.
+typedef struct {
+    volmix_t *vm;
+    GtkWidget *menu;
+    GtkWidget *master_item;
+    gulong master_handler;
+    GtkWidget *no_apps_item;      // Shown while there are no streams
+    GHashTable *items;            // stream index -> tray_menu_item_t
+    guint app_count;              // Application items, in registry order
+} tray_menu_t;
+
+// Build the menu from the current registry of 'vm'
+void tray_menu_init(tray_menu_t *menu, volmix_t *vm);
+
+// Registry event hook; ignored until the menu is built
+void tray_menu_handle_event(tray_menu_t *menu, volmix_event_t event, volmix_stream_t *stream);
+
+void tray_menu_popup(tray_menu_t *menu);
+
+// Destroy the menu, including items appended by the caller
+void tray_menu_destroy(tray_menu_t *menu);
+
+#endif // TRAY_MENU_H
@@ -1,508 +1,532 @@
 #include <gtk/gtk.h>
 #include <glib.h>
+#include <glib-unix.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <signal.h>
 #include <string.h>
-#include "pulse_client.h"
-
-// Constants for PulseAudio operation timeouts and delays
-#define MAX_REFRESH_TIMEOUT 50     // Maximum iterations to wait for refresh (0.25s)
-#define DELAY_5_MS_USEC 5000       // 5ms delay in microseconds
+#include <unistd.h>
+#include "libvolmix.h"
+#include "mixer_window.h"
+#include "tray_icon.h"
+#include "tray_menu.h"
+#include "proc_stats.h"
+#include "scenes.h"
+#include "active_window.h"
+#include "control.h"
+#include "instance.h"
 
 typedef struct {
-    GtkWidget *tray_icon;
-    GtkWidget *popup_menu;
-    GtkWidget *volmix_window;
-    pulse_client_t pulse_client;
+    tray_icon_t tray;
+    uint64_t tray_generation; // Master generation the tray icon shows
+    tray_menu_t menu;         // Context menu, kept current from events
+    GtkWidget *scenes_menu;   // Submenu of the context menu, rebuilt when scenes change
+    mixer_window_t mixer;
+    volmix_t *vm;             // Primary server: tray icon and scroll
+    GPtrArray *extra_vms;     // Further servers, shown in the mixer only
+    gint64 start_us;
 } volmix_app_t;
 
-// Structure for asynchronous PulseAudio processing
-typedef struct {
-    volmix_app_t *app;
-    int count;
-} AsyncIterateData;
-
 static volmix_app_t app_data;
 
-// Forward declaration
-static void update_slider_indexes(volmix_app_t *app);
-static void update_sliders_recursive(GList *widgets, GList *apps);
-
-// Asynchronous callback for PulseAudio processing
-static gboolean async_iterate_callback(gpointer user_data)
+// Reflect the current master volume/mute in the tray icon and tooltip
+// Only once the master changed since the icon was last updated
+static void update_tray_icon(volmix_app_t *app)
 {
-    AsyncIterateData *data = (AsyncIterateData *)user_data;
-    pulse_client_iterate(&data->app->pulse_client);
-    data->count++;
+    uint64_t generation = volmix_get_master_generation(app->vm);
     
-    if (data->count < 5) {
-        // Schedule next iteration after 10ms
-        return G_SOURCE_CONTINUE;
-    } else {
-        g_free(data);
-        return G_SOURCE_REMOVE;
+    if (generation == app->tray_generation) {
+        return;
     }
+    app->tray_generation = generation;
+    tray_icon_update(&app->tray,
+                     volmix_get_master_volume(app->vm),
+                     volmix_get_master_muted(app->vm));
 }
 
-static void on_app_volume_changed(GtkRange *range, gpointer user_data)
+static void on_tray_icon_activate(GtkStatusIcon *status_icon, gpointer user_data)
 {
-    uint32_t *sink_input_index = (uint32_t *)user_data;
-    double value = gtk_range_get_value(range);
-    int volume = (int)value;
+    volmix_app_t *app = (volmix_app_t *)user_data;
     
-    printf("Setting volume for sink input %u to %d%%\n", *sink_input_index, volume);
+    // The window is pre-built and kept current, so this is only show/hide
+    mixer_window_toggle(&app->mixer);
+}
+
+static void on_tray_icon_popup_menu(GtkStatusIcon *status_icon, guint button, 
+                                   guint activate_time, gpointer user_data)
+{
+    volmix_app_t *app = (volmix_app_t *)user_data;
     
-    // Update the application volume
-    if (pulse_client_set_app_volume(&app_data.pulse_client, *sink_input_index, volume)) {
-        printf("Successfully set volume for app %u to %d%%\n", *sink_input_index, volume);
-    } else {
-        printf("Failed to set volume for app %u\n", *sink_input_index);
+    // Built once in setup_tray_icon and reused for every click
+    tray_menu_popup(&app->menu);
+}
+
+static void on_scene_activate(GtkMenuItem *item, gpointer user_data)
+{
+    volmix_app_t *app = (volmix_app_t *)user_data;
+    const char *name = gtk_menu_item_get_label(item);
+    
+    // Completion and latency are logged by the scene module
+    if (!scenes_recall(app->vm, name, NULL, NULL, NULL, NULL)) {
+        printf("Scene '%s' not found\n", name);
     }
 }
 
+static void rebuild_scenes_menu(volmix_app_t *app);
 
-static void build_volume_window(volmix_app_t *app)
+static void on_save_scene_activate(GtkMenuItem *item, gpointer user_data)
 {
-    // Destroy existing window if it exists
-    // TODO: Optimization opportunity - update existing window content instead of destroying/rebuilding
-    if (app->volmix_window) {
-        gtk_widget_destroy(app->volmix_window);
-        app->volmix_window = NULL;
+    volmix_app_t *app = (volmix_app_t *)user_data;
+    GtkWidget *dialog = gtk_dialog_new_with_buttons("Save Scene", NULL, GTK_DIALOG_MODAL,
+                                                    "_Cancel", GTK_RESPONSE_CANCEL,
+                                                    "_Save", GTK_RESPONSE_ACCEPT, NULL);
+    GtkWidget *entry = gtk_entry_new();
+    
+    gtk_entry_set_placeholder_text(GTK_ENTRY(entry), "Scene name");
+    gtk_entry_set_activates_default(GTK_ENTRY(entry), TRUE);
+    gtk_dialog_set_default_response(GTK_DIALOG(dialog), GTK_RESPONSE_ACCEPT);
+    gtk_container_set_border_width(GTK_CONTAINER(dialog), 4);
+    gtk_box_pack_start(GTK_BOX(gtk_dialog_get_content_area(GTK_DIALOG(dialog))),
+                       entry, FALSE, FALSE, 0);
+    gtk_widget_show_all(dialog);
+    
+    if (gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_ACCEPT) {
+        char *name = g_strstrip(g_strdup(gtk_entry_get_text(GTK_ENTRY(entry))));
+        if (scenes_save(app->vm, name)) {
+            rebuild_scenes_menu(app);
+        }
+        g_free(name);
     }
     
-    // Refresh the list of audio applications
-    pulse_client_refresh_apps(&app->pulse_client);
-    
-    // Process pending PulseAudio operations with minimal blocking
-    if (app->pulse_client.operation) {
-        // Wait for the refresh operation to complete (this is necessary for UI)
-        int timeout_count = 0;
-        
-        while (pa_operation_get_state(app->pulse_client.operation) == PA_OPERATION_RUNNING && 
-               timeout_count < MAX_REFRESH_TIMEOUT) {
-            pulse_client_iterate(&app->pulse_client);
-            g_usleep(DELAY_5_MS_USEC); // 5ms delay
-            timeout_count++;
-        }
-        
-        pa_operation_unref(app->pulse_client.operation);
-        app->pulse_client.operation = NULL;
+    gtk_widget_destroy(dialog);
+}
+
+// One item per saved scene, then "Save Scene..."
+static void rebuild_scenes_menu(volmix_app_t *app)
+{
+    GList *children = gtk_container_get_children(GTK_CONTAINER(app->scenes_menu));
+    for (GList *l = children; l; l = l->next) {
+        gtk_widget_destroy(GTK_WIDGET(l->data));
     }
+    g_list_free(children);
     
-    // Schedule additional processing time asynchronously for ongoing events
-    AsyncIterateData *iterate_data = g_new0(AsyncIterateData, 1);
-    iterate_data->app = app;
-    iterate_data->count = 0;
-    g_timeout_add(10, async_iterate_callback, iterate_data);
-    
-    // Get list of audio applications
-    GList *apps = pulse_client_get_apps(&app->pulse_client);
-    printf("Found %d applications when building window\n", g_list_length(apps));
-    
-    // Create popup window
-    app->volmix_window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
-    gtk_window_set_title(GTK_WINDOW(app->volmix_window), "Volume Control");
-    gtk_window_set_decorated(GTK_WINDOW(app->volmix_window), TRUE);
-    gtk_window_set_skip_taskbar_hint(GTK_WINDOW(app->volmix_window), FALSE);
-    gtk_window_set_skip_pager_hint(GTK_WINDOW(app->volmix_window), FALSE);
-    gtk_window_set_type_hint(GTK_WINDOW(app->volmix_window), GDK_WINDOW_TYPE_HINT_DIALOG);
-    gtk_window_set_resizable(GTK_WINDOW(app->volmix_window), FALSE);
-    
-    // Create main container with minimal spacing
-    GtkWidget *main_box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 2);
-    gtk_container_set_border_width(GTK_CONTAINER(main_box), 4);
-    gtk_container_add(GTK_CONTAINER(app->volmix_window), main_box);
-    
-    if (apps == NULL) {
-        // No applications playing audio
-        GtkWidget *no_apps_label = gtk_label_new("No applications playing audio");
-        gtk_box_pack_start(GTK_BOX(main_box), no_apps_label, FALSE, FALSE, 0);
-    } else {
-        // Add master volume header
-        GtkWidget *master_label = gtk_label_new("Master Volume");
-        gtk_label_set_markup(GTK_LABEL(master_label), "<b>Master Volume</b>");
-        gtk_box_pack_start(GTK_BOX(main_box), master_label, FALSE, FALSE, 0);
-        
-        // Add separator
-        GtkWidget *separator1 = gtk_separator_new(GTK_ORIENTATION_HORIZONTAL);
-        gtk_box_pack_start(GTK_BOX(main_box), separator1, FALSE, FALSE, 1);
-        
-        // Add application volume controls
-        GtkWidget *apps_label = gtk_label_new("Applications");
-        gtk_label_set_markup(GTK_LABEL(apps_label), "<b>Applications</b>");
-        gtk_box_pack_start(GTK_BOX(main_box), apps_label, FALSE, FALSE, 0);
-        
-        // Add each application
-        GList *item = apps;
-        int app_count = 0;
-        while (item) {
-            app_audio_t *audio_app = (app_audio_t *)item->data;
-            app_count++;
-            printf("Adding app %d: %s\n", app_count, audio_app->name);
-            
-            // Create container for this app with minimal spacing
-            GtkWidget *app_box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 1);
-            gtk_box_pack_start(GTK_BOX(main_box), app_box, FALSE, FALSE, 1);
-            
-            // Application name label
-            char label_text[256];
-            snprintf(label_text, sizeof(label_text), "%s (%d%%)", 
-                    audio_app->name, app_audio_get_volume_percent(audio_app));
-            GtkWidget *label = gtk_label_new(label_text);
-            gtk_widget_set_halign(label, GTK_ALIGN_START);
-            gtk_box_pack_start(GTK_BOX(app_box), label, FALSE, FALSE, 0);
-            
-            // Volume slider
-            GtkWidget *slider = gtk_scale_new_with_range(GTK_ORIENTATION_HORIZONTAL, 0.0, 100.0, 1.0);
-            gtk_range_set_value(GTK_RANGE(slider), app_audio_get_volume_percent(audio_app));
-            gtk_scale_set_draw_value(GTK_SCALE(slider), TRUE);
-            gtk_scale_set_value_pos(GTK_SCALE(slider), GTK_POS_RIGHT);
-            gtk_widget_set_size_request(slider, 160, -1);
-            
-            // Store the sink input index for the callback
-            uint32_t *index_ptr = g_malloc(sizeof(uint32_t));
-            *index_ptr = audio_app->index;
-            
-            // Store application name for index updates
-            char *app_name = g_strdup(audio_app->name);
-            
-            // Use g_object_set_data_full to ensure memory is freed when widget is destroyed
-            g_object_set_data_full(G_OBJECT(slider), "sink_input_index", index_ptr, g_free);
-            g_object_set_data_full(G_OBJECT(slider), "app_name", app_name, g_free);
-            
-            // Connect slider signal using the stored data instead of direct pointer
-            g_signal_connect(slider, "value-changed", G_CALLBACK(on_app_volume_changed), 
-                           g_object_get_data(G_OBJECT(slider), "sink_input_index"));
-            
-            gtk_box_pack_start(GTK_BOX(app_box), slider, FALSE, FALSE, 0);
-            
-            item = item->next;
-        }
-        printf("Added %d applications to window\n", app_count);
-        
+    gchar **names = scenes_list();
+    for (gchar **name = names; name && *name; name++) {
+        GtkWidget *item = gtk_menu_item_new_with_label(*name);
+        g_signal_connect(item, "activate", G_CALLBACK(on_scene_activate), app);
+        gtk_menu_shell_append(GTK_MENU_SHELL(app->scenes_menu), item);
+    }
+    if (names && names[0]) {
+        gtk_menu_shell_append(GTK_MENU_SHELL(app->scenes_menu), gtk_separator_menu_item_new());
     }
+    g_strfreev(names);
     
-    // Window can be closed by clicking tray icon again or using window controls
+    GtkWidget *save_item = gtk_menu_item_new_with_label("Save Scene...");
+    g_signal_connect(save_item, "activate", G_CALLBACK(on_save_scene_activate), app);
+    gtk_menu_shell_append(GTK_MENU_SHELL(app->scenes_menu), save_item);
+    
+    gtk_widget_show_all(app->scenes_menu);
 }
 
-static void position_window_near_cursor(GtkWindow *window)
+// Leveling follows the primary server, like the tray icon and scroll
+static void on_leveling_toggled(GtkCheckMenuItem *item, gpointer user_data)
 {
-    // Position the window near the mouse cursor
-    GdkDisplay *display = gdk_display_get_default();
-    GdkSeat *seat = gdk_display_get_default_seat(display);
-    GdkDevice *pointer = gdk_seat_get_pointer(seat);
-    GdkScreen *screen = gdk_display_get_default_screen(display);
-    gint x, y;
-    
-    gdk_device_get_position(pointer, &screen, &x, &y);
-    
-    // Get window size to position it properly
-    gint width, height;
-    gtk_window_get_size(window, &width, &height);
-    
-    // Position window so it appears near the cursor but doesn't go off screen
-    x = x - width / 2;
-    y = y - height - 20; // Above the cursor
-    
-    // Make sure window stays on screen
-    GdkRectangle screen_geometry;
-    gdk_screen_get_monitor_geometry(screen, 
-        gdk_screen_get_monitor_at_point(screen, x + width/2, y + height/2), 
-        &screen_geometry);
-    
-    if (x < screen_geometry.x) x = screen_geometry.x;
-    if (y < screen_geometry.y) y = screen_geometry.y;
-    if (x + width > screen_geometry.x + screen_geometry.width) 
-        x = screen_geometry.x + screen_geometry.width - width;
-    if (y + height > screen_geometry.y + screen_geometry.height) 
-        y = screen_geometry.y + screen_geometry.height - height;
-    
-    gtk_window_move(window, x, y);
+    volmix_app_t *app = (volmix_app_t *)user_data;
+    gboolean active = gtk_check_menu_item_get_active(item);
+    
+    if (volmix_set_leveling(app->vm, active, VOLMIX_LEVELING_DEFAULT_DBFS) != VOLMIX_OK) {
+        printf("Loudness leveling is not available with the %s backend\n",
+               volmix_get_backend_name(app->vm));
+        gtk_check_menu_item_set_active(item, FALSE);
+    }
 }
 
-static void on_tray_icon_activate(GtkStatusIcon *status_icon, gpointer user_data)
+// Mute items for the primary server, then scenes, leveling and quit
+static void create_popup_menu(volmix_app_t *app)
 {
-    volmix_app_t *app = (volmix_app_t *)user_data;
+    GtkWidget *menu;
+    GtkWidget *scenes_item = gtk_menu_item_new_with_label("Scenes");
+    GtkWidget *leveling_item = gtk_check_menu_item_new_with_label("Loudness Leveling");
+    GtkWidget *quit_item = gtk_menu_item_new_with_label("Quit");
     
-    // Check if window exists
-    if (app->volmix_window) {
-        if (gtk_widget_get_visible(app->volmix_window)) {
-            printf("Tray icon clicked! Hiding volume control window...\n");
-            gtk_widget_hide(app->volmix_window);
-            return;
-        } else {
-            printf("Tray icon clicked! Showing volume control window...\n");
-            gtk_widget_show_all(app->volmix_window);
-            position_window_near_cursor(GTK_WINDOW(app->volmix_window));
-            gtk_window_present(GTK_WINDOW(app->volmix_window));
-            return;
-        }
-    }
+    tray_menu_init(&app->menu, app->vm);
+    menu = app->menu.menu;
     
-    printf("Tray icon clicked! Building volume control window...\n");
+    app->scenes_menu = gtk_menu_new();
+    gtk_menu_item_set_submenu(GTK_MENU_ITEM(scenes_item), app->scenes_menu);
+    gtk_menu_shell_append(GTK_MENU_SHELL(menu), scenes_item);
+    rebuild_scenes_menu(app);
     
-    // Build the volume control window
-    build_volume_window(app);
+    g_signal_connect(leveling_item, "toggled", G_CALLBACK(on_leveling_toggled), app);
+    gtk_menu_shell_append(GTK_MENU_SHELL(menu), leveling_item);
     
-    // Show the window first so GTK can calculate its size
-    gtk_widget_show_all(app->volmix_window);
+    g_signal_connect(quit_item, "activate", G_CALLBACK(gtk_main_quit), NULL);
+    gtk_menu_shell_append(GTK_MENU_SHELL(menu), quit_item);
     
-    // Position the window near the mouse cursor after showing
-    position_window_near_cursor(GTK_WINDOW(app->volmix_window));
-    gtk_window_present(GTK_WINDOW(app->volmix_window));
+    gtk_widget_show(scenes_item);
+    gtk_widget_show(leveling_item);
+    gtk_widget_show(quit_item);
 }
 
-static void on_tray_icon_popup_menu(GtkStatusIcon *status_icon, guint button, 
-                                   guint activate_time, gpointer user_data)
+static void step_stream_volume(volmix_stream_t *stream, void *user_data)
 {
-    volmix_app_t *app = (volmix_app_t *)user_data;
+    int delta = GPOINTER_TO_INT(user_data);
+    int volume = CLAMP(volmix_stream_get_volume(stream) + delta, 0, 100);
     
-    // Create a simple context menu for now
-    GtkWidget *menu = gtk_menu_new();
-    GtkWidget *quit_item = gtk_menu_item_new_with_label("Quit");
+    // Coalesced by the engine while a previous step is still in flight
+    if (volmix_stream_set_volume(stream, volume, NULL, NULL) == VOLMIX_OK) {
+        printf("%s volume %d%%\n", volmix_stream_get_name(stream), volume);
+    }
+}
+
+// Ctrl+scroll: the focused window's application instead of the master.
+// Resolving the stream is a lookup in the registry's pid index.
+static void step_focused_app_volume(volmix_app_t *app, int delta)
+{
+    guint32 pid = active_window_get_pid();
     
-    g_signal_connect(quit_item, "activate", G_CALLBACK(gtk_main_quit), NULL);
-    gtk_menu_shell_append(GTK_MENU_SHELL(menu), quit_item);
+    if (pid == 0) {
+        printf("No focused window with a known process\n");
+        return;
+    }
     
-    gtk_widget_show_all(menu);
-    gtk_menu_popup_at_pointer(GTK_MENU(menu), NULL);
+    volmix_foreach_stream_of_pid(app->vm, pid, step_stream_volume, GINT_TO_POINTER(delta));
 }
 
-
 static gboolean on_scroll_event(GtkStatusIcon *status_icon, GdkEventScroll *event, 
                                gpointer user_data)
 {
     volmix_app_t *app = (volmix_app_t *)user_data;
     const int volume_step = 5; // 5% volume steps
     
+    if (event->state & GDK_CONTROL_MASK) {
+        if (event->direction == GDK_SCROLL_UP) {
+            step_focused_app_volume(app, volume_step);
+        } else if (event->direction == GDK_SCROLL_DOWN) {
+            step_focused_app_volume(app, -volume_step);
+        }
+        return TRUE;
+    }
+    
     if (event->direction == GDK_SCROLL_UP) {
         printf("Scroll up - increase master volume\n");
-        if (pulse_client_increase_master_volume(&app->pulse_client, volume_step)) {
-            int current_volume = pulse_client_get_master_volume(&app->pulse_client);
+        if (volmix_step_master_volume(app->vm, volume_step, NULL, NULL) == VOLMIX_OK) {
+            int current_volume = volmix_get_master_volume(app->vm);
             printf("Volume increased to %d%%\n", current_volume);
         } else {
             printf("Failed to increase volume\n");
         }
     } else if (event->direction == GDK_SCROLL_DOWN) {
         printf("Scroll down - decrease master volume\n");
-        if (pulse_client_decrease_master_volume(&app->pulse_client, volume_step)) {
-            int current_volume = pulse_client_get_master_volume(&app->pulse_client);
+        if (volmix_step_master_volume(app->vm, -volume_step, NULL, NULL) == VOLMIX_OK) {
+            int current_volume = volmix_get_master_volume(app->vm);
             printf("Volume decreased to %d%%\n", current_volume);
         } else {
             printf("Failed to decrease volume\n");
         }
     }
     
+    update_tray_icon(app);
+    
     return TRUE;
 }
 
 static void setup_tray_icon(volmix_app_t *app)
 {
-    app->tray_icon = gtk_status_icon_new();
-    
-    // Load the inverted sound icon PNG (white speaker)
-    // Try development location first, then installed location
-    gchar *dev_icon_path = g_build_filename("data", "icons", "sound-icon-inverted.png", NULL);
-    gchar *installed_icon_path = g_build_filename(DATADIR, "volmix", "icons", "sound-icon-inverted.png", NULL);
-    gchar *icon_path = NULL;
-    GError *error = NULL;
-    GdkPixbuf *icon_pixbuf = NULL;
-    
-    // Check development location first
-    if (g_file_test(dev_icon_path, G_FILE_TEST_EXISTS | G_FILE_TEST_IS_REGULAR)) {
-        icon_pixbuf = gdk_pixbuf_new_from_file_at_size(dev_icon_path, 22, 22, &error);
-        icon_path = g_strdup(dev_icon_path);  // Keep track for error reporting
-    }
-    // Check installed location if development location failed
-    else if (g_file_test(installed_icon_path, G_FILE_TEST_EXISTS | G_FILE_TEST_IS_REGULAR)) {
-        icon_pixbuf = gdk_pixbuf_new_from_file_at_size(installed_icon_path, 22, 22, &error);
-        icon_path = g_strdup(installed_icon_path);  // Keep track for error reporting
-    }
-    
-    g_free(dev_icon_path);
-    g_free(installed_icon_path);
-    
-    if (icon_pixbuf) {
-        gtk_status_icon_set_from_pixbuf(GTK_STATUS_ICON(app->tray_icon), icon_pixbuf);
-        g_object_unref(icon_pixbuf);
-        g_print("Loaded inverted sound icon PNG\n");
-    } else {
-        // Fallback to system icon if file not found
-        g_warning("Could not load sound icon (%s), using system icon",
-                  error ? error->message : "file not found");
-        if (error) g_error_free(error);
-        gtk_status_icon_set_from_icon_name(GTK_STATUS_ICON(app->tray_icon),
-                                          "audio-volume-high");
-    }
-    
-    g_free(icon_path);
-    
-    gtk_status_icon_set_tooltip_text(GTK_STATUS_ICON(app->tray_icon), 
-                                    "volmix - Per-Application Audio Control");
-    
-    gtk_status_icon_set_visible(GTK_STATUS_ICON(app->tray_icon), TRUE);
+    tray_icon_init(&app->tray);
+    update_tray_icon(app);
+    create_popup_menu(app);
     
     // Connect signals
-    g_signal_connect(app->tray_icon, "activate", 
+    g_signal_connect(app->tray.status_icon, "activate", 
                     G_CALLBACK(on_tray_icon_activate), app);
-    g_signal_connect(app->tray_icon, "popup-menu", 
+    g_signal_connect(app->tray.status_icon, "popup-menu", 
                     G_CALLBACK(on_tray_icon_popup_menu), app);
-    g_signal_connect(app->tray_icon, "scroll-event", 
+    g_signal_connect(app->tray.status_icon, "scroll-event", 
                     G_CALLBACK(on_scroll_event), app);
 }
 
 static void cleanup_app(volmix_app_t *app)
 {
-    if (app->tray_icon) {
-        gtk_status_icon_set_visible(GTK_STATUS_ICON(app->tray_icon), FALSE);
-        app->tray_icon = NULL;
-    }
+    instance_release();
+    tray_icon_cleanup(&app->tray);
     
-    if (app->volmix_window) {
-        gtk_widget_destroy(app->volmix_window);
-        app->volmix_window = NULL;
-    }
+    // Takes the scenes submenu with it
+    tray_menu_destroy(&app->menu);
+    app->scenes_menu = NULL;
     
-    // Cleanup PulseAudio client
-    pulse_client_disconnect(&app->pulse_client);
-    pulse_client_cleanup(&app->pulse_client);
+    mixer_window_destroy(&app->mixer);
+    
+    // Disconnects and releases the sound server clients
+    if (app->extra_vms) {
+        g_ptr_array_free(app->extra_vms, TRUE);
+        app->extra_vms = NULL;
+    }
+    volmix_free(app->vm);
+    app->vm = NULL;
 }
 
-static void signal_handler(int sig)
+// Runs from the main loop; main() cleans up once gtk_main returns
+static gboolean on_quit_signal(gpointer user_data)
 {
-    printf("Received signal %d, cleaning up...\n", sig);
-    cleanup_app(&app_data);
+    printf("Received signal, cleaning up...\n");
     gtk_main_quit();
+    
+    return G_SOURCE_CONTINUE;
 }
 
-static gboolean pulse_client_timer_callback(gpointer user_data)
+// libvolmix dispatches server events from the main loop and reports
+// registry changes here
+static void on_volmix_event(volmix_t *vm, volmix_event_t event,
+                            volmix_stream_t *stream, void *user_data)
 {
     volmix_app_t *app = (volmix_app_t *)user_data;
     
-    // Process PulseAudio events
-    pulse_client_iterate(&app->pulse_client);
+    if (vm == app->vm) {
+        if (event == VOLMIX_EVENT_MASTER_CHANGED || event == VOLMIX_EVENT_CONNECTED ||
+            event == VOLMIX_EVENT_DISCONNECTED) {
+            update_tray_icon(app);
+        }
+        tray_menu_handle_event(&app->menu, event, stream);
+    }
     
-    // Check if sink inputs have changed and window is visible
-    if (pulse_client_sink_inputs_changed(&app->pulse_client) && 
-        app->volmix_window && gtk_widget_get_visible(app->volmix_window)) {
-        printf("Sink inputs changed, updating slider indexes...\n");
-        update_slider_indexes(app);
+    if (vm != app->vm) {
+        if (event == VOLMIX_EVENT_CONNECTED) {
+            printf("Connected to %s\n", volmix_get_server(vm));
+        } else if (event == VOLMIX_EVENT_DISCONNECTED) {
+            printf("Not connected to %s\n", volmix_get_server(vm));
+        }
     }
     
-    return G_SOURCE_CONTINUE; // Keep the timer running
+    mixer_window_handle_event(&app->mixer, vm, event, stream);
 }
 
-// Function to update slider widget data with current sink input indexes
-static void update_slider_indexes(volmix_app_t *app)
+// Build the mixer window once the main loop is idle after startup
+static gboolean prebuild_mixer_idle(gpointer user_data)
 {
-    if (!app->volmix_window || !gtk_widget_get_visible(app->volmix_window)) {
-        return;
+    volmix_app_t *app = (volmix_app_t *)user_data;
+    
+    mixer_window_prebuild(&app->mixer);
+    
+    // Tray up and mixer built: comparable with the headless figure
+    proc_stats_report_startup("tray", app->start_us);
+    
+    return G_SOURCE_REMOVE;
+}
+
+// Commands from later launches ("volmix show", "volmix volume +5"), and
+// this launch's own once it is up: "show" is the mixer window, anything
+// else goes to the shared command parser for the primary server. Scenes
+// saved or deleted that way show up in the tray's Scenes submenu.
+static gboolean on_instance_command(const char *line, GString *reply, gpointer user_data)
+{
+    volmix_app_t *app = (volmix_app_t *)user_data;
+    int argc = 0;
+    char **argv = NULL;
+    gboolean ok;
+    
+    if (!g_shell_parse_argv(line, &argc, &argv, NULL)) {
+        argc = 0;
     }
     
-    // Refresh the sink input list
-    pulse_client_refresh_apps(&app->pulse_client);
-    
-    // Process the refresh operation
-    if (app->pulse_client.operation) {
-        int timeout_count = 0;
-        while (pa_operation_get_state(app->pulse_client.operation) == PA_OPERATION_RUNNING && 
-               timeout_count < MAX_REFRESH_TIMEOUT) {
-            pulse_client_iterate(&app->pulse_client);
-            g_usleep(DELAY_5_MS_USEC);
-            timeout_count++;
+    if (argc == 1 && strcmp(argv[0], "show") == 0) {
+        if (!mixer_window_is_visible(&app->mixer)) {
+            mixer_window_toggle(&app->mixer);
+        }
+        g_string_append(reply, "ok\n");
+        ok = TRUE;
+    } else {
+        ok = control_execute(app->vm, line, reply);
+        if (ok && argc > 0 && app->scenes_menu &&
+            (strcmp(argv[0], "scene-save") == 0 || strcmp(argv[0], "scene-delete") == 0)) {
+            rebuild_scenes_menu(app);
         }
-        pa_operation_unref(app->pulse_client.operation);
-        app->pulse_client.operation = NULL;
     }
     
-    // Get current apps list
-    GList *apps = pulse_client_get_apps(&app->pulse_client);
+    g_strfreev(argv);
+    return ok;
+}
+
+// Command words after the options as one line; "show" without any
+static char* join_command(gchar **words)
+{
+    if (!words || !words[0]) {
+        return g_strdup("show");
+    }
     
-    // Find all slider widgets and update their stored sink input indexes
-    GList *widgets = gtk_container_get_children(GTK_CONTAINER(app->volmix_window));
-    update_sliders_recursive(widgets, apps);
-    g_list_free(widgets);
+    GString *line = g_string_new(NULL);
+    for (gchar **word = words; *word; word++) {
+        char *quoted = g_shell_quote(*word);
+        if (line->len) {
+            g_string_append_c(line, ' ');
+        }
+        g_string_append(line, quoted);
+        g_free(quoted);
+    }
+    return g_string_free(line, FALSE);
 }
 
-// Recursive function to find and update slider widgets
-static void update_sliders_recursive(GList *widgets, GList *apps)
+// Hand the command to a running instance. An instance that is just
+// starting holds the lock before it listens, so give it a moment.
+static gboolean forward_to_instance(const char *line, gboolean *ok)
 {
-    while (widgets) {
-        GtkWidget *widget = GTK_WIDGET(widgets->data);
-        
-        if (GTK_IS_SCALE(widget)) {
-            // This is a volume slider - check if it has stored app data
-            uint32_t *stored_index = (uint32_t *)g_object_get_data(G_OBJECT(widget), "sink_input_index");
-            char *stored_app_name = (char *)g_object_get_data(G_OBJECT(widget), "app_name");
-            
-            if (stored_index && stored_app_name) {
-                // Find the current index for this app name
-                GList *app_item = apps;
-                while (app_item) {
-                    app_audio_t *app = (app_audio_t *)app_item->data;
-                    if (strcmp(app->name, stored_app_name) == 0) {
-                        if (*stored_index != app->index) {
-                            printf("Updating slider for '%s': index %u -> %u\n", 
-                                   stored_app_name, *stored_index, app->index);
-                            *stored_index = app->index;
-                        }
-                        break;
-                    }
-                    app_item = app_item->next;
-                }
-            }
-        } else if (GTK_IS_CONTAINER(widget)) {
-            // Recursively check container widgets
-            GList *children = gtk_container_get_children(GTK_CONTAINER(widget));
-            update_sliders_recursive(children, apps);
-            g_list_free(children);
+    const int attempts = 50;
+    
+    if (instance_forward(line, ok)) {
+        return TRUE;
+    }
+    if (instance_claim()) {
+        return FALSE;
+    }
+    
+    for (int i = 0; i < attempts; i++) {
+        g_usleep(10 * 1000);
+        if (instance_forward(line, ok)) {
+            return TRUE;
         }
-        
-        widgets = widgets->next;
     }
+    
+    printf("Another volmix is starting but not answering; running a separate one\n");
+    return FALSE;
 }
 
-int main(int argc, char *argv[])
+// Further servers connect in the background; each one reports its state in
+// its own mixer section and only costs its connection's socket
+static void add_extra_server(volmix_app_t *app, const char *server)
 {
-    // Initialize GTK
-    gtk_init(&argc, &argv);
+    volmix_t *vm = volmix_new_for_server(NULL, server);
+    if (!vm) {
+        printf("Failed to initialize audio client for %s\n", server);
+        return;
+    }
     
+    g_ptr_array_add(app->extra_vms, vm);
+    mixer_window_add_server(&app->mixer, vm);
+    volmix_set_event_callback(vm, on_volmix_event, app);
+    
+    if (volmix_connect_async(vm) != VOLMIX_OK) {
+        printf("Failed to connect to %s\n", server);
+    }
+}
+
+// Everything a launch that stays needs: the primary server connected,
+// further servers, the tray icon and the instance socket. On FALSE the
+// caller still owes cleanup_app.
+static gboolean start_app(volmix_app_t *app, gchar **servers, gint64 start_us)
+{
     // Set up signal handlers for clean shutdown
-    signal(SIGINT, signal_handler);
-    signal(SIGTERM, signal_handler);
+    g_unix_signal_add(SIGINT, on_quit_signal, NULL);
+    g_unix_signal_add(SIGTERM, on_quit_signal, NULL);
+    control_watch_flight_signal();
     
     // Initialize application data
-    memset(&app_data, 0, sizeof(volmix_app_t));
+    memset(app, 0, sizeof(volmix_app_t));
+    app->start_us = start_us;
     
-    // Initialize and connect PulseAudio client
-    if (!pulse_client_init(&app_data.pulse_client)) {
-        printf("Failed to initialize PulseAudio client\n");
-        return 1;
-    }
+    app->extra_vms = g_ptr_array_new_with_free_func((GDestroyNotify)volmix_free);
     
-    if (!pulse_client_connect(&app_data.pulse_client)) {
-        printf("Failed to connect to PulseAudio server\n");
-        cleanup_app(&app_data);
-        return 1;
+    // Initialize and connect the primary sound server client
+    app->vm = volmix_new_for_server(NULL, servers ? servers[0] : NULL);
+    if (!app->vm) {
+        printf("Failed to initialize audio client\n");
+        return FALSE;
     }
     
-    // Set up system tray icon
-    setup_tray_icon(&app_data);
+    // Keep the mixer window current from registry events, and pre-build it
+    // so the first click doesn't pay for widget creation
+    mixer_window_init(&app->mixer);
+    mixer_window_add_server(&app->mixer, app->vm);
+    volmix_set_event_callback(app->vm, on_volmix_event, app);
     
-    // Set up timer to process PulseAudio events regularly
-    g_timeout_add(100, pulse_client_timer_callback, &app_data);
+    if (volmix_connect(app->vm) != VOLMIX_OK) {
+        printf("Failed to connect to sound server\n");
+        return FALSE;
+    }
     
-    printf("volmix application started. System tray icon should be visible.\n");
-    printf("Left-click: Show menu, Right-click: Context menu, Scroll: Master volume\n");
-    printf("Current volume: %d%%\n", pulse_client_get_master_volume(&app_data.pulse_client));
-    printf("Press Ctrl+C to quit.\n");
+    for (guint i = 1; servers && servers[i]; i++) {
+        add_extra_server(app, servers[i]);
+    }
     
-    // Run GTK main loop
-    gtk_main();
+    // Set up system tray icon
+    setup_tray_icon(app);
+    g_idle_add(prebuild_mixer_idle, app);
     
-    // Cleanup
-    cleanup_app(&app_data);
+    // Launches made meanwhile have been waiting in the socket's backlog
+    instance_serve(on_instance_command, app);
+    return TRUE;
+}
+
+int main(int argc, char *argv[])
+{
+    gint64 start_us = g_get_monotonic_time();
+    gchar **servers = NULL;
+    gchar **command = NULL;
+    GError *error = NULL;
+    GOptionEntry entries[] = {
+        { "server", 's', 0, G_OPTION_ARG_STRING_ARRAY, &servers,
+          "Sound server to control, repeat for several (first one drives the tray icon)",
+          "SERVER" },
+        { G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_STRING_ARRAY, &command, NULL, NULL },
+        { NULL }
+    };
+    
+    // Our own options first, without GTK: a launch that only hands its
+    // command to the running instance never initializes GTK or connects.
+    // GTK's options are left in argv for gtk_init. Options end at the
+    // command's first word, so "volume -5" steps down rather than leaving
+    // "-5" behind as an unknown option; older GLib needs "-- volume -5".
+    GOptionContext *context = g_option_context_new("[COMMAND...]");
+    g_option_context_set_summary(context,
+                                 "Hands COMMAND (default \"show\") to a running volmix, if any.");
+    g_option_context_add_main_entries(context, entries, NULL);
+    g_option_context_set_ignore_unknown_options(context, TRUE);
+#if GLIB_CHECK_VERSION(2, 44, 0)
+    g_option_context_set_strict_posix(context, TRUE);
+#endif
+    gboolean parsed = g_option_context_parse(context, &argc, &argv, &error);
+    g_option_context_free(context);
+    if (!parsed) {
+        printf("%s\n", error->message);
+        g_error_free(error);
+        return 1;
+    }
     
-    return 0;
-}
\ No newline at end of file
+    char *line = join_command(command);
+    gboolean forwarded_ok = FALSE;
+    int status = 0;
+    
+    if (forward_to_instance(line, &forwarded_ok)) {
+        printf("Handed to the running volmix in %.2f ms\n",
+               (g_get_monotonic_time() - start_us) / 1000.0);
+        status = forwarded_ok ? 0 : 1;
+    } else if (!gtk_init_check(&argc, &argv)) {
+        printf("Failed to initialize GTK\n");
+        instance_release();
+        status = 1;
+    } else if (!start_app(&app_data, servers, start_us)) {
+        cleanup_app(&app_data);
+        status = 1;
+    } else {
+        // A command given to the first launch runs here, once everything is up
+        if (command) {
+            GString *reply = g_string_new(NULL);
+            on_instance_command(line, reply, &app_data);
+            fputs(reply->str, stdout);
+            g_string_free(reply, TRUE);
+        }
+        
+        printf("volmix application started. System tray icon should be visible.\n");
+        printf("Left-click: Show menu, Right-click: Context menu, Scroll: Master volume\n");
+        printf("Current volume: %d%%\n", volmix_get_master_volume(app_data.vm));
+        printf("Press Ctrl+C to quit.\n");
+        
+        // Run GTK main loop
+        gtk_main();
+        cleanup_app(&app_data);
+    }
+    
+    g_free(line);
+    g_strfreev(command);
+    g_strfreev(servers);
+    return status;
+}
@@ -0,0 +1,135 @@
+#include <glib.h>
+#include <glib-unix.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include "libvolmix.h"
+#include "control.h"
+#include "proc_stats.h"
+
+// volmix without a UI: the same libvolmix client on a bare GLib main
+// loop, controlled through text commands on stdin. GTK is neither linked
+// nor initialized.
+
+typedef struct {
+    GMainLoop *loop;
+    volmix_t *vm;
+    GIOChannel *input;
+    guint input_watch;
+    gint64 start_us;
+} volmix_headless_t;
+
+static volmix_headless_t headless;
+
+static gboolean on_quit_signal(gpointer user_data)
+{
+    volmix_headless_t *app = (volmix_headless_t *)user_data;
+    
+    printf("Received signal, cleaning up...\n");
+    g_main_loop_quit(app->loop);
+    
+    return G_SOURCE_CONTINUE;
+}
+
+// Run each stdin line through the shared command parser
+static gboolean on_input(GIOChannel *channel, GIOCondition condition, gpointer user_data)
+{
+    volmix_headless_t *app = (volmix_headless_t *)user_data;
+    gchar *line = NULL;
+    
+    GIOStatus status = g_io_channel_read_line(channel, &line, NULL, NULL, NULL);
+    if (status == G_IO_STATUS_EOF || status == G_IO_STATUS_ERROR) {
+        // Keep running as a daemon once the controlling input goes away
+        g_free(line);
+        app->input_watch = 0;
+        return G_SOURCE_REMOVE;
+    }
+    
+    if (status == G_IO_STATUS_NORMAL && line) {
+        GString *reply = g_string_new(NULL);
+        g_strstrip(line);
+        if (line[0]) {
+            control_execute(app->vm, line, reply);
+            fputs(reply->str, stdout);
+            fflush(stdout);
+        }
+        g_string_free(reply, TRUE);
+    }
+    
+    g_free(line);
+    return G_SOURCE_CONTINUE;
+}
+
+static gboolean report_startup_idle(gpointer user_data)
+{
+    volmix_headless_t *app = (volmix_headless_t *)user_data;
+    
+    proc_stats_report_startup("headless", app->start_us);
+    
+    return G_SOURCE_REMOVE;
+}
+
+static void cleanup_app(volmix_headless_t *app)
+{
+    if (app->input_watch) {
+        g_source_remove(app->input_watch);
+        app->input_watch = 0;
+    }
+    
+    if (app->input) {
+        g_io_channel_unref(app->input);
+        app->input = NULL;
+    }
+    
+    if (app->vm) {
+        volmix_free(app->vm);
+        app->vm = NULL;
+    }
+    
+    if (app->loop) {
+        g_main_loop_unref(app->loop);
+        app->loop = NULL;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    memset(&headless, 0, sizeof(volmix_headless_t));
+    headless.start_us = g_get_monotonic_time();
+    headless.loop = g_main_loop_new(NULL, FALSE);
+    
+    // Quit from the main loop rather than the signal handler
+    g_unix_signal_add(SIGINT, on_quit_signal, &headless);
+    g_unix_signal_add(SIGTERM, on_quit_signal, &headless);
+    control_watch_flight_signal();
+    
+    headless.vm = volmix_new(NULL);
+    if (!headless.vm) {
+        printf("Failed to initialize audio client\n");
+        cleanup_app(&headless);
+        return 1;
+    }
+    
+    if (volmix_connect(headless.vm) != VOLMIX_OK) {
+        printf("Failed to connect to sound server\n");
+        cleanup_app(&headless);
+        return 1;
+    }
+    
+    headless.input = g_io_channel_unix_new(STDIN_FILENO);
+    headless.input_watch = g_io_add_watch(headless.input, G_IO_IN | G_IO_HUP | G_IO_ERR,
+                                          on_input, &headless);
+    
+    g_idle_add(report_startup_idle, &headless);
+    
+    printf("volmix headless started (%s backend). Type 'help' for commands.\n",
+           volmix_get_backend_name(headless.vm));
+    
+    g_main_loop_run(headless.loop);
+    
+    cleanup_app(&headless);
+    
+    return 0;
+}